@@ -226,6 +226,7 @@ void mainMenu(){
     cout << endl;
     cout << "9 - Set Verbose" << endl;
     cout << "10 - Set Max Time" << endl;
+    cout << "11 - Set Kernel Cache" << endl;
     cout << endl;
     cout << "--------------------------" <<endl;
     cout << "0 - Exit" << endl;
@@ -408,6 +409,23 @@ void mainOption(int option){
 
             waitUserAction();
             break;
+        case 11: {
+            string cache_dir;
+            size_t cache_size;
+
+            cout << "Kernel cache directory (\"none\" to disable): ";
+            cin >> cache_dir;
+            if (cache_dir == "none") {
+                Kernel::setDefaultCache(nullptr);
+            } else {
+                cout << "Max cache size (MB): ";
+                cin >> cache_size;
+                Kernel::setDefaultCache(make_shared<KernelCache>(cache_dir, cache_size * 1024 * 1024));
+            }
+
+            waitUserAction();
+            break;
+        }
         case 0:
             exitProgram();
             break;
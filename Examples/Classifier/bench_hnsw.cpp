@@ -0,0 +1,90 @@
+//
+// Recall and latency of the HNSW graph against brute force k nearest neighbors.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <chrono>
+#include <set>
+#include "KNNClassifier.hpp"
+
+using namespace mltk;
+using namespace std::chrono;
+
+// clusters of gaussian points around random centers, like embeddings of a few classes
+Data<double> make_embeddings(size_t size, size_t dim, size_t n_classes, std::mt19937 &gen,
+                             const std::vector<std::vector<double>> &centers){
+    Data<double> data;
+    std::normal_distribution<double> noise(0.0, 0.6);
+    std::uniform_int_distribution<size_t> cls(0, n_classes - 1);
+
+    for(size_t i = 0; i < size; ++i){
+        auto p = make_point<double>(dim);
+        size_t c = cls(gen);
+        for(size_t d = 0; d < dim; ++d) (*p)[d] = centers[c][d] + noise(gen);
+        p->Y() = int(c) + 1;
+        data.insertPoint(p);
+    }
+    return data;
+}
+
+int main(int argc, char *argv[]){
+    size_t n = (argc > 1) ? std::stoul(argv[1]) : 10000, dim = (argc > 2) ? std::stoul(argv[2]) : 512;
+    size_t k = (argc > 3) ? std::stoul(argv[3]) : 10, n_queries = 200, n_classes = 10;
+    std::mt19937 gen(42);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::vector<std::vector<double>> centers(n_classes, std::vector<double>(dim));
+
+    for(auto &center: centers)
+        for(auto &x: center) x = normal(gen) / 4;
+    Data<double> train = make_embeddings(n, dim, n_classes, gen, centers);
+    Data<double> test = make_embeddings(n_queries, dim, n_classes, gen, centers);
+    metrics::dist::Euclidean<double> dist;
+
+    std::cout << "Points: " << n << ", dimensions: " << dim << ", k: " << k << ", queries: " << n_queries << std::endl;
+
+    // exact neighbors and latency of brute force
+    classifier::KNNClassifier<double> brute(train, k, "brute");
+    std::vector<std::set<size_t>> exact(n_queries);
+    std::vector<double> brute_pred(n_queries);
+    brute.train();
+    auto t1 = high_resolution_clock::now();
+    for(size_t i = 0; i < n_queries; ++i) brute_pred[i] = brute.evaluate(*test[i]);
+    double brute_ms = duration<double, std::milli>(high_resolution_clock::now() - t1).count() / n_queries;
+    for(size_t i = 0; i < n_queries; ++i){
+        std::vector<std::pair<double, size_t>> dists(n);
+        for(size_t j = 0; j < n; ++j) dists[j] = std::make_pair(dist(*test[i], *train[j]), j);
+        std::partial_sort(dists.begin(), dists.begin() + k, dists.end());
+        for(size_t j = 0; j < k; ++j) exact[i].insert(dists[j].second);
+    }
+
+    classifier::KNNClassifier<double> knn(train, k, "hnsw");
+    knn.hnswIndex().setM(16);
+    knn.hnswIndex().setEfConstruction(200);
+    t1 = high_resolution_clock::now();
+    knn.train();
+    double build_s = duration<double>(high_resolution_clock::now() - t1).count();
+
+    std::cout << "Brute force: " << std::fixed << std::setprecision(3) << brute_ms << " ms/query" << std::endl;
+    std::cout << "HNSW build (M = 16, efConstruction = 200): " << build_s << " s\n" << std::endl;
+    std::cout << std::setw(10) << "efSearch" << std::setw(12) << "recall@k" << std::setw(12) << "ms/query"
+              << std::setw(10) << "speedup" << std::setw(12) << "agreement" << std::endl;
+    for(size_t ef: {10, 20, 40, 80, 160, 320}){
+        std::vector<std::pair<double, size_t>> heap;
+        size_t found = 0, agree = 0;
+
+        knn.hnswIndex().setEfSearch(ef);
+        t1 = high_resolution_clock::now();
+        for(size_t i = 0; i < n_queries; ++i) agree += (knn.evaluate(*test[i]) == brute_pred[i]);
+        double ms = duration<double, std::milli>(high_resolution_clock::now() - t1).count() / n_queries;
+        for(size_t i = 0; i < n_queries; ++i){
+            knn.hnswIndex().kNearest(*test[i], k, heap);
+            for(auto const &neighbor: heap) found += exact[i].count(neighbor.second);
+        }
+        std::cout << std::setw(10) << ef << std::setw(12) << double(found) / (n_queries * k) << std::setw(12) << ms
+                  << std::setw(10) << std::setprecision(1) << brute_ms / ms << std::setw(12) << std::setprecision(3)
+                  << double(agree) / n_queries << std::endl;
+    }
+    return 0;
+}
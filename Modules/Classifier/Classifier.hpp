@@ -7,4 +7,5 @@
 #include "include/Perceptron.hpp"
 #include "include/PrimalClassifier.hpp"
 #include "Sampling.hpp"
-#include "include/SMO.hpp"
\ No newline at end of file
+#include "include/SMO.hpp"
+#include "include/SupportVectorModel.hpp"
\ No newline at end of file
@@ -8,6 +8,9 @@
 
 #include "../../Core/include/Kernel.hpp"
 #include "Classifier.hpp"
+#include "SupportVectorModel.hpp"
+#include <memory>
+#include <stdexcept>
 #include <vector>
 
 namespace mltk{
@@ -23,26 +26,231 @@ namespace mltk{
             double kernel_param = 0;
             /// Object for kernel computations.
             Kernel *kernel = nullptr;
+            /**
+             * \brief Operations needing the kernel policy set with setKernelPolicy. Each operation runs a whole loop
+             * instantiated with the policy, so the kernel function is called directly inside it.
+             */
+            struct PolicyOps {
+                virtual ~PolicyOps() = default;
+
+                virtual void compute(Kernel *K, const DataPointer<T> &samples) const = 0;
+
+                virtual double decision(const DualClassifier<T> &learner, const Point<T> &p) const = 0;
+
+                virtual void dualWeight(DualClassifier<T> &learner) const = 0;
+
+                virtual void setModelKernel(SupportVectorModel<T> &model) const = 0;
+            };
+
+            template<typename Policy>
+            struct PolicyModel : public PolicyOps {
+                Policy policy;
+
+                explicit PolicyModel(const Policy &policy): policy(policy) {}
+
+                void compute(Kernel *K, const DataPointer<T> &samples) const override { K->compute(samples, policy); }
+
+                double decision(const DualClassifier<T> &learner, const Point<T> &p) const override {
+                    return learner.decision(policy, p);
+                }
+
+                void dualWeight(DualClassifier<T> &learner) const override { learner.dualWeight(policy); }
+
+                void setModelKernel(SupportVectorModel<T> &model) const override { model.setKernelPolicy(policy); }
+            };
+
+            /// Kernel policy set by the user, used instead of the kernel type if set.
+            std::shared_ptr<const PolicyOps> policy;
+            /// Support vector model used by batchEvaluate, rebuilt when the solution changes.
+            SupportVectorModel<T> batch_model;
+            /// Alphas, bias, kernel and samples the batch model was built from.
+            std::vector<double> batch_alphas;
+            double batch_bias = 0, batch_kernel_param = 0;
+            int batch_kernel_type = KernelType::INVALID_TYPE;
+            std::weak_ptr<Data<T> > batch_samples;
+            const void *batch_policy = nullptr;
+
+            /**
+             * \brief Tells if the batch model was built from the current solution.
+             * \return bool
+             */
+            bool batchModelValid() const {
+                size_t size = this->samples->getSize();
+
+                if (!kernel || batch_samples.expired() || batch_samples.owner_before(this->samples) ||
+                    this->samples.owner_before(batch_samples) || batch_policy != policy.get() ||
+                    batch_bias != this->solution.bias || batch_kernel_type != kernel->getType() ||
+                    batch_kernel_param != kernel->getParam() || batch_alphas.size() != size) return false;
+                for (size_t i = 0; i < size; ++i)
+                    if (batch_alphas[i] != (*this->samples)[i]->Alpha()) return false;
+                return true;
+            }
+
+            /**
+             * \brief Compute the kernel matrix of the samples with the kernel policy or the kernel type.
+             */
+            void computeKernel() {
+                if (policy) policy->compute(this->kernel, this->samples);
+                else this->kernel->compute(this->samples);
+            }
+
+            /**
+             * \brief Decision value of a point, sum of alpha_i*y_i*k(x_i, p) over the samples plus the bias.
+             * \param kernel_policy Kernel policy used in the sum.
+             * \return double
+             */
+            template<typename Policy>
+            double decision(const Policy &kernel_policy, const Point<T> &p) const {
+                size_t size = this->samples->getSize(), dim = this->samples->getDim(), r;
+                double func = this->solution.bias;
+
+                for (r = 0; r < size; ++r) {
+                    auto const& sample = (*this->samples)[r];
+                    if (sample->Alpha() == 0) continue;
+                    func += sample->Alpha() * sample->Y() * kernel_policy.function(p.X().data(), sample->X().data(), dim);
+                }
+                return func;
+            }
+
+            /**
+             * \brief Visit every pair of support vectors once, with the coefficient alpha_i*y_i*alpha_j*y_j of the pair
+             * (doubled for i != j) in the dual weights.
+             * \param pair_weight Called as pair_weight(a, b, dim, coef) with the features of the pair.
+             */
+            template<typename PairWeight>
+            void supportVectorPairs(PairWeight pair_weight) const {
+                size_t i, j, size = this->samples->getSize(), dim = this->samples->getDim();
+                double coef;
+                std::vector<size_t> svs;
+
+                for (i = 0; i < size; ++i)
+                    if ((*this->samples)[i]->Alpha() != 0) svs.push_back(i);
+
+                for (i = 0; i < svs.size(); ++i) {
+                    auto const& a = (*this->samples)[svs[i]];
+
+                    for (j = i; j < svs.size(); ++j) {
+                        auto const& b = (*this->samples)[svs[j]];
+
+                        coef = a->Alpha() * a->Y() * b->Alpha() * b->Y();
+                        if (i != j) coef *= 2;
+                        pair_weight(a->X().data(), b->X().data(), dim, coef);
+                    }
+                }
+            }
+
+            /**
+             * \brief Weight of each dimension from the full kernel value of every pair of support vectors with the
+             * kernel recomputed without the removed dimension, used for the user-defined policies.
+             * \param kernel_policy Kernel policy used in the computations.
+             */
+            template<typename Policy>
+            void dualWeight(const Policy &kernel_policy) {
+                std::vector<double> &w = this->solution.w;
+
+                supportVectorPairs([&](const T *a, const T *b, size_t dim, double coef) {
+                    double full = kernel_policy.function(a, b, dim);
+
+                    for (size_t k = 0; k < dim; ++k)
+                        w[k] += coef * (full - kernel_policy.functionWithoutDim(a, b, k, dim));
+                });
+            }
+
+            /**
+             * \brief Dual weights of the inner product, the removed dimension only takes x_ik*x_jk from the kernel.
+             */
+            void dualWeight(const kernels::Linear &) {
+                std::vector<double> &w = this->solution.w;
+
+                supportVectorPairs([&](const T *a, const T *b, size_t dim, double coef) {
+                    for (size_t k = 0; k < dim; ++k)
+                        w[k] += coef * a[k] * b[k];
+                });
+            }
+
+            /**
+             * \brief Dual weights of the polynomial kernel, x_ik*x_jk is subtracted from the full inner product to
+             * remove a dimension, O(d) for each pair.
+             */
+            void dualWeight(const kernels::Polynomial &kernel_policy) {
+                std::vector<double> &w = this->solution.w;
+                double param = kernel_policy.param;
+
+                supportVectorPairs([&](const T *a, const T *b, size_t dim, double coef) {
+                    double sum = kernels::Linear().function(a, b, dim), full = kernel_policy.function(a, b, dim);
+                    double without;
+
+                    for (size_t k = 0; k < dim; ++k) {
+                        without = sum - a[k] * b[k];
+                        without = (param > 1) ? std::pow(without + 1, param) : without;
+                        w[k] += coef * (full - without);
+                    }
+                });
+            }
+
+            /**
+             * \brief Dual weights of the gaussian kernel, (x_ik-x_jk)^2 is subtracted from the full squared distance to
+             * remove a dimension, O(d) for each pair.
+             */
+            void dualWeight(const kernels::Gaussian &kernel_policy) {
+                std::vector<double> &w = this->solution.w;
+                double param = kernel_policy.param;
+
+                supportVectorPairs([&](const T *a, const T *b, size_t dim, double coef) {
+                    double t, sum = 0.0, full;
+
+                    for (size_t k = 0; k < dim; ++k) {
+                        t = a[k] - b[k];
+                        sum += t * t;
+                    }
+                    full = std::exp(-1 * sum * param);
+                    for (size_t k = 0; k < dim; ++k) {
+                        t = a[k] - b[k];
+                        w[k] += coef * (full - std::exp(-1 * (sum - t * t) * param));
+                    }
+                });
+            }
+
         public:
 
             virtual double evaluate(const Point <T> &p, bool raw_value = false) override {
-                double func, bias = this->solution.bias, fk = 0.0, lambda;
-                size_t size = this->samples->getSize(), dim = this->samples->getDim(), r;
-                auto po = std::make_shared<Point<T> >(p);
+                double func = 0.0;
 
-                if (p.X().size() != dim) {
+                if (p.X().size() != this->samples->getDim()) {
                     std::cerr << "The point must have the same dimension of the feature set!" << std::endl;
                     return 0;
                 }
 
-                for (func = bias, r = 0; r < size; ++r) {
-                    fk = this->kernel->function(po, (*this->samples)[r], dim);
-                    func += (*this->samples)[r]->Alpha() * (*this->samples)[r]->Y() * fk;
-                }
+                // the kernel is resolved once, the sum over the samples calls it directly
+                if (policy) func = policy->decision(*this, p);
+                else this->kernel->dispatch([&](auto const& kernel_policy){ func = decision(kernel_policy, p); });
 
                 return (func >= 0) ? 1 : -1;
             }
 
+            /**
+             * \brief Compute the decision values of all the points of a dataset at once, through the compact
+             * support vector model of the solution.
+             * \param data Points to be evaluated.
+             * \param raw_value Return the decision values instead of the predicted classes.
+             * \return std::vector<double>
+             */
+            std::vector<double> batchEvaluate(Data<T> &data, bool raw_value = false) override {
+                if (!batchModelValid()) {
+                    size_t size = this->samples->getSize();
+
+                    batch_model = getSupportVectorModel();
+                    batch_alphas.resize(size);
+                    for (size_t i = 0; i < size; ++i) batch_alphas[i] = (*this->samples)[i]->Alpha();
+                    batch_bias = this->solution.bias;
+                    batch_kernel_type = kernel->getType();
+                    batch_kernel_param = kernel->getParam();
+                    batch_samples = this->samples;
+                    batch_policy = policy.get();
+                }
+                return batch_model.batchEvaluate(data, raw_value);
+            }
+
             /*********************************************
              *               Setters                     *
              *********************************************/
@@ -59,6 +267,7 @@ namespace mltk{
              */
             inline void setKernelType(KernelType type) {
                 this->kernel_type = type;
+                this->clearKernelPolicy();
                 if (this->kernel) this->kernel->setType(type);
             }
 
@@ -68,9 +277,28 @@ namespace mltk{
              */
             inline void setKernelParam(double param) {
                 this->kernel_param = param;
+                this->clearKernelPolicy();
                 if (this->kernel) kernel->setParam(param);
             }
 
+            /**
+             * \brief Set a compile-time kernel policy, used instead of the kernel type in training and evaluation.
+             * \param policy Kernel policy (kernels::Linear, kernels::Polynomial, kernels::Gaussian or user-defined).
+             */
+            template<typename Policy>
+            void setKernelPolicy(const Policy &kernel_policy) {
+                policy = std::make_shared<PolicyModel<Policy> >(kernel_policy);
+                if (this->kernel) this->kernel->recompute();
+            }
+
+            /**
+             * \brief Remove the kernel policy, the kernel type is used again.
+             */
+            void clearKernelPolicy() {
+                if (policy && this->kernel) this->kernel->recompute();
+                policy = nullptr;
+            }
+
             /*********************************************
              *               Getters                     *
              *********************************************/
@@ -79,6 +307,21 @@ namespace mltk{
 
             inline Kernel *getKernel() { return kernel; }
 
+            /**
+             * \brief Extract a compact model with only the support vectors of the solution, their coefficients, the
+             * bias and the kernel parameters.
+             * \throws std::runtime_error if the classifier has no kernel.
+             * \return SupportVectorModel<T>
+             */
+            SupportVectorModel<T> getSupportVectorModel() {
+                if (!kernel) throw std::runtime_error("The dual classifier has no kernel to build the model with.");
+                SupportVectorModel<T> model(*this->samples, this->solution.bias, kernel->getType(),
+                                            kernel->getParam());
+
+                if (policy) policy->setModelKernel(model);
+                return model;
+            }
+
             /**
              * \brief Get the parameter of the kernel.
              * \return double
@@ -116,61 +359,46 @@ namespace mltk{
 
             /**
              * \brief Compute the weights of the dual classifier (with H matrix).
+             * The contribution of each dimension is obtained from the full kernel value of every pair of support
+             * vectors with a correction for the removed dimension, so neither H nor H without dimension is built.
              * \return std::vector<double>
              */
             std::vector<double> getDualWeight() {
-                int i = 0, j = 0, k = 0;
-                size_t size = this->samples->getSize(), dim = this->samples->getDim();
-                dMatrix *H, *Hk, matrixdif(size, std::vector<double>(size));
-                std::vector<double> alphaaux(size);
-
-                H = kernel->generateMatrixH(this->samples);
-
-                this->solution.w.resize(dim);
-
-                for (k = 0; k < dim; ++k) {
-                    Hk = kernel->generateMatrixHwithoutDim(this->samples, k);
+                int type = kernel->getType();
+                double param = kernel->getParam();
 
-                    for (i = 0; i < size; ++i)
-                        for (j = 0; j < size; ++j)
-                            matrixdif[i][j] = (*H)[i][j] - (*Hk)[i][j];
+                // without the power the polynomial kernel is the inner product
+                if (!policy && (type == KernelType::INNER_PRODUCT || (type == KernelType::POLYNOMIAL && param <= 1)))
+                    return getDualWeightProdInt();
 
-                    for (i = 0; i < size; ++i)
-                        for (alphaaux[i] = 0, j = 0; j < size; ++j)
-                            alphaaux[i] += this->samples->getPoint(j)->Alpha() * matrixdif[i][j];
-
-                    for (this->solution.w[k] = 0, i = 0; i < size; ++i)
-                        this->solution.w[k] += alphaaux[i] * this->samples->getPoint(i)->Alpha();
-                }
+                this->solution.w.assign(this->samples->getDim(), 0.0);
+                if (policy) policy->dualWeight(*this);
+                else kernel->dispatch([this](auto const& kernel_policy){ dualWeight(kernel_policy); });
 
                 return this->solution.w;
             }
 
             /**
              * \brief Compute the weights with inner product of the dual classifier.
+             * With the inner product the weight of a dimension is (sum_i alpha_i*y_i*x_ik)^2, computed in O(n*d).
              * \return std::vector<double>
              */
             std::vector<double> getDualWeightProdInt() {
-                int i = 0, j = 0, k = 0;
-                size_t size = this->samples->getSize(), dim = this->samples->getDim();
-                std::vector<double> alphaaux(size);
-                dMatrix H(size, std::vector<double>(size));
-
-                this->solution.w.resize(dim);
-
-                for (k = 0; k < dim; ++k) {
-                    for (i = 0; i < size; ++i)
-                        for (j = 0; j < size; ++j)
-                            H[i][j] = (*this->samples)[i]->X()[k] * (*this->samples)[j]->X()[k]
-                                      * (*this->samples)[i]->Y() * (*this->samples)[j]->Y();
-                    if (this->verbose >= 3) std::clog << "\n H matrix without dim generated.\n";
-                    for (i = 0; i < size; ++i)
-                        for (alphaaux[i] = 0, j = 0; j < size; ++j)
-                            alphaaux[i] += this->samples->getPoint(j)->Alpha() * H[i][j];
-
-                    for (this->solution.w[k] = 0, i = 0; i < size; ++i)
-                        this->solution.w[k] += alphaaux[i] * this->samples->getPoint(i)->Alpha();
+                size_t i, k, size = this->samples->getSize(), dim = this->samples->getDim();
+                double coef;
+
+                this->solution.w.assign(dim, 0.0);
+
+                for (i = 0; i < size; ++i) {
+                    auto const& p = (*this->samples)[i];
+
+                    coef = p->Alpha() * p->Y();
+                    if (coef == 0) continue;
+                    for (k = 0; k < dim; ++k)
+                        this->solution.w[k] += coef * p->X()[k];
                 }
+                for (k = 0; k < dim; ++k)
+                    this->solution.w[k] *= this->solution.w[k];
 
                 return this->solution.w;
             }
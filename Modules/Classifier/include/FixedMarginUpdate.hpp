@@ -0,0 +1,157 @@
+/*! Weight updates of the fixed margin primal algorithms.
+   \file FixedMarginUpdate.hpp
+*/
+
+#ifndef FIXEDMARGINUPDATE__HPP
+#define FIXEDMARGINUPDATE__HPP
+
+#include "../../Core/include/Data.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace mltk{
+    namespace classifier {
+        /**
+         * \brief Update of the weights made by the fixed margin primal algorithms on a mistake,
+         * w_j += rate*(y*x_j - gamma*d||w||_q/dw_j), returning the new q norm of the weights.
+         *
+         * The update is specialized at compile time for q = 1, 2 and infinity (Q = -1, following the q = -1
+         * convention of the algorithms), Q = 0 handles any other value of q.
+         */
+        template<int Q>
+        struct FixedMarginUpdate {
+            double gamma, rate, q;
+
+            FixedMarginUpdate(double gamma, double rate, double q): gamma(gamma), rate(rate), q(q) {}
+
+            template<typename T>
+            void prepare(const Data<T> &) {}
+
+            /**
+             * \brief Update the weights with a mistake.
+             * \param w Weights to be updated.
+             * \param x Features of the point.
+             * \param y Label of the point.
+             * \param norm Norm of the weights before the update.
+             * \return double
+             */
+            template<typename T>
+            double operator()(std::vector<double> &w, const std::vector<T> &x, double y, double norm) {
+                size_t j, dim = w.size();
+                double *_w = w.data(), sumnorm = 0.0;
+                const T *_x = x.data();
+                // ||w||^(1-q) is the same for every coordinate, so only |w_j|^(q-2) is computed inside the loop
+                double scale = (norm > 0) ? gamma * std::pow(norm, 1.0 - q) : 0.0;
+
+                for (j = 0; j < dim; ++j) {
+                    double lambda = (_w[j] != 0) ? _w[j] * scale * std::pow(std::fabs(_w[j]), q - 2.0) : 0.0;
+                    _w[j] += rate * (y * _x[j] - lambda);
+                    sumnorm += std::pow(std::fabs(_w[j]), q);
+                }
+                return std::pow(sumnorm, 1.0 / q);
+            }
+        };
+
+        template<>
+        struct FixedMarginUpdate<1> {
+            double gamma, rate;
+
+            FixedMarginUpdate(double gamma, double rate, double): gamma(gamma), rate(rate) {}
+
+            template<typename T>
+            void prepare(const Data<T> &) {}
+
+            template<typename T>
+            double operator()(std::vector<double> &w, const std::vector<T> &x, double y, double norm) {
+                size_t j, dim = w.size();
+                double *_w = w.data(), sumnorm = 0.0, g = (norm > 0) ? gamma : 0.0;
+                const T *_x = x.data();
+
+                // the gradient of ||w||_1 is the sign of each coordinate, zero coordinates are not shrunk
+                for (j = 0; j < dim; ++j) {
+                    double sign = (_w[j] > 0) - (_w[j] < 0);
+                    _w[j] += rate * (y * _x[j] - g * sign);
+                    sumnorm += std::fabs(_w[j]);
+                }
+                return sumnorm;
+            }
+        };
+
+        template<>
+        struct FixedMarginUpdate<2> {
+            double gamma, rate;
+
+            FixedMarginUpdate(double gamma, double rate, double): gamma(gamma), rate(rate) {}
+
+            template<typename T>
+            void prepare(const Data<T> &) {}
+
+            /**
+             * With q = 2 the update is w = a*w + b*x, the new norm is summed in the same loop, so it's exact after
+             * every update and no pass over the weights is added.
+             */
+            template<typename T>
+            double operator()(std::vector<double> &w, const std::vector<T> &x, double y, double norm) {
+                size_t j, dim = w.size();
+                double *_w = w.data(), a = (norm > 0) ? 1 - rate * gamma / norm : 1.0, b = rate * y, sumnorm = 0.0;
+                const T *_x = x.data();
+
+                for (j = 0; j < dim; ++j) {
+                    _w[j] = a * _w[j] + b * _x[j];
+                    sumnorm += _w[j] * _w[j];
+                }
+                return std::sqrt(sumnorm);
+            }
+        };
+
+        template<>
+        struct FixedMarginUpdate<-1> {
+            double gamma, rate, eps;
+            /// Largest absolute weight, number of weights with that value and the maximum number seen.
+            double largest = 0.0;
+            int n = 0, max_n = 0;
+
+            FixedMarginUpdate(double gamma, double rate, double, double eps = 1e-7): gamma(gamma), rate(rate),
+                                                                                     eps(eps) {}
+
+            template<typename T>
+            void prepare(const Data<T> &data) { if (n <= 0) n = int(data.getDim()); }
+
+            /**
+             * The gradient of ||w||_inf only involves the weights tied with the largest absolute value, the
+             * update shrinks them and then finds the new largest value and its ties.
+             */
+            template<typename T>
+            double operator()(std::vector<double> &w, const std::vector<T> &x, double y, double norm) {
+                size_t j, dim = w.size();
+                double *_w = w.data(), g = (norm > 0) ? gamma / n : 0.0, largest_temp;
+                const T *_x = x.data();
+                int n_temp = 1;
+
+                for (j = 0; j < dim; ++j) {
+                    if (largest == 0 || std::fabs(largest - std::fabs(_w[j])) / largest < eps) {
+                        double sign = (_w[j] > 0) - (_w[j] < 0);
+                        _w[j] += rate * (y * _x[j] - g * sign);
+                    } else
+                        _w[j] += rate * (y * _x[j]);
+                }
+                largest_temp = std::fabs(_w[0]);
+                for (j = 1; j < dim; ++j) {
+                    double wj = std::fabs(_w[j]);
+                    if (std::fabs(largest_temp - wj) / largest_temp < eps)
+                        n_temp++;
+                    else if (wj > largest_temp) {
+                        largest_temp = wj;
+                        n_temp = 1;
+                    }
+                }
+                largest = largest_temp;
+                n = n_temp;
+                if (n > max_n) max_n = n;
+                return largest;
+            }
+        };
+    }
+}
+#endif
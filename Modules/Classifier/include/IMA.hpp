@@ -14,6 +14,7 @@
 #include "PrimalClassifier.hpp"
 #include "DualClassifier.hpp"
 #include "Perceptron.hpp"
+#include "FixedMarginUpdate.hpp"
 
 namespace mltk{
     namespace classifier {
@@ -27,6 +28,9 @@ namespace mltk{
             /// Support vector.
             std::vector<int> svs;
 
+        protected:
+            double labelThreshold() const override { return this->solution.margin * this->solution.norm; }
+
         public:
             explicit IMAp(std::shared_ptr<Data < T>
 
@@ -61,6 +65,15 @@ namespace mltk{
             /// Support vector.
             std::vector<int> svs;
 
+            /**
+             * \brief Training loop with the weight update specialized for the q norm.
+             */
+            template<int Q>
+            bool train_with(FixedMarginUpdate<Q> &update);
+
+        protected:
+            double labelThreshold() const override { return this->solution.margin * this->solution.norm; }
+
         public:
             explicit IMApFixedMargin(std::shared_ptr<Data < T>
 
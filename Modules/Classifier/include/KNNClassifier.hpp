@@ -8,7 +8,14 @@
 #include "PrimalClassifier.hpp"
 #include "DistanceMetric.hpp"
 #include "CoverTree.hpp"
+#include "KDTree.hpp"
+#include "BallTree.hpp"
+#include "HNSW.hpp"
 #include <assert.h>
+#include <deque>
+#include <limits>
+#include <type_traits>
+#include <unordered_map>
 
 namespace mltk{
         namespace classifier {
@@ -18,19 +25,161 @@ namespace mltk{
             template<typename T, typename Callable = metrics::dist::Euclidean<T> >
             class KNNClassifier : public PrimalClassifier<T> {
             private:
+                /// Metrics computed from the inner products in batchEvaluate.
+                enum InnerProductForm { NONE, EUCLIDEAN, SQUARED_EUCLIDEAN, COSINE };
+
+                static constexpr InnerProductForm inner_product_form =
+                        std::is_same<Callable, metrics::dist::Euclidean<T> >::value ? EUCLIDEAN :
+                        std::is_same<Callable, metrics::dist::SquaredEuclidean<T> >::value ? SQUARED_EUCLIDEAN :
+                        std::is_same<Callable, metrics::dist::Cosine<T> >::value ? COSINE : NONE;
+
                 /// Number k of neighbors to be considered
                 size_t k;
                 /// Function to compute the metrics between two points
                 Callable dist_function;
-                std::string algorithm;
+                /// Algorithm chosen by the user and the one used by the queries, "auto" is resolved by train.
+                std::string algorithm, method;
                 metrics::CoverTree<T, std::shared_ptr<Point<T>>, Callable> kquery;
+                metrics::KDTree<T, Callable> kdtree;
+                metrics::BallTree<T, Callable> balltree;
+                metrics::HNSW<T, Callable> hnsw;
+                /// Maximum number of points in the leaves of the KD-tree and ball tree.
+                size_t leaf_size = 40;
+                /// Classes of the samples, cached by train.
+                std::vector<int> classes;
+                /// Online mode: points of the stream by id, their ids and times in arrival order, and the window.
+                std::unordered_map<size_t, PointPointer<T> > stream_points;
+                std::deque<std::pair<size_t, double> > arrivals;
+                size_t next_id = 0, window_size = 0;
+                double window_time = std::numeric_limits<double>::infinity();
+                Timer stream_timer;
+                /// Tells if the times of the stream come from stream_timer, so the queries can expire points.
+                bool stream_clock = false;
+
+                /**
+                 * \brief Register the samples the model already has as the first points of the stream, the cover
+                 * tree is built with them. The samples are copied first, the stream changes its own copy and not
+                 * the data shared with the caller or other learners.
+                 */
+                void startStream();
+
+                /**
+                 * \brief Drop the KD-tree, ball tree or HNSW graph, which can't follow the changes of the stream,
+                 * the queries use brute force and getAlgorithm reports it until the next train.
+                 */
+                void dropIndex();
+
+                /**
+                 * \brief Evict the oldest points while the window is exceeded at the given time.
+                 */
+                void slideWindow(double time);
+
+                /**
+                 * \brief Drop what was computed from the samples: the classes, the indexes and the stream.
+                 */
+                void clearModel() {
+                    classes.clear();
+                    kquery = decltype(kquery)();
+                    kdtree.clear();
+                    balltree.clear();
+                    hnsw.clear();
+                    stream_points.clear();
+                    arrivals.clear();
+                    stream_clock = false;
+                }
+
+                /**
+                 * \brief Buffers reused by the queries, so evaluate doesn't allocate once they have grown.
+                 */
+                struct Scratch {
+                    /// Max-heap with the (distance, index) of the k nearest neighbors found so far.
+                    std::vector<std::pair<double, size_t> > heap;
+                    /// Labels of the neighbors and frequency of each class among them.
+                    std::vector<int> labels;
+                    std::vector<size_t> freqs;
+                };
+
+                /**
+                 * \brief Scratch of the calling thread, concurrent calls to evaluate don't share buffers.
+                 */
+                static Scratch &scratch() {
+                    static thread_local Scratch _scratch;
+                    return _scratch;
+                }
+
+                /**
+                 * \brief Find the k nearest neighbors with the KD-tree, the ball tree or the HNSW graph, if one is
+                 * built for the current samples.
+                 * \return bool false if no index can answer the query.
+                 */
+                bool indexSearch(const Point<T> &p, size_t _k, std::vector<std::pair<double, size_t> > &heap) const {
+                    if (!indexReady()) return false;
+                    if (method == "kdtree") kdtree.kNearest(p, _k, heap);
+                    else if (method == "balltree") balltree.kNearest(p, _k, heap);
+                    else hnsw.kNearest(p, _k, heap);
+                    return true;
+                }
+
+                /**
+                 * \brief Order of the distances when searching the neighbors, NaN after every number.
+                 */
+                static bool nearer(double a, double b) { return a < b || (std::isnan(b) && !std::isnan(a)); }
+
+                /**
+                 * \brief Order of the (distance, index) pairs of the brute force heap, ties broken by the index.
+                 */
+                static bool nearerPair(const std::pair<double, size_t> &a, const std::pair<double, size_t> &b) {
+                    return nearer(a.first, b.first) || (!nearer(b.first, a.first) && a.second < b.second);
+                }
+
+                bool indexReady() const {
+                    size_t n = this->samples->getSize();
+                    return (method == "kdtree" && kdtree.size() == n) ||
+                           (method == "balltree" && balltree.size() == n) || (method == "hnsw" && hnsw.size() == n);
+                }
+
+                /**
+                 * \brief Most frequent class among the labels of the neighbors, the first class wins the ties.
+                 * \param labels Labels of the neighbors.
+                 * \param _classes Classes of the samples.
+                 * \param freqs Buffer for the frequency of each class.
+                 * \param prob Smoothed frequency of the predicted class.
+                 * \return int
+                 */
+                int vote(const std::vector<int> &labels, const std::vector<int> &_classes, std::vector<size_t> &freqs,
+                         double &prob) const {
+                    size_t max_index = 0, max_freq = 0, i;
+                    double s = 0.0001;
+
+                    prob = 0.0;
+                    freqs.assign(_classes.size(), 0);
+                    for (auto const &label: labels) {
+                        i = std::find(_classes.begin(), _classes.end(), label) - _classes.begin();
+                        if (i < _classes.size()) freqs[i]++;
+                    }
+                    for (i = 0; i < _classes.size(); ++i) {
+                        if (freqs[i] > max_freq) {
+                            max_index = i;
+                            max_freq = freqs[i];
+                            prob = (max_freq + s) / (k + _classes.size() * s);
+                        }
+                    }
+                    return _classes[max_index];
+                }
             public:
                 KNNClassifier() = default;
+                /**
+                 * \param _k Number of neighbors.
+                 * \param _algorithm Search algorithm: "brute", "covertree", "kdtree" (Euclidean, SquaredEuclidean,
+                 * Manhattan and Chebyshev), "balltree" (metrics with the triangle inequality), "hnsw" (approximate,
+                 * for high dimensional data) or "auto", which picks the KD-tree for supported metrics up to 16
+                 * dimensions, then the ball tree, then brute force.
+                 */
                 explicit KNNClassifier(size_t _k, std::string _algorithm = "brute")
-                        : k(_k), algorithm(_algorithm) {}
+                        : k(_k), algorithm(_algorithm), method((_algorithm == "auto") ? "brute" : _algorithm) {}
 
                 KNNClassifier(Data<T> &_samples, size_t _k, std::string _algorithm = "brute")
-                        : k(_k), algorithm(_algorithm) {
+                        : k(_k), algorithm(_algorithm), method((_algorithm == "auto") ? "brute" : _algorithm) {
                     this->samples = mltk::make_data<T>(_samples);
                 }
 
@@ -38,71 +187,453 @@ namespace mltk{
 
                 double evaluate(const Point<T> &p, bool raw_value = false) override;
 
+                /**
+                 * \brief Classify all the points of a dataset at once.
+                 * With a KD-tree, ball tree, HNSW graph or cover tree the queries run in parallel. With brute force the queries are
+                 * processed in blocks, in parallel, against tiles of the packed training points,
+                 * keeping the k smallest distances of each query. For the Euclidean, SquaredEuclidean and Cosine
+                 * metrics the distances of a tile come from the inner products, ||q||^2 + ||x||^2 - 2q.x, so the
+                 * work is a blocked matrix product.
+                 * \param data Points to be classified.
+                 * \param raw_value Not used, the predicted classes are returned.
+                 * \return std::vector<double>
+                 */
+                std::vector<double> batchEvaluate(Data<T> &data, bool raw_value = false) override;
+
                 Callable& metric(){ return dist_function; }
+
+                /**
+                 * \brief Set the maximum number of points in the leaves of the KD-tree and ball tree.
+                 * \param _leaf_size Leaf size, 40 is the default.
+                 */
+                void setLeafSize(size_t _leaf_size) { this->leaf_size = _leaf_size; }
+
+                size_t getLeafSize() const { return leaf_size; }
+
+                /**
+                 * \brief HNSW graph used by the "hnsw" algorithm, to set its parameters before train, to save it
+                 * after train or to load a saved graph of the same samples instead of training, after setSamples.
+                 * \return metrics::HNSW<T, Callable>&
+                 */
+                metrics::HNSW<T, Callable> &hnswIndex() { return hnsw; }
+
+                /**
+                 * \brief Returns the search algorithm used by the queries, with "auto" resolved after train.
+                 * \return std::string
+                 */
+                std::string getAlgorithm() const { return method; }
+
+                /**
+                 * \brief Add a labeled point to the model without retraining, for streams. The point is copied
+                 * into the samples and inserted in the cover tree, and the oldest points are evicted when the
+                 * window is exceeded. The first call copies the samples, so the data given to the model is not
+                 * changed. The KD-tree, ball tree and HNSW graph can't be updated, they are dropped and the queries
+                 * use brute force, as getAlgorithm reports, until the next train.
+                 * \param p Point with its label.
+                 * \param time Arrival time of the point for the time window, the seconds since the model was
+                 * created when negative.
+                 * \return size_t Id of the point in the stream, used by evict, or the largest size_t value if the
+                 * point doesn't have the dimension of the samples.
+                 */
+                size_t partialFit(const Point<T> &p, double time = -1);
+
+                /**
+                 * \brief Remove a point added by partialFit, or one of the samples present when the stream
+                 * started, whose ids are their positions in the samples.
+                 * \param id Id of the point in the stream.
+                 * \return bool false if there's no point with the id.
+                 */
+                bool evict(size_t id);
+
+                /**
+                 * \brief Set the sliding window of the online mode, the oldest points are evicted by partialFit
+                 * when the window is exceeded. When partialFit takes the times from the model's clock, evaluate
+                 * and batchEvaluate also evict the points older than max_age first, so in that case the queries
+                 * change the model and must not run concurrently.
+                 * \param max_points Maximum number of points kept, 0 for no limit.
+                 * \param max_age Maximum age of the points, in the unit of the times given to partialFit.
+                 */
+                void setWindow(size_t max_points, double max_age = std::numeric_limits<double>::infinity()) {
+                    this->window_size = max_points;
+                    this->window_time = max_age;
+                }
+
+                /**
+                 * \brief Evict the points older than the maximum age of the window, for streams with their own
+                 * times, before querying the model.
+                 * \param time Current time, the seconds since the model was created when negative.
+                 */
+                void expire(double time = -1) {
+                    if (arrivals.empty() || !(window_time < std::numeric_limits<double>::infinity())) return;
+                    slideWindow((time < 0) ? stream_timer.Elapsed() / 1000 : time);
+                }
+
+                /**
+                 * \brief Returns the number of points in the window of the online mode.
+                 * \return size_t
+                 */
+                size_t getWindowCount() const { return stream_points.size(); }
+
+                /**
+                 * \brief Set the samples, the indexes built by train are dropped, so the queries use brute force
+                 * until the next train.
+                 */
+                void setSamples(const Data<T> &samples) override {
+                    Learner<T>::setSamples(samples);
+                    clearModel();
+                }
+
+                void setSamples(DataPointer<T> samples) override {
+                    Learner<T>::setSamples(samples);
+                    clearModel();
+                }
             };
 
             template<typename T, typename Callable>
             double KNNClassifier<T, Callable>::evaluate(const Point<T> &p, bool raw_value) {
-                auto points = this->samples->getPoints();
-                std::vector<double> distances(this->samples->getSize());
-                std::vector<int> classes = this->samples->getClasses();
-                std::vector<size_t> idx(distances.size());
-                std::vector<PointPointer<T>> neigh;
-                auto p0 = std::make_shared<Point<T> >(p);
-
-                if(algorithm == "brute"){
-                    // fill the index vector
-                    std::iota(idx.begin(), idx.end(), 0);
-
-                    // compute the metrics from the sample to be evaluated to the samples vector
-                    std::transform(points.begin(), points.end(), distances.begin(),
-                                   [&p0, this](const std::shared_ptr<Point<T> > q) {
-                                       return this->dist_function(*p0, *q);
-                                   });
-
-                    // sort the index vector by the metrics from the sample to be evaluated
-                    std::nth_element(idx.begin(), idx.begin() + this->k, idx.end(), [&distances](size_t i1, size_t i2) {
-                        return distances[i1] < distances[i2];
-                    });
-                }else if(algorithm == "covertree"){
-                    neigh = kquery.kNearestNeighbors(mltk::make_point<T>(p), k);
+                if (stream_clock) expire();
+                Scratch &scratch = this->scratch();
+                auto &heap = scratch.heap;
+                auto &labels = scratch.labels;
+                std::vector<int> fallback;
+                const std::vector<int> &_classes = (classes.empty()) ? (fallback = this->samples->getClasses()) : classes;
+                size_t n = this->samples->getSize(), _k = std::min(this->k, n);
+
+                heap.clear();
+                labels.clear();
+                if (indexSearch(p, _k, heap)) {
+                    for (auto const &neighbor: heap) labels.push_back((*this->samples)[neighbor.second]->Y());
+                }else if(method != "covertree" || !kquery.getRoot()){
+                    // without a cover tree built for the samples the neighbors are found by brute force
+                    // bounded max-heap with the k smallest distances found so far, once it's full the distances
+                    // stop early when they can't enter it
+                    for (size_t j = 0; j < n; ++j) {
+                        double bound = (heap.empty() || heap.size() < _k) ?
+                                       std::numeric_limits<double>::infinity() : heap.front().first;
+                        double d = metrics::dist::boundedDistance(this->dist_function, p, *(*this->samples)[j], bound);
+
+                        if (heap.size() < _k) {
+                            heap.emplace_back(d, j);
+                            std::push_heap(heap.begin(), heap.end(), nearerPair);
+                        } else if (_k > 0 && nearer(d, heap.front().first)) {
+                            std::pop_heap(heap.begin(), heap.end(), nearerPair);
+                            heap.back() = std::make_pair(d, j);
+                            std::push_heap(heap.begin(), heap.end(), nearerPair);
+                        }
+                    }
+                    for (auto const &neighbor: heap) labels.push_back((*this->samples)[neighbor.second]->Y());
+                }else{
+                    for (auto const &neighbor: kquery.kNearestNeighbors(mltk::make_point<T>(p), k))
+                        labels.push_back(neighbor->Y());
                 }
                 // find the most frequent class in the k nearest neighbors
-                size_t max_index = 0, max_freq = 0, i=0;
-                double s = 0.0001, max_prob = 0.0;
-                std::for_each(classes.begin(), classes.end(), [&idx, &points, &i, &max_freq, &max_index, &max_prob, &s, &classes,&neigh, this](int c){
-                    int freq = 0;
-                    if(algorithm == "brute") {
-                        freq = std::count_if(idx.begin(), idx.begin() + this->k, [&points, &c](size_t id) {
-                            return points[id]->Y() == c;
-                        });
-                    }else if(algorithm == "covertree"){
-                        freq = std::count_if(neigh.begin(), neigh.end(), [&c](auto point) {
-                            return point->Y() == c;
-                        });
+                double max_prob;
+                int prediction = vote(labels, _classes, scratch.freqs, max_prob);
+                #pragma omp atomic write
+                this->pred_prob = max_prob;
+                return prediction;
+            }
+
+            template<typename T, typename Callable>
+            std::vector<double> KNNClassifier<T, Callable>::batchEvaluate(Data<T> &data, bool raw_value) {
+                if (stream_clock) expire();
+                const size_t query_block = 64, ref_block = 256;
+                size_t n = data.getSize(), n_refs = this->samples->getSize(), dim = this->samples->getDim();
+                size_t _k = std::min(this->k, n_refs), n_blocks = (n + query_block - 1) / query_block;
+                std::vector<double> predictions(n, 0.0), refs, ref_norms;
+                std::vector<int> classes = (this->classes.empty()) ? this->samples->getClasses() : this->classes;
+                std::vector<int> labels(n_refs);
+                // training points packed one after the other, for the metrics without a bounded operator
+                std::vector<T> packed;
+
+                if (n > 0 && data.getDim() != dim) {
+                    std::cerr << "The points must have the same dimension of the feature set!" << std::endl;
+                    return predictions;
+                }
+                if (_k > 0 && indexReady()) {
+                    #pragma omp parallel for schedule(dynamic, 64)
+                    for (long i = 0; i < (long) n; ++i) {
+                        Scratch &_scratch = this->scratch();
+                        double prob;
+
+                        indexSearch(*data[i], _k, _scratch.heap);
+                        _scratch.labels.clear();
+                        for (auto const &neighbor: _scratch.heap)
+                            _scratch.labels.push_back((*this->samples)[neighbor.second]->Y());
+                        predictions[i] = vote(_scratch.labels, classes, _scratch.freqs, prob);
                     }
+                    return predictions;
+                }
+                if (method == "covertree" && _k > 0 && kquery.getRoot()) {
+                    auto neighbors = kquery.kNearestNeighbors(data.getPoints(), k);
+                    std::vector<size_t> freqs;
+                    std::vector<int> neighbor_labels;
 
-                    if(freq > max_freq){
-                        double prob = (freq+s)/(k+classes.size()*s);
-                        max_index = i;
-                        max_freq = freq;
-                        max_prob = prob;
+                    for (size_t i = 0; i < n; ++i) {
+                        double prob;
+
+                        neighbor_labels.clear();
+                        for (auto const &neighbor: neighbors[i]) neighbor_labels.push_back(neighbor->Y());
+                        predictions[i] = vote(neighbor_labels, classes, freqs, prob);
                     }
-                    i++;
-                });
-                this->pred_prob = max_prob;
-                return classes[max_index];
+                    return predictions;
+                }
+                if (method != "brute" || _k == 0) return Learner<T>::batchEvaluate(data, raw_value);
+                for (size_t j = 0; j < n_refs; ++j) labels[j] = (*this->samples)[j]->Y();
+                if (inner_product_form != NONE) {
+                    refs.resize(n_refs * dim);
+                    ref_norms.assign(n_refs, 0.0);
+                    for (size_t j = 0; j < n_refs; ++j) {
+                        auto const &x = (*this->samples)[j]->X();
+                        double *r = refs.data() + j * dim;
+
+                        for (size_t d = 0; d < dim; ++d) {
+                            r[d] = x[d];
+                            ref_norms[j] += r[d] * r[d];
+                        }
+                    }
+                } else if (!metrics::dist::HasBoundedDistance<Callable, T>::value) {
+                    packed.resize(n_refs * dim);
+                    for (size_t j = 0; j < n_refs; ++j)
+                        std::copy((*this->samples)[j]->X().begin(), (*this->samples)[j]->X().end(),
+                                  packed.begin() + j * dim);
+                }
+
+                #pragma omp parallel for schedule(dynamic)
+                for (long b = 0; b < (long) n_blocks; ++b) {
+                    size_t begin = b * query_block, end = std::min(n, begin + query_block), m = end - begin;
+                    std::vector<double> queries, query_norms(m, 0.0), tile(m * ref_block);
+                    // k smallest distances of each query, sorted, and the index of their points
+                    std::vector<double> best(m * _k, std::numeric_limits<double>::infinity());
+                    std::vector<size_t> best_idx(m * _k, 0), filled(m, 0);
+                    std::vector<size_t> freqs(classes.size());
+                    std::vector<int> neighbor_labels;
+
+                    auto push = [&](size_t i, double d, size_t j) {
+                        double *bd = best.data() + i * _k;
+                        size_t *bi = best_idx.data() + i * _k, pos;
+
+                        // the first k distances always enter, so every slot voting holds a training point
+                        if (filled[i] < _k) pos = filled[i]++;
+                        else if (nearer(d, bd[_k - 1])) pos = _k - 1;
+                        else return;
+                        for (; pos > 0 && nearer(d, bd[pos - 1]); --pos) {
+                            bd[pos] = bd[pos - 1];
+                            bi[pos] = bi[pos - 1];
+                        }
+                        bd[pos] = d;
+                        bi[pos] = j;
+                    };
+
+                    if (inner_product_form != NONE) {
+                        queries.resize(m * dim);
+                        for (size_t i = 0; i < m; ++i) {
+                            auto const &x = data[begin + i]->X();
+                            double *q = queries.data() + i * dim;
+
+                            for (size_t d = 0; d < dim; ++d) {
+                                q[d] = x[d];
+                                query_norms[i] += q[d] * q[d];
+                            }
+                        }
+                        for (size_t r0 = 0; r0 < n_refs; r0 += ref_block) {
+                            size_t r1 = std::min(n_refs, r0 + ref_block), nr = r1 - r0, i = 0;
+
+                            // inner products of four queries at a time, so each training point is loaded once
+                            for (; i + 4 <= m; i += 4) {
+                                const double *q0 = queries.data() + i * dim, *q1 = q0 + dim, *q2 = q1 + dim,
+                                        *q3 = q2 + dim;
+                                for (size_t j = 0; j < nr; ++j) {
+                                    const double *x = refs.data() + (r0 + j) * dim;
+                                    double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+
+                                    #pragma omp simd reduction(+:s0, s1, s2, s3)
+                                    for (size_t d = 0; d < dim; ++d) {
+                                        s0 += q0[d] * x[d];
+                                        s1 += q1[d] * x[d];
+                                        s2 += q2[d] * x[d];
+                                        s3 += q3[d] * x[d];
+                                    }
+                                    tile[i * nr + j] = s0;
+                                    tile[(i + 1) * nr + j] = s1;
+                                    tile[(i + 2) * nr + j] = s2;
+                                    tile[(i + 3) * nr + j] = s3;
+                                }
+                            }
+                            for (; i < m; ++i) {
+                                const double *q = queries.data() + i * dim;
+                                for (size_t j = 0; j < nr; ++j) {
+                                    const double *x = refs.data() + (r0 + j) * dim;
+                                    double sum = 0;
+
+                                    #pragma omp simd reduction(+:sum)
+                                    for (size_t d = 0; d < dim; ++d) sum += q[d] * x[d];
+                                    tile[i * nr + j] = sum;
+                                }
+                            }
+
+                            for (i = 0; i < m; ++i) {
+                                for (size_t j = 0; j < nr; ++j) {
+                                    double dot = tile[i * nr + j], d;
+
+                                    if (inner_product_form == COSINE) {
+                                        // a zero point is at distance 1 of every point, as in the metric functor
+                                        double den = std::sqrt(query_norms[i]) * std::sqrt(ref_norms[r0 + j]);
+                                        d = (den > 0) ? 1 - dot / den : 1.0;
+                                    } else {
+                                        d = query_norms[i] + ref_norms[r0 + j] - 2 * dot;
+                                        if (d < 0) d = 0; // rounding, NaN is kept
+                                        if (inner_product_form == EUCLIDEAN) d = std::sqrt(d);
+                                    }
+                                    // same precision as the metric functor used by evaluate
+                                    push(i, double(static_cast<T>(d)), r0 + j);
+                                }
+                            }
+                        }
+                    } else if (metrics::dist::HasBoundedDistance<Callable, T>::value) {
+                        for (size_t i = 0; i < m; ++i) {
+                            auto const &q = *data[begin + i];
+                            for (size_t j = 0; j < n_refs; ++j)
+                                push(i, metrics::dist::boundedDistance(this->dist_function, q, *(*this->samples)[j],
+                                                                       best[i * _k + _k - 1]), j);
+                        }
+                    } else {
+                        // metrics that can't stop early compute a block of training points per call
+                        std::vector<T> dists(ref_block);
+
+                        for (size_t r0 = 0; r0 < n_refs; r0 += ref_block) {
+                            size_t nr = std::min(n_refs, r0 + ref_block) - r0;
+
+                            for (size_t i = 0; i < m; ++i) {
+                                metrics::dist::batchDistances(this->dist_function, *data[begin + i],
+                                                              packed.data() + r0 * dim, nr, dists.data());
+                                for (size_t j = 0; j < nr; ++j) push(i, dists[j], r0 + j);
+                            }
+                        }
+                    }
+
+                    // most frequent class among the neighbors, as in evaluate
+                    for (size_t i = 0; i < m; ++i) {
+                        double prob;
+
+                        neighbor_labels.clear();
+                        for (size_t r = 0; r < filled[i]; ++r)
+                            neighbor_labels.push_back(labels[best_idx[i * _k + r]]);
+                        predictions[begin + i] = vote(neighbor_labels, classes, freqs, prob);
+                    }
+                }
+                return predictions;
             }
 
             template<typename T, typename Callable>
             bool KNNClassifier<T, Callable>::train() {
-                if(algorithm == "covertree") {
-                    for (const auto &point: this->samples->getPoints()) {
-                        kquery.insert(point);
-                    }
+                classes = this->samples->getClasses();
+                method = algorithm;
+                if (algorithm == "auto") {
+                    if (metrics::KDTree<T, Callable>::supportsMetric() && this->samples->getDim() <= 16)
+                        method = "kdtree";
+                    else if (metrics::dist::IsTrueMetric<Callable>::value) method = "balltree";
+                    else method = "brute";
+                }
+                if(method == "covertree") {
+                    kquery.metric() = dist_function;
+                    kquery.build(this->samples->getPoints());
+                } else if (method == "kdtree") {
+                    kdtree.setLeafSize(leaf_size);
+                    return kdtree.build(*this->samples);
+                } else if (method == "balltree") {
+                    balltree.metric() = dist_function;
+                    balltree.setLeafSize(leaf_size);
+                    return balltree.build(*this->samples);
+                } else if (method == "hnsw") {
+                    hnsw.metric() = dist_function;
+                    return hnsw.build(*this->samples);
+                }
+                return true;
+            }
+
+            template<typename T, typename Callable>
+            void KNNClassifier<T, Callable>::startStream() {
+                if (!this->samples) this->samples = mltk::make_data<T>();
+                if (!stream_points.empty() || !arrivals.empty()) return;
+                this->samples = mltk::make_data<T>(*this->samples);
+                for (size_t i = 0; i < this->samples->getSize(); ++i) {
+                    stream_points[i] = (*this->samples)[i];
+                    arrivals.emplace_back(i, 0.0);
+                }
+                next_id = std::max(next_id, this->samples->getSize());
+                if (method == "covertree") {
+                    kquery.metric() = dist_function;
+                    kquery.build(this->samples->getPoints());
+                }
+            }
+
+            template<typename T, typename Callable>
+            void KNNClassifier<T, Callable>::dropIndex() {
+                if (method != "kdtree" && method != "balltree" && method != "hnsw") return;
+                if (this->verbose)
+                    std::cerr << "The " << method << " index can't follow the stream, the queries use brute force "
+                              << "until the next train." << std::endl;
+                kdtree.clear();
+                balltree.clear();
+                hnsw.clear();
+                method = "brute";
+            }
+
+            template<typename T, typename Callable>
+            size_t KNNClassifier<T, Callable>::partialFit(const Point<T> &p, double time) {
+                startStream();
+                if (this->samples->getSize() > 0 && p.size() != this->samples->getDim()) {
+                    std::cerr << "The points must have the same dimension of the feature set!" << std::endl;
+                    return std::numeric_limits<size_t>::max();
+                }
+                stream_clock = time < 0;
+                if (time < 0) time = stream_timer.Elapsed() / 1000;
+
+                auto point = mltk::make_point<T>(p);
+                size_t id = next_id++;
+                this->samples->insertPoint(point);
+                if (method == "covertree") kquery.insert(point);
+                dropIndex();
+                if (!classes.empty() && std::find(classes.begin(), classes.end(), int(point->Y())) == classes.end())
+                    classes.push_back(point->Y());
+                stream_points[id] = point;
+                arrivals.emplace_back(id, time);
+                slideWindow(time);
+                return id;
+            }
+
+            template<typename T, typename Callable>
+            bool KNNClassifier<T, Callable>::evict(size_t id) {
+                startStream();
+                auto it = stream_points.find(id);
+
+                if (it == stream_points.end()) return false;
+                this->samples->removePoint(it->second);
+                if (method == "covertree") kquery.remove(it->second);
+                dropIndex();
+                stream_points.erase(it);
+                // the arrivals of evicted points are dropped lazily, compact when they are the majority
+                while (!arrivals.empty() && stream_points.find(arrivals.front().first) == stream_points.end())
+                    arrivals.pop_front();
+                if (arrivals.size() > 2 * stream_points.size() + 64) {
+                    std::deque<std::pair<size_t, double> > alive;
+                    for (auto const &arrival: arrivals)
+                        if (stream_points.count(arrival.first)) alive.push_back(arrival);
+                    arrivals.swap(alive);
                 }
                 return true;
             }
+
+            template<typename T, typename Callable>
+            void KNNClassifier<T, Callable>::slideWindow(double time) {
+                while (!arrivals.empty() && ((window_size > 0 && stream_points.size() > window_size) ||
+                                             arrivals.front().second < time - window_time)) {
+                    size_t id = arrivals.front().first;
+                    arrivals.pop_front();
+                    evict(id);
+                }
+            }
         }
 }
 
@@ -9,6 +9,10 @@
 #include "DualClassifier.hpp"
 #include "Sampling.hpp"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace mltk{
         namespace classifier {
             /**
@@ -23,6 +27,10 @@ namespace mltk{
                 OverSampling<T> *samp_method;
                 /// Vector of binary base learners
                 std::vector<LearnerPointer> base_learners;
+                /// Kernels owned by the dual base learners, so they can be trained at the same time.
+                std::vector<std::shared_ptr<Kernel> > kernels;
+                /// Number of base learners trained at the same time, 0 uses all the available threads.
+                size_t n_threads = 1;
 
             public:
                 OneVsAll() = default;
@@ -39,6 +47,12 @@ namespace mltk{
                         for (size_t i = 0; i < this->samples->getClasses().size(); ++i) {
                             // copy the parameters of the given classifier
                             base_learners[i] = std::make_shared<ClassifierType<T> >(classifier);
+                            // each dual learner computes its own kernel matrix
+                            auto dual = std::dynamic_pointer_cast<DualClassifier<T> >(base_learners[i]);
+                            if (dual && dual->getKernel()) {
+                                kernels.push_back(std::make_shared<Kernel>(*dual->getKernel()));
+                                dual->setKernel(kernels.back().get());
+                            }
                         }
                     }
                 }
@@ -47,17 +61,35 @@ namespace mltk{
 
                 double evaluate(const Point<T> &p, bool raw_value = false) override;
 
+                std::vector<double> batchEvaluate(Data<T> &data, bool raw_value = false) override {
+                    return Learner<T>::batchEvaluate(data, raw_value);
+                }
+
                 std::string getFormulationString() override;
 
+                /**
+                 * \brief Set the number of base learners trained at the same time.
+                 * \param threads Number of threads, 0 uses all the available threads (1 is the default).
+                 */
+                void setThreads(size_t threads) { this->n_threads = threads; }
+
+                size_t getThreads() const { return n_threads; }
             };
 
             template<typename T>
             bool OneVsAll<T>::train() {
                 auto classes = this->samples->getClasses();
-                size_t current_class = 0, j, n_classes = classes.size(), size = this->samples->getSize();
-
-                // iterate over each base learner
-                for (auto &learner: base_learners) {
+                long n_learners = base_learners.size();
+                int threads = 1;
+
+#ifdef _OPENMP
+                threads = (n_threads > 0) ? int(n_threads) : omp_get_max_threads();
+#endif
+                // each base learner is independent, the seed of each one depends only on its class
+                #pragma omp parallel for schedule(dynamic) num_threads(threads) if(threads > 1)
+                for (long current_class = 0; current_class < n_learners; current_class++) {
+                    auto &learner = base_learners[current_class];
+                    size_t j, size = this->samples->getSize();
                     Data<T> temp_samples;
 
                     // copy samples and set all classes not being considered to -1
@@ -70,15 +102,18 @@ namespace mltk{
                     // if a over sampling algorithm were given, apply it
                     if (samp_method) {
                         temp_samples.computeClassesDistribution();
+                        #pragma omp critical(one_vs_all_sampling)
                         (*samp_method)(temp_samples);
                     }
 
                     // train the current learner
+                    learner->setSeed(this->seed + current_class);
                     learner->setSamples(temp_samples);
+                    // the learners trained at the same time would interleave their output, so they train silently
+                    int learner_verbose = learner->getVerbose();
+                    if (threads > 1) learner->setVerbose(0);
                     learner->train();
-
-                    // consider the next class
-                    current_class++;
+                    learner->setVerbose(learner_verbose);
                 }
 
                 return true;
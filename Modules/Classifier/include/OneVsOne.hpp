@@ -10,6 +10,10 @@
 #include "DualClassifier.hpp"
 #include "Sampling.hpp"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace mltk{
     namespace classifier {
         /**
@@ -17,12 +21,27 @@ namespace mltk{
          */
         template<typename T>
         class OneVsOne : public PrimalClassifier<T>, public DualClassifier<T> {
+        public:
+            /// How the binary learners are combined to classify a point.
+            enum DecisionMode {
+                /// Each of the k(k-1)/2 learners votes, the class with more votes wins.
+                VOTING,
+                /// Decision DAG: each of the k-1 evaluations discards one candidate class.
+                DAG
+            };
+
         private:
             using LearnerPointer = std::shared_ptr<Learner<T> >;
-            /// Matrix of binary base learners
+            /// Matrix of binary base learners, only the pairs i < j are used
             std::vector<std::vector<LearnerPointer> > base_learners;
+            /// Decision mode used by evaluate.
+            DecisionMode decision = VOTING;
             /// Over sampling method used during training (optional)
             OverSampling<T> *samp_method;
+            /// Kernels owned by the dual base learners, so they can be trained at the same time.
+            std::vector<std::shared_ptr<Kernel> > kernels;
+            /// Number of base learners trained at the same time, 0 uses all the available threads.
+            size_t n_threads = 1;
 
         public:
             OneVsOne() = default;
@@ -42,9 +61,15 @@ namespace mltk{
                     for (size_t i = 0; i < classes.size(); ++i) {
                         base_learners[i].resize(classes.size());
 
-                        for (size_t j = 0; j < base_learners[i].size(); ++j) {
+                        for (size_t j = i + 1; j < base_learners[i].size(); ++j) {
                             if (classes[i] != classes[j]) {
                                 base_learners[i][j] = std::make_shared<ClassifierType<T> >(classifier);
+                                // each dual learner computes its own kernel matrix
+                                auto dual = std::dynamic_pointer_cast<DualClassifier<T> >(base_learners[i][j]);
+                                if (dual && dual->getKernel()) {
+                                    kernels.push_back(std::make_shared<Kernel>(*dual->getKernel()));
+                                    dual->setKernel(kernels.back().get());
+                                }
                             }
                         }
                     }
@@ -55,40 +80,75 @@ namespace mltk{
 
             double evaluate(const Point<T> &p, bool raw_value = false) override;
 
+            std::vector<double> batchEvaluate(Data<T> &data, bool raw_value = false) override {
+                return Learner<T>::batchEvaluate(data, raw_value);
+            }
+
             std::string getFormulationString() override;
+
+            /**
+             * \brief Set the number of base learners trained at the same time.
+             * \param threads Number of threads, 0 uses all the available threads (1 is the default).
+             */
+            void setThreads(size_t threads) { this->n_threads = threads; }
+
+            size_t getThreads() const { return n_threads; }
+
+            /**
+             * \brief Set how the binary learners are combined, VOTING is the default.
+             * \param mode Decision mode.
+             */
+            void setDecisionMode(DecisionMode mode) { this->decision = mode; }
+
+            DecisionMode getDecisionMode() const { return decision; }
         };
 
         template<typename T>
         bool OneVsOne<T>::train() {
             auto classes = this->samples->getClasses();
-            size_t current_class = 0, j, n_classes = classes.size(), size = this->samples->getSize();
+            size_t n_classes = classes.size();
+            std::vector<std::pair<size_t, size_t> > pairs;
+            int threads = 1;
 
             for (size_t i = 0; i < n_classes; ++i) {
-                for (size_t j = 0; j < n_classes; ++j) {
-                    if (classes[i] != classes[j]) {
-                        Data<T> temp_samples;
-                        auto learner = base_learners[i][j];
-                        std::vector<int> current_classes = {classes[i], classes[j]};
-
-                        // Copy the points with the classes being trained
-                        temp_samples.classesCopy(*this->samples, current_classes);
-                        temp_samples.setClasses({-1, 1});
-                        // Transform the classes for binary classification
-                        for (size_t k = 0; k < temp_samples.getSize(); k++) {
-                            temp_samples[k]->Y() = (temp_samples[k]->Y() == classes[i]) ? 1 : -1;
-                        }
-
-                        // If a over sampling algorithm was given, apply it to the samples
-                        if (samp_method) {
-                            temp_samples.computeClassesDistribution();
-                            (*samp_method)(temp_samples);
-                        }
+                for (size_t j = i + 1; j < n_classes; ++j) {
+                    if (classes[i] != classes[j]) pairs.emplace_back(i, j);
+                }
+            }
+#ifdef _OPENMP
+            threads = (n_threads > 0) ? int(n_threads) : omp_get_max_threads();
+#endif
+            // each pair is independent, the seed of each learner depends only on its pair
+            #pragma omp parallel for schedule(dynamic) num_threads(threads) if(threads > 1)
+            for (long p = 0; p < long(pairs.size()); ++p) {
+                size_t i = pairs[p].first, j = pairs[p].second;
+                Data<T> temp_samples;
+                auto learner = base_learners[i][j];
+                std::vector<int> current_classes = {classes[i], classes[j]};
+
+                // Copy the points with the classes being trained
+                temp_samples.classesCopy(*this->samples, current_classes);
+                temp_samples.setClasses({-1, 1});
+                // Transform the classes for binary classification
+                for (size_t k = 0; k < temp_samples.getSize(); k++) {
+                    temp_samples[k]->Y() = (temp_samples[k]->Y() == classes[i]) ? 1 : -1;
+                }
 
-                        // train the current binary learner
-                        learner->setSamples(temp_samples);
-                        learner->train();
-                    }
+                // If a over sampling algorithm was given, apply it to the samples
+                if (samp_method) {
+                    temp_samples.computeClassesDistribution();
+                    #pragma omp critical(one_vs_one_sampling)
+                    (*samp_method)(temp_samples);
                 }
+
+                // train the current binary learner
+                learner->setSeed(this->seed + p);
+                learner->setSamples(temp_samples);
+                // the learners trained at the same time would interleave their output, so they train silently
+                int learner_verbose = learner->getVerbose();
+                if (threads > 1) learner->setVerbose(0);
+                learner->train();
+                learner->setVerbose(learner_verbose);
             }
 
             return true;
@@ -97,11 +157,23 @@ namespace mltk{
         template<typename T>
         double OneVsOne<T>::evaluate(const Point<T> &p, bool raw_value) {
             auto classes = this->samples->getClasses();
+
+            if (decision == DAG) {
+                // the learner of the first and last candidates discards one of them
+                size_t first = 0, last = classes.size() - 1;
+
+                while (first < last) {
+                    if (base_learners[first][last]->evaluate(p) == 1) last--;
+                    else first++;
+                }
+                return classes[first];
+            }
+
             std::vector<size_t> class_votes(classes.size(), 0);
 
             // classify the given point as the class with maximum votes
             for (size_t i = 0; i < base_learners.size(); ++i) {
-                for (size_t j = 0; j < base_learners[i].size(); ++j) {
+                for (size_t j = i + 1; j < base_learners[i].size(); ++j) {
                     if (classes[i] != classes[j]) {
                         if (base_learners[i][j]->evaluate(p) == 1) {
                             class_votes[i]++;
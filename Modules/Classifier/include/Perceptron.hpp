@@ -8,21 +8,166 @@
 
 #include "PrimalClassifier.hpp"
 #include "DualClassifier.hpp"
+#include "FixedMarginUpdate.hpp"
 #include <chrono>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace mltk{
     namespace classifier {
         using namespace std::chrono;
 
+        /// Training modes of the primal perceptrons.
+        enum PerceptronMode {
+            /// One sample at a time over the whole data.
+            SEQUENTIAL_UPDATES,
+            /// Iterative parameter mixing: one perceptron per shard of the data, averaged after each round.
+            PARAMETER_MIXING
+        };
+
+        /**
+         * \brief Base of the primal perceptrons that can also be trained in parallel by iterative parameter mixing.
+         *
+         * The samples are split in one contiguous shard per thread. At each round every thread starts from the
+         * current weights and runs the perceptron over the next batch of samples of its shard, then the weights
+         * and bias of the threads are averaged into the current ones. Training stops after an epoch without
+         * mistakes, and the solution is then the current weights, which separate the samples. Otherwise the
+         * solution is the average of the weights after each round (averaged perceptron), which is less sensitive
+         * to the last updates.
+         * The result depends on the number of threads, but not on the thread scheduling.
+         */
+        template<typename T>
+        class ParallelPerceptron : public PrimalClassifier<T> {
+        protected:
+            PerceptronMode mode = SEQUENTIAL_UPDATES;
+            size_t n_threads = 0;
+            size_t batch_size = 0;
+
+            /**
+             * \brief Train by iterative parameter mixing from the given weights and bias.
+             * \param w Weights, replaced by the mixed weights if the last epoch made no mistakes, or else by their
+             * average over the rounds.
+             * \param bias Bias, replaced like the weights.
+             * \return bool true if the last epoch made no mistakes, the returned weights and bias then classify all
+             * the samples correctly.
+             */
+            bool trainParameterMixing(std::vector<double> &w, double &bias) {
+                size_t size = this->samples->getSize(), dim = this->samples->getDim(), s, j, rounds = 0;
+                size_t shards = n_threads, longest = 0, errors = 0;
+                double time = this->start_time + this->max_time, avg_bias = 0.0;
+                std::vector<double> avg_w(dim, 0.0);
+
+#ifdef _OPENMP
+                if (shards == 0) shards = omp_get_max_threads();
+#endif
+                shards = std::max<size_t>(1, std::min(std::max<size_t>(shards, 1), size));
+                if (w.size() != dim) w.assign(dim, 0.0);
+
+                std::vector<size_t> begin(shards + 1);
+                for (s = 0; s <= shards; ++s) begin[s] = s * size / shards;
+                for (s = 0; s < shards; ++s) longest = std::max(longest, begin[s + 1] - begin[s]);
+                size_t step = (batch_size > 0) ? batch_size : longest;
+                std::vector<std::vector<double> > local_w(shards, std::vector<double>(dim));
+                std::vector<double> local_bias(shards);
+                std::vector<size_t> local_errors(shards);
+
+                while (this->timer.Elapsed() - time <= 0) {
+                    errors = 0;
+                    for (size_t offset = 0; offset < longest; offset += step) {
+                        #pragma omp parallel for schedule(static, 1) num_threads(shards) if(shards > 1)
+                        for (long t = 0; t < (long) shards; ++t) {
+                            std::vector<double> &lw = local_w[t];
+                            double lbias = bias;
+                            size_t first = begin[t] + offset, last = std::min(begin[t + 1], first + step), e = 0;
+
+                            std::copy(w.begin(), w.end(), lw.begin());
+                            for (size_t i = first; i < last; ++i) {
+                                auto const &point = (*this->samples)[i];
+                                const T *x = point->X().data();
+                                double y = point->Y(), func = lbias;
+
+                                for (size_t k = 0; k < dim; ++k) func += lw[k] * x[k];
+                                if (y * func <= 0.0) {
+                                    for (size_t k = 0; k < dim; ++k) lw[k] += this->rate * y * x[k];
+                                    lbias += this->rate * y;
+                                    e++;
+                                }
+                            }
+                            local_bias[t] = lbias;
+                            local_errors[t] = e;
+                        }
+
+                        for (j = 0; j < dim; ++j) {
+                            double sum = 0.0;
+                            for (s = 0; s < shards; ++s) sum += local_w[s][j];
+                            w[j] = sum / shards;
+                            avg_w[j] += w[j];
+                        }
+                        for (bias = 0.0, s = 0; s < shards; ++s) {
+                            bias += local_bias[s] / shards;
+                            errors += local_errors[s];
+                        }
+                        avg_bias += bias;
+                        rounds++;
+                    }
+                    this->ctot += errors;
+                    this->steps++;
+
+                    if (errors == 0) break;
+                    if (this->steps > this->MAX_IT || this->steps >= this->MAX_EPOCH) break;
+                    if (this->ctot > this->MAX_UP) break;
+                }
+
+                // an epoch without mistakes left the mixed weights unchanged and they separate the samples, they
+                // are kept instead of the average, which may still carry the errors of the early rounds
+                if (errors > 0 && rounds > 0) {
+                    for (j = 0; j < dim; ++j) w[j] = avg_w[j] / rounds;
+                    bias = avg_bias / rounds;
+                }
+                return (errors == 0);
+            }
+
+        public:
+            /**
+             * \brief Set the training mode, SEQUENTIAL_UPDATES is the default.
+             * \param _mode Training mode.
+             */
+            void setMode(PerceptronMode _mode) { this->mode = _mode; }
+
+            /**
+             * \brief Set the number of threads, and shards of the data, of the PARAMETER_MIXING mode.
+             * \param threads Number of threads, 0 uses all the available threads (the default).
+             */
+            void setThreads(size_t threads) { this->n_threads = threads; }
+
+            /**
+             * \brief Set how many samples of its shard each thread visits between two averages of the weights.
+             * \param _batch_size Samples per round, 0 averages once per epoch (the default).
+             */
+            void setBatchSize(size_t _batch_size) { this->batch_size = _batch_size; }
+
+            PerceptronMode getMode() const { return mode; }
+
+            size_t getThreads() const { return n_threads; }
+
+            size_t getBatchSize() const { return batch_size; }
+        };
+
         /**
          * \brief Wrapper for the implementation of the Perceptron primal algorithm.
          */
         template<typename T>
-        class PerceptronPrimal : public PrimalClassifier<T> {
+        class PerceptronPrimal : public ParallelPerceptron<T> {
         public:
             explicit PerceptronPrimal(std::shared_ptr<Data<T> > samples = nullptr, double q = 2, double rate = 0.5,
                                       Solution *initial_solution = nullptr);
 
+            /**
+             * \brief Train the perceptron in the selected mode.
+             * \return bool true if the last epoch made no mistakes, the solution then classifies all the samples
+             * correctly in both modes. In the PARAMETER_MIXING mode a false result comes with the averaged solution.
+             */
             bool train() override;
 
             double evaluate(const Point<T> &p, bool raw_value = false) override;
@@ -33,6 +178,16 @@ namespace mltk{
          */
         template<typename T>
         class PerceptronFixedMarginPrimal : public PrimalClassifier<T> {
+        private:
+            /**
+             * \brief Training loop with the weight update specialized for the q norm.
+             */
+            template<int Q>
+            bool train_with(FixedMarginUpdate<Q> &update);
+
+        protected:
+            double labelThreshold() const override { return this->solution.margin * this->solution.norm; }
+
         public:
             explicit PerceptronFixedMarginPrimal(std::shared_ptr<Data<T> > samples = nullptr, double gamma = 1.0,
                                                  double q = 2, double rate = 0.5, Solution *initial_solution = nullptr);
@@ -75,7 +230,7 @@ namespace mltk{
         };
 
         template<typename T>
-        class BalancedPerceptron : public classifier::PrimalClassifier<T> {
+        class BalancedPerceptron : public ParallelPerceptron<T> {
         private:
             Point<double> weights;
             double bias = 0;
@@ -99,7 +254,15 @@ namespace mltk{
                 this->samples->shuffle(this->seed);
                 this->timer.Reset();
 
-                while (epoch < this->MAX_EPOCH) {
+                if (this->mode == PARAMETER_MIXING) {
+                    std::vector<double> w = weights.X();
+
+                    this->steps = this->ctot = 0;
+                    this->trainParameterMixing(w, this->bias);
+                    weights.X() = w;
+                }
+
+                while (this->mode == SEQUENTIAL_UPDATES && epoch < this->MAX_EPOCH) {
                     errors = 0;
                     for (auto it = this->samples->begin(); it != this->samples->end(); ++it) {
                         auto point = *it;
@@ -144,6 +307,10 @@ namespace mltk{
                 }
             }
 
+            std::vector<double> batchEvaluate(Data<T> &data, bool raw_value = false) override {
+                return Learner<T>::batchEvaluate(data, raw_value);
+            }
+
             std::string getFormulationString() override { return "Primal"; }
         };
     }
@@ -7,6 +7,7 @@
 #define PRIMALCLASSIFIER__HPP
 
 #include "Classifier.hpp"
+#include <algorithm>
 
 namespace mltk{
         namespace classifier {
@@ -24,6 +25,59 @@ namespace mltk{
                 double flexible = 0.0;
                 /// Percentage of aproximation of the result.
                 double alpha_aprox = 0.0;
+
+                /**
+                 * \brief Raw value from which a point is classified as the positive class.
+                 * \return double
+                 */
+                virtual double labelThreshold() const { return 0.0; }
+
+                /**
+                 * \brief Compute w*x + bias for n rows, four rows at a time so each weight is loaded once per block.
+                 * \param rows Pointers to the features of each row, with the dimension of the weights vector.
+                 * \param n Number of rows.
+                 * \param margins Raw values of the rows.
+                 * \param labels Predicted classes of the rows.
+                 */
+                template<typename U>
+                void scoreRows(const U *const *rows, size_t n, double *margins, double *labels) const {
+                    const double *w = this->solution.w.data(), bias = this->solution.bias;
+                    const double threshold = labelThreshold();
+                    const long dim = this->solution.w.size(), n_blocks = (n + 3) / 4;
+
+                    #pragma omp parallel for schedule(static) if(n * dim >= 65536)
+                    for (long b = 0; b < n_blocks; ++b) {
+                        size_t j = b * 4, m = std::min<size_t>(4, n - j);
+
+                        if (m == 4) {
+                            const U *x0 = rows[j], *x1 = rows[j + 1], *x2 = rows[j + 2], *x3 = rows[j + 3];
+                            double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+
+                            #pragma omp simd reduction(+:s0, s1, s2, s3)
+                            for (long k = 0; k < dim; ++k) {
+                                s0 += w[k] * x0[k];
+                                s1 += w[k] * x1[k];
+                                s2 += w[k] * x2[k];
+                                s3 += w[k] * x3[k];
+                            }
+                            margins[j] = s0 + bias;
+                            margins[j + 1] = s1 + bias;
+                            margins[j + 2] = s2 + bias;
+                            margins[j + 3] = s3 + bias;
+                        } else {
+                            for (size_t r = j; r < j + m; ++r) {
+                                const U *x = rows[r];
+                                double sum = 0;
+
+                                #pragma omp simd reduction(+:sum)
+                                for (long k = 0; k < dim; ++k) sum += w[k] * x[k];
+                                margins[r] = sum + bias;
+                            }
+                        }
+                        for (size_t r = j; r < j + m; ++r) labels[r] = (margins[r] >= threshold) ? 1 : -1;
+                    }
+                }
+
             public:
 
                 PrimalClassifier<T>() {}
@@ -55,6 +109,56 @@ namespace mltk{
                     return (func >= 0) ? 1 : -1;
                 }
 
+                /**
+                 * \brief Compute the raw values and the predicted classes of all the points of a dataset at once.
+                 * \param data Points to be evaluated.
+                 * \param margins Raw values w*x + bias of the points.
+                 * \param labels Predicted classes of the points.
+                 */
+                void batchScore(Data<T> &data, std::vector<double> &margins, std::vector<double> &labels) const {
+                    size_t i, n = data.getSize();
+                    std::vector<const T *> rows(n);
+
+                    margins.assign(n, 0.0);
+                    labels.assign(n, 0.0);
+                    if (n > 0 && data.getDim() != this->solution.w.size()) {
+                        std::cerr << "The points must have the same dimension of the feature set! (" << data.getDim()
+                                  << ", " << this->solution.w.size() << ")" << std::endl;
+                        return;
+                    }
+                    for (i = 0; i < n; i++) rows[i] = data[i]->X().data();
+                    scoreRows(rows.data(), n, margins.data(), labels.data());
+                }
+
+                /**
+                 * \brief Compute the raw values and the predicted classes of the rows of a matrix at once.
+                 * \param X Matrix with one point per row.
+                 * \param margins Raw values w*x + bias of the rows.
+                 * \param labels Predicted classes of the rows.
+                 */
+                void batchScore(const dMatrix &X, std::vector<double> &margins, std::vector<double> &labels) const {
+                    size_t i, n = X.size();
+                    std::vector<const double *> rows(n);
+
+                    margins.assign(n, 0.0);
+                    labels.assign(n, 0.0);
+                    for (i = 0; i < n; i++) {
+                        if (X[i].size() != this->solution.w.size()) {
+                            std::cerr << "The rows must have the same dimension of the feature set!" << std::endl;
+                            return;
+                        }
+                        rows[i] = X[i].data();
+                    }
+                    scoreRows(rows.data(), n, margins.data(), labels.data());
+                }
+
+                std::vector<double> batchEvaluate(Data<T> &data, bool raw_value = false) override {
+                    std::vector<double> margins, labels;
+
+                    batchScore(data, margins, labels);
+                    return raw_value ? margins : labels;
+                }
+
                 /*********************************************
                  *               Getters                     *
                  *********************************************/
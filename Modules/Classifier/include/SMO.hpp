@@ -11,46 +11,110 @@
 #pragma once
 
 #include "DualClassifier.hpp"
-#include <list>
+#include <functional>
+#include <random>
+#include <vector>
 
 namespace mltk{
         namespace classifier {
-            /*double linked list of integers*/
-            struct int_dll {
+            /*double linked list of integers, SMO keeps its support vectors in a dense index set instead*/
+            struct [[deprecated("SMO no longer uses a linked list of support vectors")]] int_dll {
                 int index = -1;
                 int_dll *prev = nullptr;
                 int_dll *next = nullptr;
 
-                int_dll();
+                int_dll() = default;
 
-                static int_dll *remove(int_dll **node);
+                /*removes an element from the list, returns the previous one*/
+                static int_dll *remove(int_dll **node) {
+                    int_dll *ret = nullptr;
 
-                static int_dll *append(int_dll *list);
+                    if ((*node) == nullptr) return nullptr;
+                    ret = (*node)->prev;
+                    if ((*node)->prev != nullptr) (*node)->prev->next = (*node)->next;
+                    if ((*node)->next != nullptr) (*node)->next->prev = (*node)->prev;
+                    delete *node;
+                    (*node) = nullptr;
 
-                static void free(int_dll **head);
-            };
+                    return ret;
+                }
+
+                /*appends a new node after list*/
+                static int_dll *append(int_dll *list) {
+                    int_dll *tmp = nullptr;
 
-            typedef struct int_dll int_dll;
+                    if (list == nullptr) {
+                        std::cerr << "Error in int linked list\n";
+                        return nullptr;
+                    }
+                    tmp = list->next;
+                    list->next = new int_dll;
+                    list->next->prev = list;
+                    list->next->next = tmp;
+                    if (tmp != nullptr) tmp->prev = list->next;
+
+                    return list->next;
+                }
+
+                /*clears the list*/
+                static void free(int_dll **head) {
+                    int_dll *list = *head, *tmpl = nullptr;
+
+                    while (list != nullptr) {
+                        tmpl = list;
+                        list = list->next;
+                        delete tmpl;
+                    }
+                    *head = nullptr;
+                }
+            };
 
             template<typename T>
             class SMO : public DualClassifier<T> {
-            private:
-                struct smo_learning_data {
-                    double error;
-                    bool done;
-                    int_dll *sv = nullptr;
-
-                    smo_learning_data() {
-                        error = 0.0;
-                        done = false;
-                        sv = nullptr;
-                    }
+            public:
+                /// Strategies to select the pair of multipliers optimized at each step.
+                enum WorkingSetSelection {
+                    /// Platt's heuristics: maximum |E1 - E2| over the non-bound examples, then full sweeps.
+                    FIRST_ORDER,
+                    /// Maximal violating example plus the partner with the largest second order gain (WSS2).
+                    SECOND_ORDER
                 };
 
-                const int C = 9999; //0.05
+            private:
+                double C = 9999; //0.05
                 const double TOL = 0.0001;
-                std::vector<smo_learning_data> l_data;
-                int_dll *head = nullptr;
+                /*learning data, one array per field*/
+                /// Cached errors of the non-bound examples.
+                std::vector<double> errors;
+                /// Examples already tried as pair of the current example.
+                std::vector<char> done;
+                /// Indexes of the examples with non-zero alpha, stored contiguously.
+                std::vector<int> sv_index;
+                /// Position of each example in sv_index, -1 when its alpha is zero.
+                std::vector<int> sv_pos;
+                /// Alphas and bias used as starting point of the next training.
+                std::vector<double> initial_alpha;
+                double initial_bias = 0;
+                /// Rows of the kernel matrix, in memory or mapped from the kernel cache.
+                std::vector<const double*> kernel_rows;
+                /// Generator of the starting points of the full sweeps, seeded with the learner seed at each training.
+                std::mt19937 generator;
+
+                /*second order solver state*/
+                const double WSS_TOL = 0.001;
+                const double TAU = 1e-12;
+                /// Minimum number of examples for the per-step sweeps to run in parallel.
+                const size_t PARALLEL_MIN = 4096;
+                WorkingSetSelection selection = FIRST_ORDER;
+                bool shrinking = true;
+                bool unshrink = false;
+                /// Gradient of the dual objective and its part due to the multipliers at the upper bound.
+                std::vector<double> G, G_bar;
+                /// Labels of the examples as +1 or -1.
+                std::vector<int> labels;
+                /// Indexes of the examples, the first active_size are the ones not shrunk.
+                std::vector<int> active;
+                size_t active_size = 0;
 
                 bool examine_example(int i1);
 
@@ -70,6 +134,24 @@ namespace mltk{
 
                 int train_matrix(Kernel *matrix);
 
+                bool training_routine_wss2();
+
+                bool select_working_set(int &i, int &j);
+
+                bool be_shrunk(int i, double gmax1, double gmax2);
+
+                void do_shrinking();
+
+                void reconstruct_gradient();
+
+                double compute_rho();
+
+                void sv_insert(int i);
+
+                void sv_remove(int i);
+
+                void start_alphas();
+
             public:
                 explicit SMO(std::shared_ptr<Data < T>
 
@@ -82,6 +164,82 @@ namespace mltk{
 
                 bool train() override;
 
+                /**
+                 * \brief Set the working set selection strategy, FIRST_ORDER is the default.
+                 * \param _selection Working set selection strategy.
+                 */
+                void setWorkingSetSelection(WorkingSetSelection _selection) { this->selection = _selection; }
+
+                /**
+                 * \brief Enable or disable the shrinking of the active set, used only by the SECOND_ORDER selection.
+                 * \param _shrinking Shrinking flag.
+                 */
+                void setShrinking(bool _shrinking) { this->shrinking = _shrinking; }
+
+                /**
+                 * \brief Set the upper bound of the alphas (soft margin penalty).
+                 * \param _C Upper bound of the alphas.
+                 */
+                void setC(double _C) { this->C = _C; }
+
+                double getC() const { return C; }
+
+                /**
+                 * \brief Start the next trainings from the alphas and bias of a previous solution on the same data,
+                 * instead of zero. Meant for paths over C or the kernel parameter: the alphas are clipped to the new
+                 * box and the error cache (or gradient) is rebuilt with the current kernel.
+                 * \param initial Solution returned by a previous training of this data.
+                 */
+                void setInitialSolution(const Solution &initial);
+
+                /**
+                 * \brief Go back to training from zero alphas.
+                 */
+                void clearInitialSolution();
+
+                /**
+                 * \brief Saves the warm start state of a SMO (initial solution and whether it's used) and restores it
+                 * when it goes out of scope, even if an exception is thrown.
+                 */
+                class WarmStartGuard {
+                private:
+                    SMO<T> &smo;
+                    std::vector<double> initial_alpha;
+                    double initial_bias;
+                    bool has_initial;
+
+                public:
+                    explicit WarmStartGuard(SMO<T> &smo): smo(smo), initial_alpha(smo.initial_alpha),
+                                                          initial_bias(smo.initial_bias),
+                                                          has_initial(smo.hasInitialSolution) {}
+
+                    WarmStartGuard(const WarmStartGuard&) = delete;
+                    WarmStartGuard& operator=(const WarmStartGuard&) = delete;
+
+                    ~WarmStartGuard() {
+                        smo.initial_alpha = std::move(initial_alpha);
+                        smo.initial_bias = initial_bias;
+                        smo.hasInitialSolution = has_initial;
+                    }
+                };
+
+                /**
+                 * \brief Train for each value of C in the given order, each one warm-started from the previous.
+                 * Increasing values of C keep the previous alphas feasible, so later trainings are much shorter.
+                 * The first training starts from the initial solution, if one was set, and the warm start state is
+                 * the same after the path as before it. C and the trained model are the ones of the last value.
+                 * \param Cs Values of C.
+                 * \param trained Called after each training with the index of the value of C, while the classifier
+                 * holds that solution, e.g. to evaluate it.
+                 * \return std::vector<Solution> with the solution for each value of C.
+                 */
+                std::vector<Solution> regularizationPath(const std::vector<double> &Cs,
+                                                         const std::function<void(size_t)> &trained = nullptr);
+
+                WorkingSetSelection getWorkingSetSelection() const { return selection; }
+
+                bool getShrinking() const { return shrinking; }
+
                 ~SMO();
             };
         }
@@ -0,0 +1,451 @@
+/*! Support vector model class.
+   \file SupportVectorModel.hpp
+*/
+
+#ifndef SUPPORTVECTORMODEL__HPP
+#define SUPPORTVECTORMODEL__HPP
+
+#include "../../Core/include/Kernel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace mltk{
+    namespace classifier {
+        /**
+         * \brief Compact predictor extracted from a trained dual classifier.
+         *
+         * Only the support vectors are kept, with their features packed contiguously, together with the alpha*y
+         * coefficients, the bias and the kernel type and parameter. The model doesn't reference the training data
+         * nor any kernel matrix, so it's cheap to copy, and it can be saved and loaded by serving processes.
+         */
+        template<typename T>
+        class SupportVectorModel {
+        private:
+            /// Dimension of the support vectors.
+            size_t dim = 0;
+            /// Features of the support vectors, packed row by row.
+            std::vector<double> svs;
+            /// alpha*y of each support vector.
+            std::vector<double> coefs;
+            /// Bias of the solution.
+            double bias = 0;
+            /// Kernel type and parameter.
+            int kernel_type = KernelType::INNER_PRODUCT;
+            double kernel_param = 0;
+
+            /**
+             * \brief Evaluation with a user-defined kernel policy, each operation runs its whole loop instantiated
+             * with the policy.
+             */
+            struct PolicyOps {
+                virtual ~PolicyOps() = default;
+
+                virtual double decision(const SupportVectorModel<T> &model, const double *x) const = 0;
+
+                virtual void batchDecision(const SupportVectorModel<T> &model, Data<T> &data,
+                                           std::vector<double> &values) const = 0;
+            };
+
+            template<typename Policy>
+            struct PolicyModel : public PolicyOps {
+                Policy policy;
+
+                explicit PolicyModel(const Policy &policy): policy(policy) {}
+
+                double decision(const SupportVectorModel<T> &model, const double *x) const override {
+                    return model.decision(policy, x);
+                }
+
+                void batchDecision(const SupportVectorModel<T> &model, Data<T> &data,
+                                   std::vector<double> &values) const override {
+                    model.batchDecision(policy, data, values);
+                }
+            };
+
+            /**
+             * \brief Wraps a kernel function as a kernel policy.
+             */
+            struct FunctionPolicy {
+                std::function<double(const double *, const double *, size_t)> f;
+
+                inline double function(const double *a, const double *b, size_t _dim) const { return f(a, b, _dim); }
+            };
+
+            /// User-defined kernel policy, if any.
+            std::shared_ptr<const PolicyOps> policy;
+
+            static const double *features(const std::vector<double> &x, std::vector<double> &) { return x.data(); }
+
+            template<typename U>
+            static const double *features(const std::vector<U> &x, std::vector<double> &buffer) {
+                buffer.assign(x.begin(), x.end());
+                return buffer.data();
+            }
+
+            /**
+             * \brief Decision value of a packed point, with the kernel policy called directly in the sum.
+             */
+            template<typename Policy>
+            double decision(const Policy &kernel_policy, const double *x) const {
+                double func = bias;
+
+                for (size_t i = 0; i < coefs.size(); ++i)
+                    func += coefs[i] * kernel_policy.function(x, svs.data() + i * dim, dim);
+                return func;
+            }
+
+            /**
+             * \brief Add the kernel part of the decision values of a dataset to values, with a user-defined kernel
+             * policy called for each pair of point and support vector. The pairs are visited by blocks of points and
+             * blocks of support vectors over packed features, in parallel over the blocks of points.
+             */
+            template<typename Policy>
+            void batchDecision(const Policy &kernel_policy, Data<T> &data, std::vector<double> &values) const {
+                const size_t points_block = 64, svs_block = 256;
+                size_t n = data.getSize(), n_svs = coefs.size();
+                size_t n_blocks = (n + points_block - 1) / points_block;
+
+                #pragma omp parallel for schedule(dynamic)
+                for (size_t b = 0; b < n_blocks; ++b) {
+                    size_t begin = b * points_block, end = std::min(n, begin + points_block), j, k;
+                    std::vector<double> block((end - begin) * dim);
+
+                    for (j = begin; j < end; ++j)
+                        std::copy(data[j]->X().begin(), data[j]->X().end(), block.begin() + (j - begin) * dim);
+
+                    for (size_t s0 = 0; s0 < n_svs; s0 += svs_block) {
+                        size_t s1 = std::min(n_svs, s0 + svs_block);
+
+                        for (j = begin; j < end; ++j) {
+                            const double *x = block.data() + (j - begin) * dim;
+                            double func = 0.0;
+
+                            for (k = s0; k < s1; ++k)
+                                func += coefs[k] * kernel_policy.function(x, svs.data() + k * dim, dim);
+                            values[j] += func;
+                        }
+                    }
+                }
+            }
+
+            void batchDecision(const kernels::Linear &, Data<T> &data, std::vector<double> &values) const {
+                blockedDecision(data, values, false, [](double dot, double, double) { return dot; });
+            }
+
+            void batchDecision(const kernels::Polynomial &kernel_policy, Data<T> &data,
+                               std::vector<double> &values) const {
+                const double param = kernel_policy.param;
+
+                blockedDecision(data, values, false, [param](double dot, double, double) {
+                    return (param > 1) ? std::pow(dot, param) : dot;
+                });
+            }
+
+            void batchDecision(const kernels::Gaussian &kernel_policy, Data<T> &data,
+                               std::vector<double> &values) const {
+                const double param = kernel_policy.param;
+
+                // ||x - s||^2 = ||x||^2 + ||s||^2 - 2x.s, clamped against the rounding of close points
+                blockedDecision(data, values, true, [param](double dot, double x_norm, double s_norm) {
+                    return std::exp(-1 * std::max(0.0, x_norm + s_norm - 2 * dot) * param);
+                });
+            }
+
+            /**
+             * \brief Add the kernel part of the decision values of a dataset to values, for the kernels that are a
+             * function of the inner products. The inner products of a block of points and a block of support vectors
+             * are computed as a blocked matrix product, four points at a time against each support vector, and
+             * mapped to the kernel values. The blocks of points run in parallel.
+             * \param norms Compute the squared norms of the points and of the support vectors passed to kernel_map.
+             * \param kernel_map Kernel value from the inner product and the squared norms of the point and the
+             * support vector.
+             */
+            template<typename KernelMap>
+            void blockedDecision(Data<T> &data, std::vector<double> &values, bool norms, KernelMap kernel_map) const {
+                const size_t points_block = 64, svs_block = 256;
+                const long _dim = dim;
+                size_t n = data.getSize(), n_svs = coefs.size();
+                size_t n_blocks = (n + points_block - 1) / points_block;
+                std::vector<double> sv_norms(n_svs, 0.0);
+
+                if (norms)
+                    for (size_t k = 0; k < n_svs; ++k) {
+                        const double *sv = svs.data() + k * dim;
+                        double sum = 0;
+
+                        #pragma omp simd reduction(+:sum)
+                        for (long d = 0; d < _dim; ++d) sum += sv[d] * sv[d];
+                        sv_norms[k] = sum;
+                    }
+
+                #pragma omp parallel for schedule(dynamic)
+                for (size_t b = 0; b < n_blocks; ++b) {
+                    size_t begin = b * points_block, end = std::min(n, begin + points_block), m = end - begin, j, k;
+                    std::vector<double> block(m * dim), x_norms(m, 0.0), func(m, 0.0);
+
+                    for (j = 0; j < m; ++j) {
+                        const double *x = block.data() + j * dim;
+                        double sum = 0;
+
+                        std::copy(data[begin + j]->X().begin(), data[begin + j]->X().end(), block.begin() + j * dim);
+                        if (!norms) continue;
+                        #pragma omp simd reduction(+:sum)
+                        for (long d = 0; d < _dim; ++d) sum += x[d] * x[d];
+                        x_norms[j] = sum;
+                    }
+
+                    for (size_t s0 = 0; s0 < n_svs; s0 += svs_block) {
+                        size_t s1 = std::min(n_svs, s0 + svs_block);
+
+                        for (j = 0; j + 4 <= m; j += 4) {
+                            const double *x0 = block.data() + j * dim, *x1 = x0 + dim, *x2 = x1 + dim, *x3 = x2 + dim;
+
+                            for (k = s0; k < s1; ++k) {
+                                const double *sv = svs.data() + k * dim;
+                                double d0 = 0, d1 = 0, d2 = 0, d3 = 0;
+
+                                #pragma omp simd reduction(+:d0, d1, d2, d3)
+                                for (long d = 0; d < _dim; ++d) {
+                                    d0 += x0[d] * sv[d];
+                                    d1 += x1[d] * sv[d];
+                                    d2 += x2[d] * sv[d];
+                                    d3 += x3[d] * sv[d];
+                                }
+                                func[j] += coefs[k] * kernel_map(d0, x_norms[j], sv_norms[k]);
+                                func[j + 1] += coefs[k] * kernel_map(d1, x_norms[j + 1], sv_norms[k]);
+                                func[j + 2] += coefs[k] * kernel_map(d2, x_norms[j + 2], sv_norms[k]);
+                                func[j + 3] += coefs[k] * kernel_map(d3, x_norms[j + 3], sv_norms[k]);
+                            }
+                        }
+                        for (; j < m; ++j) {
+                            const double *x = block.data() + j * dim;
+
+                            for (k = s0; k < s1; ++k) {
+                                const double *sv = svs.data() + k * dim;
+                                double dot = 0;
+
+                                #pragma omp simd reduction(+:dot)
+                                for (long d = 0; d < _dim; ++d) dot += x[d] * sv[d];
+                                func[j] += coefs[k] * kernel_map(dot, x_norms[j], sv_norms[k]);
+                            }
+                        }
+                    }
+                    for (j = 0; j < m; ++j) values[begin + j] += func[j];
+                }
+            }
+
+        public:
+            SupportVectorModel() = default;
+
+            /**
+             * \brief Build the model from the points with non-zero alpha of a trained dual classifier.
+             * \param samples Samples used in the training, with the alphas of the solution.
+             * \param bias Bias of the solution.
+             * \param kernel_type Kernel type used in the training.
+             * \param kernel_param Kernel parameter used in the training.
+             */
+            SupportVectorModel(const Data<T> &samples, double bias, int kernel_type, double kernel_param)
+                    : dim(samples.getDim()), bias(bias), kernel_type(kernel_type), kernel_param(kernel_param) {
+                for (size_t i = 0; i < samples.getSize(); ++i) {
+                    auto const &sample = samples[i];
+                    if (sample->Alpha() == 0) continue;
+                    coefs.push_back(sample->Alpha() * sample->Y());
+                    svs.insert(svs.end(), sample->X().begin(), sample->X().end());
+                }
+            }
+
+            /**
+             * \brief Set the kernel function of a user-defined kernel policy.
+             * \param f Kernel function between two packed points with the given dimension.
+             */
+            void setKernelFunction(std::function<double(const double *, const double *, size_t)> f) {
+                setKernelPolicy(FunctionPolicy{std::move(f)});
+            }
+
+            /**
+             * \brief Set a user-defined kernel policy, used instead of the kernel type.
+             * \param kernel_policy Kernel policy, evaluated over packed double features.
+             */
+            template<typename Policy>
+            void setKernelPolicy(const Policy &kernel_policy) {
+                policy = std::make_shared<PolicyModel<Policy> >(kernel_policy);
+            }
+
+            /**
+             * \brief Compute the decision value of a point.
+             * \param p Point to be evaluated.
+             * \param raw_value Return the decision value instead of the predicted class.
+             * \return double
+             */
+            double evaluate(const Point<T> &p, bool raw_value = false) const {
+                std::vector<double> buffer;
+                double func = 0.0;
+
+                if (p.size() != dim) {
+                    std::cerr << "The point must have the same dimension of the feature set!" << std::endl;
+                    return 0;
+                }
+
+                const double *x = features(p.X(), buffer);
+                if (policy) func = policy->decision(*this, x);
+                else Kernel::dispatch(kernel_type, kernel_param, [&](auto const &kernel_policy) {
+                    func = decision(kernel_policy, x);
+                });
+
+                if (raw_value) return func;
+                return (func >= 0) ? 1 : -1;
+            }
+
+            /**
+             * \brief Compute the decision values of all the points of a dataset at once.
+             * For the inner product, polynomial and gaussian kernels the inner products between blocks of points and
+             * blocks of support vectors are computed as a blocked matrix product, in parallel over the blocks of points.
+             * \param data Points to be evaluated.
+             * \param raw_value Return the decision values instead of the predicted classes.
+             * \return std::vector<double>
+             */
+            std::vector<double> batchEvaluate(Data<T> &data, bool raw_value = false) const {
+                size_t n = data.getSize();
+                std::vector<double> values(n, bias);
+
+                if (n > 0 && data.getDim() != dim) {
+                    std::cerr << "The points must have the same dimension of the feature set!" << std::endl;
+                    return std::vector<double>(n, 0.0);
+                }
+
+                if (policy) policy->batchDecision(*this, data, values);
+                else Kernel::dispatch(kernel_type, kernel_param, [&](auto const &kernel_policy) {
+                    batchDecision(kernel_policy, data, values);
+                });
+
+                if (!raw_value)
+                    for (auto &value: values) value = (value >= 0) ? 1 : -1;
+
+                return values;
+            }
+
+            /**
+             * \brief Save the model in a binary file.
+             * \param path Path to the file.
+             * \return bool
+             */
+            bool save(const std::string &path) const {
+                uint64_t header[3] = {dim, coefs.size(), uint64_t(int64_t(kernel_type))};
+                std::ofstream output(path, std::ios::binary | std::ios::trunc);
+
+                if (policy) {
+                    std::cerr << "Models with a user-defined kernel can't be saved." << std::endl;
+                    return false;
+                }
+                if (!output) {
+                    std::cerr << "Could not open " << path << " for writing." << std::endl;
+                    return false;
+                }
+                output.write("MLTKSVM1", 8);
+                output.write(reinterpret_cast<const char *>(header), sizeof(header));
+                output.write(reinterpret_cast<const char *>(&kernel_param), sizeof(double));
+                output.write(reinterpret_cast<const char *>(&bias), sizeof(double));
+                output.write(reinterpret_cast<const char *>(coefs.data()), coefs.size() * sizeof(double));
+                output.write(reinterpret_cast<const char *>(svs.data()), svs.size() * sizeof(double));
+
+                return bool(output);
+            }
+
+            /**
+             * \brief Load a model saved in a binary file.
+             * \param path Path to the file.
+             * \return bool
+             */
+            bool load(const std::string &path) {
+                const uint64_t header_bytes = 8 + 3 * sizeof(uint64_t) + 2 * sizeof(double);
+                uint64_t header[3], file_size;
+                char magic[8];
+                std::ifstream input(path, std::ios::binary | std::ios::ate);
+                std::vector<double> _coefs, _svs;
+                double _kernel_param, _bias;
+
+                if (!input) {
+                    std::cerr << "Could not open " << path << " for reading." << std::endl;
+                    return false;
+                }
+                file_size = uint64_t(input.tellg());
+                input.seekg(0);
+                if (!input.read(magic, 8) || std::memcmp(magic, "MLTKSVM1", 8) != 0 ||
+                    !input.read(reinterpret_cast<char *>(header), sizeof(header))) {
+                    std::cerr << path << " is not a support vector model file." << std::endl;
+                    return false;
+                }
+                // the sizes must match the file before anything is allocated, each support vector takes dim + 1 values
+                uint64_t _dim = header[0], n_svs = header[1];
+                uint64_t values = (file_size >= header_bytes) ? (file_size - header_bytes) / sizeof(double) : 0;
+                int64_t _kernel_type = int64_t(header[2]);
+                bool valid = file_size >= header_bytes && (file_size - header_bytes) % sizeof(double) == 0 &&
+                             _kernel_type >= KernelType::INNER_PRODUCT && _kernel_type <= KernelType::GAUSSIAN;
+                if (n_svs == 0) valid = valid && values == 0;
+                else valid = valid && values % n_svs == 0 && values / n_svs > 0 && values / n_svs - 1 == _dim;
+                if (!valid) {
+                    std::cerr << path << " is corrupted, its header doesn't match its contents." << std::endl;
+                    return false;
+                }
+                _coefs.resize(n_svs);
+                _svs.resize(n_svs * _dim);
+                input.read(reinterpret_cast<char *>(&_kernel_param), sizeof(double));
+                input.read(reinterpret_cast<char *>(&_bias), sizeof(double));
+                input.read(reinterpret_cast<char *>(_coefs.data()), _coefs.size() * sizeof(double));
+                input.read(reinterpret_cast<char *>(_svs.data()), _svs.size() * sizeof(double));
+                if (!input) {
+                    std::cerr << "Could not read the model in " << path << "." << std::endl;
+                    return false;
+                }
+
+                dim = _dim;
+                kernel_type = int(_kernel_type);
+                kernel_param = _kernel_param;
+                bias = _bias;
+                coefs = std::move(_coefs);
+                svs = std::move(_svs);
+                policy = nullptr;
+                return true;
+            }
+
+            /*********************************************
+             *               Getters                     *
+             *********************************************/
+
+            /**
+             * \brief Returns the number of support vectors in the model.
+             * \return size_t
+             */
+            size_t getSupportVectorsNumber() const { return coefs.size(); }
+
+            size_t getDim() const { return dim; }
+
+            double getBias() const { return bias; }
+
+            int getKernelType() const { return kernel_type; }
+
+            double getKernelParam() const { return kernel_param; }
+
+            /**
+             * \brief Returns the alpha*y coefficients of the support vectors.
+             * \return std::vector<double>
+             */
+            const std::vector<double> &getCoefficients() const { return coefs; }
+
+            /**
+             * \brief Returns the support vector with the given index.
+             * \return Point<double>
+             */
+            Point<double> getSupportVector(size_t i) const {
+                return Point<double>(std::vector<double>(svs.begin() + i * dim, svs.begin() + (i + 1) * dim));
+            }
+        };
+    }
+}
+#endif
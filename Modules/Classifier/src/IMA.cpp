@@ -296,99 +296,70 @@ namespace mltk{
 
         template<typename T>
         bool IMApFixedMargin<T>::train() {
-            int c, e = 1, i, k, s = 0, j;
-            int t, idx, r;
+            if (this->q == 1.0) {
+                FixedMarginUpdate<1> update(this->gamma, this->rate, this->q);
+                return train_with(update);
+            } else if (this->q == 2.0) {
+                FixedMarginUpdate<2> update(this->gamma, this->rate, this->q);
+                return train_with(update);
+            } else if (this->q == -1.0) {
+                FixedMarginUpdate<-1> update(this->gamma, this->rate, this->q, this->EPS);
+                bool ret;
+
+                update.largest = this->maiorw;
+                update.n = this->n;
+                update.max_n = this->maiorn;
+                ret = train_with(update);
+                this->maiorw = update.largest;
+                this->n = update.n;
+                this->maiorn = update.max_n;
+                return ret;
+            }
+            FixedMarginUpdate<0> update(this->gamma, this->rate, this->q);
+            return train_with(update);
+        }
+
+        template<typename T>
+        template<int Q>
+        bool IMApFixedMargin<T>::train_with(FixedMarginUpdate<Q> &update) {
+            int e = 1, i, k, s = 0, j;
+            int idx;
             size_t size = this->samples->getSize(), dim = this->samples->getDim();
-            double norm = this->solution.norm, bias = this->solution.bias, lambda = 1, y, time =
+            double norm = this->solution.norm, bias = this->solution.bias, lambda = 1, y, wx, time =
                     this->max_time + this->start_time;
-            register double sumnorm = 0; //soma das normas para o calculo posterior (nao mais sqrt)
-            double maiorw_temp = 0;
-            int n_temp, sign = 1;
-            bool cond;
+            // the alphas are all multiplied by lambda on each mistake, the product is kept apart and applied at the end
+            double alpha_scale = 1.0;
             vector<double> func(size, 0.0);
             vector<int> index = this->samples->getIndex();
-            vector<T> x;
 
             if (!this->solution.w.empty())
                 this->w = this->solution.w;
+            update.prepare(*this->samples);
 
             while (this->timer.Elapsed() - time <= 0) {
                 for (e = 0, i = 0; i < size; ++i) {
-                    //shuffling data r = i + rand()%(size-i); j = index[i]; idx = index[i] = index[r]; index[r] = j;
                     idx = index[i];
-                    //cout << idx << endl;
-                    x = (*this->samples)[idx]->X();
-                    y = (*this->samples)[idx]->Y();
-                    //if(i == 100) return 1;
+                    auto &point = (*this->samples)[idx];
+                    const vector<T> &x = point->X();
+                    y = point->Y();
+
                     //calculating function
-                    for (func[idx] = bias, j = 0; j < dim; ++j) {
-                        func[idx] += this->w[j] * x[j];
+                    for (wx = 0.0, j = 0; j < dim; ++j) {
+                        wx += this->w[j] * x[j];
                     }
-                    //cout << "funcidx: " << y*func[idx] << " marg: " << this->gamma*norm - points[idx]->Alpha()*this->flexible <<"\n ";
+                    func[idx] = bias + wx;
                     //Checking if the point is a mistake
-                    if (y * func[idx] <= this->gamma * norm - (*this->samples)[idx]->Alpha() * this->flexible) {
+                    if (y * func[idx] <= this->gamma * norm - point->Alpha() * alpha_scale * this->flexible) {
                         lambda = (norm) ? (1 - this->rate * this->gamma / norm) : 1;
-                        for (r = 0; r < size; ++r)
-                            (*this->samples)[r]->Alpha() *= lambda;
-
-                        if (this->q == 1.0) //Linf
-                        {
-                            for (sumnorm = 0, j = 0; j < dim; ++j) {
-                                sign = 1;
-                                if (this->w[j] < 0) sign = -1;
-                                lambda = (norm > 0 && this->w[j] != 0) ? this->gamma * sign : 0;
-                                this->w[j] += this->rate * (y * x[j] - lambda);
-                                sumnorm += fabs(this->w[j]);
-                            }
-                            norm = sumnorm;
-                        } else if (this->q == 2.0) //L2
-                        {
-                            for (sumnorm = 0, j = 0; j < dim; ++j) {
-                                lambda = (norm > 0 && this->w[j] != 0) ? this->w[j] * this->gamma / norm : 0;
-                                this->w[j] += this->rate * (y * x[j] - lambda);
-                                sumnorm += this->w[j] * this->w[j];
-                            }
-                            norm = sqrt(sumnorm);
-                        } else if (this->q == -1.0) //L1
-                        {
-                            maiorw_temp = fabs(this->w[0]);
-                            n_temp = 1;
-                            for (j = 0; j < dim; ++j) {
-                                if (this->maiorw == 0 ||
-                                    fabs(this->maiorw - fabs(this->w[j])) / this->maiorw < this->EPS) {
-                                    sign = 1;
-                                    if (this->w[j] < 0) sign = -1;
-                                    lambda = (norm > 0 && this->w[j] != 0) ? this->gamma * sign / this->n : 0;
-                                    this->w[j] += this->rate * (y * x[j] - lambda);
-                                } else
-                                    this->w[j] += this->rate * (y * x[j]);
-
-                                if (j > 0) {
-                                    if (fabs(maiorw_temp - fabs(this->w[j])) / maiorw_temp < this->EPS)
-                                        n_temp++;
-                                    else if (fabs(this->w[j]) > maiorw_temp) {
-                                        maiorw_temp = fabs(this->w[j]);
-                                        n_temp = 1;
-                                    }
-                                }
-                            }
-                            this->maiorw = maiorw_temp;
-                            this->n = n_temp;
-                            norm = this->maiorw;
-                            if (this->n > this->maiorn) this->maiorn = this->n;
-                        } else //outras formula��es - Lp
-                        {
-                            for (sumnorm = 0, j = 0; j < dim; ++j) {
-                                lambda = (norm > 0 && this->w[j] != 0) ? this->w[j] * this->gamma *
-                                                                         std::pow(fabs(this->w[j]), this->q - 2.0) *
-                                                                         std::pow(norm, 1.0 - this->q) : 0;
-                                this->w[j] += this->rate * (y * x[j] - lambda);
-                                sumnorm += std::pow(fabs(this->w[j]), this->q);
-                            }
-                            norm = std::pow(sumnorm, 1.0 / this->q);
+                        alpha_scale *= lambda;
+                        if (!(alpha_scale > 1e-100)) {
+                            for (auto &p: this->samples->getPoints()) p->Alpha() *= alpha_scale;
+                            alpha_scale = 1.0;
                         }
+
+                        norm = update(this->w, x, y, norm);
                         bias += this->rate * y;
-                        (*this->samples)[idx]->Alpha() += this->rate;
+                        point->Alpha() += this->rate / alpha_scale;
 
                         k = (i > s) ? s++ : e;
                         j = index[k];
@@ -399,13 +370,14 @@ namespace mltk{
                     } else if (this->steps > 0 && e > 1 && i > s) break;
                 }
                 this->steps++; //Number of iterations update
-                //cout << e << endl;
                 //stop criterion
                 if (e == 0) break;
                 if (this->steps > this->MAX_IT) break;
                 if (this->ctot > this->MAX_UP) break;
                 if (this->flagNao1aDim) if (this->ctot > tMax) break;
             }
+            if (alpha_scale != 1.0)
+                for (auto &p: this->samples->getPoints()) p->Alpha() *= alpha_scale;
 
             this->samples->setIndex(index);
             this->solution.norm = norm;
@@ -478,7 +450,7 @@ namespace mltk{
             this->solution.bias = 0;
 
             //Allocating space kernel matrix
-            this->kernel->compute(this->samples);
+            this->computeKernel();
 
             if (this->verbose) {
                 cout << "-------------------------------------------------------------------\n";
@@ -558,14 +530,14 @@ namespace mltk{
             int kernel_type = this->kernel->getType();
             double kernel_param = this->kernel->getParam();
 
-            if (kernel_type == 0)
+            if (kernel_type == 0 && !this->policy)
                 for (i = 0; i < dim; i++) {
                     for (j = 0; j < size; j++) {
                         w_saved[i] += points[j]->Alpha() * points[j]->Y() * points[j]->X()[i];
                     }
                 }
             else {
-                if (kernel_type == 1 && kernel_param == 1)
+                if (!this->policy && kernel_type == 1 && kernel_param == 1)
                     w_saved = DualClassifier<T>::getDualWeightProdInt();
                 else
                     w_saved = DualClassifier<T>::getDualWeight();
@@ -33,6 +33,13 @@ namespace mltk{
             this->solution.norm = 0.0;
 
             this->timer.Reset();
+            if (this->mode == PARAMETER_MIXING) {
+                bool converged = this->trainParameterMixing(this->solution.w, this->solution.bias);
+
+                for (j = 0; j < dim; ++j) this->solution.norm += this->solution.w[j] * this->solution.w[j];
+                this->solution.norm = sqrt(this->solution.norm);
+                return converged;
+            }
             while (this->timer.Elapsed() - time <= 0) {
                 for (e = 0, i = 0; i < size; ++i) {
                     idx = index[i];
@@ -85,94 +92,62 @@ namespace mltk{
 
         template<typename T>
         bool PerceptronFixedMarginPrimal<T>::train() {
-            size_t i, j, k, e, s, r, dim = this->samples->getDim();
-            size_t size = this->samples->getSize(), n = dim;
-            int idx, sign = 1, n_temp = 0, largn = 0;
-            double norm = this->solution.norm, lambda = 1.0, y, time = this->start_time + this->max_time;
-            double sumnorm = 0.0, bias = this->solution.bias, largw = 0.0, largw_temp = 0.0;
-            bool cond;
+            if (this->q == 1.0) {
+                FixedMarginUpdate<1> update(this->gamma, this->rate, this->q);
+                return train_with(update);
+            } else if (this->q == 2.0) {
+                FixedMarginUpdate<2> update(this->gamma, this->rate, this->q);
+                return train_with(update);
+            } else if (this->q == -1.0) {
+                FixedMarginUpdate<-1> update(this->gamma, this->rate, this->q, this->EPS);
+                return train_with(update);
+            }
+            FixedMarginUpdate<0> update(this->gamma, this->rate, this->q);
+            return train_with(update);
+        }
+
+        template<typename T>
+        template<int Q>
+        bool PerceptronFixedMarginPrimal<T>::train_with(FixedMarginUpdate<Q> &update) {
+            size_t i, j, k, e, s, dim = this->samples->getDim();
+            size_t size = this->samples->getSize();
+            int idx;
+            double norm = this->solution.norm, lambda = 1.0, y, wx, time = this->start_time + this->max_time;
+            double bias = this->solution.bias, alpha_scale = 1.0;
             vector<double> func = this->solution.func, w = this->solution.w;
-            vector<T> x;
             vector<int> index = this->samples->getIndex();
-            shared_ptr<Point<T> > p;
 
             if (func.empty()) func.resize(size);
             if (w.empty()) w.resize(dim);
+            update.prepare(*this->samples);
             e = s = 0;
 
             while (this->timer.Elapsed() - time <= 0) {
                 for (e = 0, i = 0; i < size; ++i) {
                     idx = index[i];
-                    p = this->samples->getPoint(idx);
-                    x = p->X();
+                    auto &p = (*this->samples)[idx];
+                    const vector<T> &x = p->X();
                     y = p->Y();
 
                     //calculating function
-                    for (func[idx] = bias, j = 0; j < dim; ++j) {
-                        func[idx] += w[j] * x[j];
+                    for (wx = 0.0, j = 0; j < dim; ++j) {
+                        wx += w[j] * x[j];
                     }
+                    func[idx] = bias + wx;
 
                     //Checking if the point is a mistake
-                    if (y * func[idx] <= this->gamma * norm - this->samples->getPoint(idx)->Alpha() * this->flexible) {
+                    if (y * func[idx] <= this->gamma * norm - p->Alpha() * alpha_scale * this->flexible) {
+                        // the decay of the alphas is accumulated in alpha_scale instead of visiting every point
                         lambda = (norm != 0.0) ? (1 - this->rate * this->gamma / norm) : 1;
-                        for (r = 0; r < size; ++r) {
-                            shared_ptr<Point<T> > b = this->samples->getPoint(r);
-                            b->Alpha() *= lambda;
-                            this->samples->setPoint(r, b);
+                        alpha_scale *= lambda;
+                        if (!(alpha_scale > 1e-100)) {
+                            for (auto &b: this->samples->getPoints()) b->Alpha() *= alpha_scale;
+                            alpha_scale = 1.0;
                         }
 
-                        if (this->q == 1.0) { //Linf
-                            for (sumnorm = 0.0, j = 0; j < dim; ++j) {
-                                sign = (w[j] < 0) ? -1 : 1;
-                                lambda = (norm > 0 && w[j] != 0) ? this->gamma * sign : 0;
-                                w[j] += this->rate * (y * x[j] - lambda);
-                                sumnorm += fabs(w[j]);
-                            }
-                            norm = sumnorm;
-                        } else if (this->q == 2.0) { //L2
-                            for (sumnorm = 0.0, j = 0; j < dim; ++j) {
-                                lambda = (norm > 0 && w[j] != 0) ? w[j] * this->gamma / norm : 0;
-                                w[j] += this->rate * (y * x[j] - lambda);
-                                sumnorm += w[j] * w[j];
-                            }
-                            norm = sqrt(sumnorm);
-                        } else if (this->q == -1.0) { //L1
-                            largw_temp = fabs(w[0]);
-                            n_temp = 1;
-                            for (j = 0; j < dim; ++j) {
-                                if (largw == 0 || fabs(largw - fabs(w[j])) / largw < this->EPS) {
-                                    sign = (w[j] < 0) ? -1 : 1;
-                                    lambda = (norm > 0 && w[j] != 0) ? this->gamma * sign / n : 0;
-                                    w[j] += this->rate * (y * x[j] - lambda);
-                                } else
-                                    w[j] += this->rate * (y * x[j]);
-
-                                if (j > 0) {
-                                    if (fabs(largw_temp - fabs(w[j])) / largw_temp < this->EPS)
-                                        n_temp++;
-                                    else if (fabs(w[j]) > largw_temp) {
-                                        largw_temp = fabs(w[j]);
-                                        n_temp = 1;
-                                    }
-                                }
-                            }
-                            largw = largw_temp;
-                            n = n_temp;
-                            norm = largw;
-                            if (n > largn) largn = n;
-                        } else { //Other Lp formulations
-                            for (sumnorm = 0, j = 0; j < dim; ++j) {
-                                lambda = (norm > 0 && w[j] != 0) ? w[j] * this->gamma *
-                                                                   std::pow(fabs(w[j]), this->q - 2.0) *
-                                                                   std::pow(norm, 1.0 - this->q) : 0;
-                                w[j] += this->rate * (y * x[j] - lambda);
-                                sumnorm += std::pow(fabs(w[j]), this->q);
-                            }
-                            norm = std::pow(sumnorm, 1.0 / this->q);
-                        }
+                        norm = update(w, x, y, norm);
                         bias += this->rate * y;
-                        p->Alpha() += this->rate;
-                        this->samples->setPoint(idx, p);
+                        p->Alpha() += this->rate / alpha_scale;
 
                         k = (i > s) ? s++ : e;
                         j = index[k];
@@ -189,6 +164,8 @@ namespace mltk{
                 if (this->steps > this->MAX_IT) break;
                 if (this->ctot > this->MAX_UP) break;
             }
+            if (alpha_scale != 1.0)
+                for (auto &b: this->samples->getPoints()) b->Alpha() *= alpha_scale;
 
             this->solution.norm = norm;
             this->solution.bias = bias;
@@ -249,8 +226,8 @@ namespace mltk{
             vector<int> index = this->samples->getIndex();
             vector<double> func(size, 0.0), Kv;
             vector<shared_ptr<Point<T> > > points = this->samples->getPoints();
-            this->kernel->compute(this->samples);
-            dMatrix *K = this->kernel->getKernelMatrixPointer();
+            this->computeKernel();
+            auto K = this->kernel->getKernelRows();
 
             if (this->alpha.empty()) {
                 this->alpha.assign(size, 0.0);
@@ -265,13 +242,13 @@ namespace mltk{
 
                     //Calculating function
                     for (f = bias, r = 0; r < size; ++r)
-                        f += this->alpha[r] * points[index[r]]->Y() * (*K)[idx][index[r]];
+                        f += this->alpha[r] * points[index[r]]->Y() * K[idx][index[r]];
                     func[idx] = f;
 
                     //Checking if the point is a mistake
                     if (y * f <= 0.0) {
                         norm = sqrt(
-                                norm * norm + tworate * points[idx]->Y() * func[idx] - bias + sqrate * (*K)[idx][idx]);
+                                norm * norm + tworate * points[idx]->Y() * func[idx] - bias + sqrate * K[idx][idx]);
                         this->alpha[i] += this->rate;
                         bias += this->rate * y;
                         ++this->ctot, ++e;
@@ -343,8 +320,8 @@ namespace mltk{
             const double tworate = 2 * this->rate;
             vector<int> index = this->samples->getIndex();
             vector<double> func = this->solution.func, Kv;
-            this->kernel->compute(this->samples);
-            dMatrix *K = this->kernel->getKernelMatrixPointer();
+            this->computeKernel();
+            auto K = this->kernel->getKernelRows();
 
             if (func.empty()) { func.resize(size); }
             e = 1, s = 0;
@@ -363,11 +340,11 @@ namespace mltk{
 
                         for (r = 0; r < size; ++r) {
                             (*this->samples)[r]->Alpha() *= lambda;
-                            func[r] = lambda * func[r] + this->rate * y * ((*K)[idx][r] + 1) + bias * (1 - lambda);
+                            func[r] = lambda * func[r] + this->rate * y * (K[idx][r] + 1) + bias * (1 - lambda);
                         }
 
                         norm = sqrt(norm * norm + tworate * (*this->samples)[idx]->Y() * lambda * (func[idx] - bias) +
-                                    sqrate * (*K)[idx][idx]);
+                                    sqrate * K[idx][idx]);
                         (*this->samples)[idx]->Alpha() += this->rate;
 
                         bias += this->rate * y;
@@ -13,6 +13,7 @@
 #include "SMO.hpp"
 #include <cmath>
 #include <algorithm>
+#include <climits>
 
 namespace mltk{
     namespace classifier {
@@ -24,15 +25,10 @@ namespace mltk{
             this->verbose = verbose;
             this->kernel = k;
             if (this->kernel == nullptr) this->kernel = new Kernel();
-            this->head = nullptr;
         }
 
         template<typename T>
         SMO<T>::~SMO() {
-            if (this->head != nullptr) {
-                int_dll::free(&this->head);
-                this->head = nullptr;
-            }
             //delete this->kernel;
         }
 
@@ -44,25 +40,21 @@ namespace mltk{
             double norm = 1;
             vector<double> w_saved;
 
-            this->head = new int_dll;
-            this->l_data.resize(size);
-
-            /*clear data*/
-            this->solution.bias = 0;
-            for (i = 0; i < size; i++)
-                (*this->samples)[i]->Alpha() = 0;
+            /*clear data or start from the initial solution*/
+            start_alphas();
+            this->generator.seed(this->seed);
 
             this->timer.Reset();
-            this->kernel->compute(this->samples);
+            this->computeKernel();
 
             /*run training algorithm*/
-            ret = training_routine();
+            ret = (this->selection == SECOND_ORDER) ? training_routine_wss2() : training_routine();
 
             norm = this->kernel->featureSpaceNorm(this->samples);
-            if (this->kernel->getType() == 0)
+            if (this->kernel->getType() == 0 && !this->policy)
                 w_saved = this->getWeight();
             else {
-                if (this->kernel->getType() == 1 && this->kernel->getParam() == 1)
+                if (!this->policy && this->kernel->getType() == 1 && this->kernel->getParam() == 1)
                     w_saved = this->getDualWeightProdInt();
                 else
                     w_saved = this->getDualWeight();
@@ -71,8 +63,10 @@ namespace mltk{
             this->solution.w = w_saved;
             this->solution.margin = 1.0 / norm;
             this->solution.svs = 0;
+            this->solution.alpha.resize(size);
 
             for (i = 0; i < size; ++i) {
+                this->solution.alpha[i] = (*this->samples)[i]->Alpha();
                 if ((*this->samples)[i]->Alpha() > 0) ++this->solution.svs;
                 if ((*this->samples)[i]->Alpha() > this->C) ret = false;
             }
@@ -89,8 +83,11 @@ namespace mltk{
                 }
             }
 
-            int_dll::free(&this->head);
-            this->l_data.clear();
+            this->kernel_rows.clear();
+            this->errors.clear();
+            this->done.clear();
+            this->sv_index.clear();
+            this->sv_pos.clear();
 
             return ret;
         }
@@ -98,21 +95,20 @@ namespace mltk{
 
         template<typename T>
         bool SMO<T>::examine_example(int i1) {
-            size_t i = 0, size = this->samples->getSize();
             double y1 = 0;
             double e1 = 0;
             double r1 = 0;
             double alpha1 = 0;
 
             /*cleaning up done list*/
-            for (i = 0; i < size; ++i) this->l_data[i].done = false;
-            this->l_data[i1].done = true;
+            std::fill(this->done.begin(), this->done.end(), false);
+            this->done[i1] = true;
 
             /*reading stuff from array*/
             auto p = (*this->samples)[i1];
             y1 = p->Y();
             alpha1 = p->Alpha();
-            if (alpha1 > 0 && alpha1 < this->C) e1 = this->l_data[i1].error;
+            if (alpha1 > 0 && alpha1 < this->C) e1 = this->errors[i1];
             else e1 = function(i1) - y1;
 
             /*calculating r1*/
@@ -130,48 +126,52 @@ namespace mltk{
 
         template<typename T>
         bool SMO<T>::max_errors(int i1, double e1) {
-            int k = 0;
-            int i2 = -1;
+            long pos = -1, n_svs = this->sv_index.size();
             double tmax = 0;
-            double e2 = 0;
-            double temp = 0;
-            int_dll *list = nullptr;
 
             if (this->verbose > 2) cout << "  Max errors iterations\n";
 
-            /*iterate through the non-bond examples*/
-            list = this->head->next;
-            while (list != nullptr) {
-                k = list->index;
-                if (this->l_data[k].done == 0 && (*this->samples)[k]->Alpha() < this->C) {
-                    e2 = this->l_data[k].error;
-                    temp = fabs(e1 - e2);
-
-                    if (temp > tmax) {
-                        tmax = temp;
-                        i2 = k;
+            /*iterate through the non-bond examples, ties go to the first position*/
+            #pragma omp parallel if(n_svs >= long(PARALLEL_MIN))
+            {
+                double l_tmax = 0, e2 = 0, temp = 0;
+                long l_pos = -1;
+
+                #pragma omp for nowait
+                for (long l = 0; l < n_svs; ++l) {
+                    int k = this->sv_index[l];
+                    if (!this->done[k] && (*this->samples)[k]->Alpha() < this->C) {
+                        e2 = this->errors[k];
+                        temp = fabs(e1 - e2);
+
+                        if (temp > l_tmax) {
+                            l_tmax = temp;
+                            l_pos = l;
+                        }
                     }
                 }
-                list = list->next;
+                #pragma omp critical
+                if (l_pos != -1 && (l_tmax > tmax || (l_tmax == tmax && l_pos < pos))) {
+                    tmax = l_tmax;
+                    pos = l_pos;
+                }
             }
 
-            return (i2 >= 0 && take_step(i1, i2));
+            return (pos >= 0 && take_step(i1, this->sv_index[pos]));
         }
 
         template<typename T>
         bool SMO<T>::iterate_non_bound(int i1) {
+            size_t j = 0;
             int k = 0;
-            int_dll *list = nullptr;
 
             if (this->verbose > 2) printf("  Non-bound iteration\n");
 
-            /* look through all non-bound examples*/
-            list = this->head->next;
-            while (list != nullptr) {
-                k = list->index;
-                if (this->l_data[k].done == 0 && (*this->samples)[k]->Alpha() < this->C)
+            /* look through all non-bound examples, take_step may change the list*/
+            for (j = 0; j < this->sv_index.size(); ++j) {
+                k = this->sv_index[j];
+                if (!this->done[k] && (*this->samples)[k]->Alpha() < this->C)
                     if (take_step(i1, k)) return true;
-                list = list->next;
             }
 
             return false;
@@ -186,14 +186,12 @@ namespace mltk{
 
             if (this->verbose > 2) cout << "  All-set iteration\n";
 
-            srand(0);
             /*random starting point*/
-            //k0 = 0;
-            k0 = rand() % size;
+            k0 = std::uniform_int_distribution<int>(0, int(size) - 1)(this->generator);
 
             for (k = k0; k < size + k0; ++k) {
                 i2 = k % size;
-                if (this->l_data[i2].done == 0 && take_step(i1, i2))
+                if (!this->done[i2] && take_step(i1, i2))
                     return true;
             }
             return false;
@@ -205,13 +203,12 @@ namespace mltk{
             double alpha1 = 0, alpha2 = 0, new_alpha1 = 0, new_alpha2 = 0;
             double e1 = 0, e2 = 0, min_val = 0, max_val = 0, eta = 0;
             double max_val_f = 0, min_val_f = 0;
-            double bnew = 0, b = 0; //delta_b=0 , b=0;
+            double bnew = 0, b = 0, delta_b = 0;
             double t1 = 0, t2 = 0, error_tot = 0;
-            int_dll *itr = nullptr;
-            dMatrix *matrix = this->kernel->getKernelMatrixPointer();
+            auto const& matrix = this->kernel_rows;
 
             /*this sample is done*/
-            this->l_data[i2].done = true;
+            this->done[i2] = true;
 
             /*get info from sample struct*/
             b = -this->solution.bias;
@@ -222,11 +219,11 @@ namespace mltk{
             alpha2 = (*this->samples)[i2]->Alpha();
 
             /*get error values for i1*/
-            if (alpha1 > 0 && alpha1 < this->C) e1 = this->l_data[i1].error;
+            if (alpha1 > 0 && alpha1 < this->C) e1 = this->errors[i1];
             else e1 = function(i1) - y1;
 
             /*get error values for i2*/
-            if (alpha2 > 0 && alpha2 < this->C) e2 = this->l_data[i2].error;
+            if (alpha2 > 0 && alpha2 < this->C) e2 = this->errors[i2];
             else e2 = function(i2) - y2;
 
             /*calculate s*/
@@ -246,7 +243,7 @@ namespace mltk{
             }
 
             /*compute eta*/
-            eta = 2.0 * (*matrix)[i1][i2] - (*matrix)[i1][i1] - (*matrix)[i2][i2];
+            eta = 2.0 * matrix[i1][i2] - matrix[i1][i1] - matrix[i2][i2];
 
             /*compute new alpha2*/
             if (eta < 0) {
@@ -286,57 +283,47 @@ namespace mltk{
             (*this->samples)[i2]->Alpha() = new_alpha2;
 
             /*saving new stuff into sv list*/
-            if (new_alpha1 > 0 && this->l_data[i1].sv == nullptr) {
-                int_dll *list = int_dll::append(this->head);
+            if (new_alpha1 > 0) sv_insert(i1);
+            else sv_remove(i1);
 
-                list->index = i1;
-                this->l_data[i1].sv = list;
-            } else if (new_alpha1 == 0 && this->l_data[i1].sv != nullptr) {
-                int_dll::remove(&(this->l_data[i1].sv));
-            }
-
-            if (new_alpha2 > 0 && this->l_data[i2].sv == nullptr) {
-                int_dll *list = int_dll::append(this->head);
-                list->index = i2;
-                this->l_data[i2].sv = list;
-            } else if (new_alpha2 == 0 && this->l_data[i2].sv != nullptr) {
-                int_dll::remove(&(this->l_data[i2].sv));
-            }
+            if (new_alpha2 > 0) sv_insert(i2);
+            else sv_remove(i2);
 
             /*update bias*/
             t1 = y1 * (new_alpha1 - alpha1);
             t2 = y2 * (new_alpha2 - alpha2);
 
             if (new_alpha1 > 0 && new_alpha1 < this->C)
-                bnew = b + e1 + t1 * (*matrix)[i1][i1] + t2 * (*matrix)[i1][i2];
+                bnew = b + e1 + t1 * matrix[i1][i1] + t2 * matrix[i1][i2];
             else {
                 if (new_alpha2 > 0 && new_alpha2 < this->C)
-                    bnew = b + e2 + t1 * (*matrix)[i1][i2] + t2 * (*matrix)[i2][i2];
+                    bnew = b + e2 + t1 * matrix[i1][i2] + t2 * matrix[i2][i2];
                 else {
                     double b1 = 0, b2 = 0;
-                    b2 = b + e1 + t1 * (*matrix)[i1][i1] + t2 * (*matrix)[i1][i2];
-                    b1 = b + e2 + t1 * (*matrix)[i1][i2] + t2 * (*matrix)[i2][i2];
+                    b2 = b + e1 + t1 * matrix[i1][i1] + t2 * matrix[i1][i2];
+                    b1 = b + e2 + t1 * matrix[i1][i2] + t2 * matrix[i2][i2];
                     bnew = (b1 + b2) / 2.0;
                 }
             }
-            //delta_b = bnew - b;
+            delta_b = bnew - b;
             b = bnew;
             this->solution.bias = -b;
 
-            /*updating error cache*/
+            /*updating error cache: only alpha1, alpha2 and the bias changed*/
             error_tot = 0;
-            itr = this->head->next;
-            while (itr != nullptr) {
-                i = itr->index;
+            const double *k1 = matrix[i1], *k2 = matrix[i2];
+            long n_svs = this->sv_index.size();
+            #pragma omp parallel for private(i) reduction(+:error_tot) if(n_svs >= long(PARALLEL_MIN))
+            for (long l = 0; l < n_svs; ++l) {
+                i = this->sv_index[l];
                 if ((i != i1 && i != i2) && (*this->samples)[i]->Alpha() < C) {
-                    this->l_data[i].error = function(i) - (*this->samples)[i]->Y();
-                    error_tot += this->l_data[i].error;
+                    this->errors[i] += t1 * k1[i] + t2 * k2[i] - delta_b;
+                    error_tot += this->errors[i];
                 }
-                itr = itr->next;
             }
 
-            this->l_data[i1].error = 0.0;
-            this->l_data[i2].error = 0.0;
+            this->errors[i1] = 0.0;
+            this->errors[i2] = 0.0;
 
             if (this->verbose > 1)
                 cout << "Total error= " << error_tot << ", alpha(" << i1 << ")= " << new_alpha1 << ", alpha(" << i2
@@ -347,16 +334,12 @@ namespace mltk{
 
         template<typename T>
         double SMO<T>::function(int index) {
-            int i = 0;
             double sum = 0;
-            dMatrix *matrix = this->kernel->getKernelMatrixPointer();
-            int_dll *list = this->head->next;
+            auto const& matrix = this->kernel_rows;
 
-            while (list != nullptr) {
-                i = list->index;
+            for (int i: this->sv_index) {
                 if ((*this->samples)[i]->Alpha() > 0)
-                    sum += (*this->samples)[i]->Alpha() * (*this->samples)[i]->Y() * (*matrix)[i][index];
-                list = list->next;
+                    sum += (*this->samples)[i]->Alpha() * (*this->samples)[i]->Y() * matrix[i][index];
             }
             sum += this->solution.bias;
 
@@ -372,12 +355,17 @@ namespace mltk{
             int tot_changed = 0;
             bool examine_all = 1;
 
-            /*initialize variables*/
-            this->solution.bias = 0;
-            for (k = 0; k < size; ++k) {
-                (*this->samples)[k]->Alpha() = 0;
-                this->l_data[k].error = 0;
-                this->l_data[k].done = false;
+            /*initialize variables, the alphas and bias may come from a previous solution*/
+            this->kernel_rows = this->kernel->getKernelRows();
+            this->errors.assign(size, 0.0);
+            this->done.assign(size, false);
+            this->sv_index.clear();
+            this->sv_pos.assign(size, -1);
+            for (k = 0; k < (int) size; ++k)
+                if ((*this->samples)[k]->Alpha() > 0) sv_insert(k);
+            for (k = 0; k < (int) size; ++k) {
+                double alpha = (*this->samples)[k]->Alpha();
+                if (alpha > 0 && alpha < this->C) this->errors[k] = function(k) - (*this->samples)[k]->Y();
             }
 
             /*training*/
@@ -414,7 +402,7 @@ namespace mltk{
         void SMO<T>::test_learning() {
             size_t i = 0, size = this->samples->getSize();
             for (i = 0; i < size; ++i)
-                cout << i + 1 << " -> " << function(i) << " (error=" << this->l_data[i].error << ") (alpha="
+                cout << i + 1 << " -> " << function(i) << " (error=" << this->errors[i] << ") (alpha="
                      << (*this->samples)[i]->Alpha() << ")\n";
         }
 
@@ -423,11 +411,9 @@ namespace mltk{
             size_t i = 0, size = this->samples->getSize();
             bool ret = true;
             double norm = 1;
-            vector<smo_learning_data> l_data(size);
-
-            //srand(0);
 
             /*clear data*/
+            this->generator.seed(this->seed);
             this->solution.bias = 0;
             for (i = 0; i < size; i++)
                 (*this->samples)[i]->Alpha() = 0;
@@ -444,100 +430,429 @@ namespace mltk{
                 if ((*this->samples)[i]->Alpha() > this->C) ret = false;
             }
 
-            int_dll::free(&this->head);
+            this->kernel_rows.clear();
+            this->errors.clear();
+            this->done.clear();
+            this->sv_index.clear();
+            this->sv_pos.clear();
 
             return ret;
         }
 
         /*----------------------------------------------------------*
-        * Created a double linked list of ints                     *
+        * Second order working set selection (Fan, Chen and Lin)   *
+        * with shrinking, on the dual gradient G = Q*alpha - 1     *
         *----------------------------------------------------------*/
 
-        int_dll::int_dll() {
-            this->next = nullptr;
-            this->index = -1;
-            this->prev = nullptr;
+        template<typename T>
+        bool SMO<T>::training_routine_wss2() {
+            size_t size = this->samples->getSize(), k = 0, iter = 0;
+            size_t max_iter = std::max<size_t>(10000000, (size > INT_MAX / 100) ? INT_MAX : 100 * size);
+            int i = 0, j = 0, counter = 0;
+            double C = this->C;
+            auto const& K = this->kernel_rows = this->kernel->getKernelRows();
+            vector<double> &alpha = this->alpha;
+            vector<int> &y = this->labels;
+
+            /*initialize variables, the alphas may come from a previous solution*/
+            alpha.resize(size);
+            this->G.assign(size, -1.0);
+            this->G_bar.assign(size, 0.0);
+            this->labels.resize(size);
+            this->active.resize(size);
+            for (k = 0; k < size; ++k) {
+                alpha[k] = (*this->samples)[k]->Alpha();
+                y[k] = ((*this->samples)[k]->Y() > 0) ? 1 : -1;
+                this->active[k] = k;
+            }
+            vector<int> start_svs;
+            for (k = 0; k < size; ++k)
+                if (alpha[k] > 0) start_svs.push_back(k);
+            if (!start_svs.empty()) {
+                #pragma omp parallel for if(size >= PARALLEL_MIN)
+                for (long t = 0; t < long(size); ++t) {
+                    double g = 0, g_bar = 0;
+
+                    for (int s: start_svs) {
+                        g += alpha[s] * y[s] * K[t][s];
+                        if (alpha[s] >= C) g_bar += C * y[s] * K[t][s];
+                    }
+                    this->G[t] += y[t] * g;
+                    this->G_bar[t] = y[t] * g_bar;
+                }
+            }
+            this->active_size = size;
+            this->unshrink = false;
+            counter = std::min<size_t>(size, 1000) + 1;
+
+            /*training*/
+            while (iter < max_iter) {
+                if (this->shrinking && --counter == 0) {
+                    counter = std::min<size_t>(size, 1000);
+                    do_shrinking();
+                }
+                if (select_working_set(i, j)) {
+                    /*optimal on the active set, check the whole problem*/
+                    reconstruct_gradient();
+                    this->active_size = size;
+                    if (select_working_set(i, j)) break;
+                    counter = 1;
+                }
+                ++iter;
+
+                double old_alpha_i = alpha[i], old_alpha_j = alpha[j];
+                double quad_coef = K[i][i] + K[j][j] - 2.0 * K[i][j];
+                bool ui = (alpha[i] >= C), uj = (alpha[j] >= C);
+
+                if (quad_coef <= 0) quad_coef = TAU;
+                if (y[i] != y[j]) {
+                    double delta = (-this->G[i] - this->G[j]) / quad_coef;
+                    double diff = alpha[i] - alpha[j];
+
+                    alpha[i] += delta;
+                    alpha[j] += delta;
+                    if (diff > 0) {
+                        if (alpha[j] < 0) {
+                            alpha[j] = 0;
+                            alpha[i] = diff;
+                        }
+                    } else if (alpha[i] < 0) {
+                        alpha[i] = 0;
+                        alpha[j] = -diff;
+                    }
+                    if (diff > 0) {
+                        if (alpha[i] > C) {
+                            alpha[i] = C;
+                            alpha[j] = C - diff;
+                        }
+                    } else if (alpha[j] > C) {
+                        alpha[j] = C;
+                        alpha[i] = C + diff;
+                    }
+                } else {
+                    double delta = (this->G[i] - this->G[j]) / quad_coef;
+                    double sum = alpha[i] + alpha[j];
+
+                    alpha[i] -= delta;
+                    alpha[j] += delta;
+                    if (sum > C) {
+                        if (alpha[i] > C) {
+                            alpha[i] = C;
+                            alpha[j] = sum - C;
+                        }
+                    } else if (alpha[j] < 0) {
+                        alpha[j] = 0;
+                        alpha[i] = sum;
+                    }
+                    if (sum > C) {
+                        if (alpha[j] > C) {
+                            alpha[j] = C;
+                            alpha[i] = sum - C;
+                        }
+                    } else if (alpha[i] < 0) {
+                        alpha[i] = 0;
+                        alpha[j] = sum;
+                    }
+                }
+
+                /*update the gradient of the active examples, Q_ik = y_i*y_k*K_ik*/
+                double delta_i = (alpha[i] - old_alpha_i) * y[i], delta_j = (alpha[j] - old_alpha_j) * y[j];
+                const double *Ki = K[i], *Kj = K[j];
+                const int *act = this->active.data();
+                double *g = this->G.data();
+                long n_active = this->active_size, n = size;
+
+                #pragma omp parallel for if(n_active >= long(PARALLEL_MIN))
+                for (long l = 0; l < n_active; ++l) {
+                    int t = act[l];
+                    g[t] += y[t] * (Ki[t] * delta_i + Kj[t] * delta_j);
+                }
+
+                /*update G_bar when a multiplier enters or leaves the upper bound*/
+                if (ui != (alpha[i] >= C)) {
+                    double c = (ui ? -C : C) * y[i];
+                    #pragma omp parallel for if(n >= long(PARALLEL_MIN))
+                    for (long l = 0; l < n; ++l) this->G_bar[l] += c * y[l] * Ki[l];
+                }
+                if (uj != (alpha[j] >= C)) {
+                    double c = (uj ? -C : C) * y[j];
+                    #pragma omp parallel for if(n >= long(PARALLEL_MIN))
+                    for (long l = 0; l < n; ++l) this->G_bar[l] += c * y[l] * Kj[l];
+                }
+            }
+
+            if (this->active_size < size) {
+                reconstruct_gradient();
+                this->active_size = size;
+            }
+            if (this->verbose > 1) cout << "WSS2 iterations: " << iter << endl;
+
+            /*saving the solution*/
+            this->solution.bias = -compute_rho();
+            for (k = 0; k < size; ++k) (*this->samples)[k]->Alpha() = alpha[k];
+            this->G.clear();
+            this->G_bar.clear();
+            this->active.clear();
+            this->labels.clear();
+
+            return iter < max_iter;
         }
 
-        /*----------------------------------------------------------*
-        * Removes an element from a double linked list            *
-        *----------------------------------------------------------*/
+        template<typename T>
+        bool SMO<T>::select_working_set(int &out_i, int &out_j) {
+            double gmax = -INFINITY, gmax2 = -INFINITY, obj_diff_min = INFINITY, C = this->C;
+            long gmax_pos = -1, gmin_pos = -1, n = this->active_size;
+            bool parallel = this->active_size >= PARALLEL_MIN;
+            auto const& K = this->kernel_rows;
+            const vector<double> &alpha = this->alpha, &G = this->G;
+            const vector<int> &y = this->labels, &active = this->active;
+
+            /*i: maximal violating example in I_up, ties go to the last position*/
+            #pragma omp parallel if(parallel)
+            {
+                double l_gmax = -INFINITY;
+                long l_pos = -1;
+
+                #pragma omp for nowait
+                for (long k = 0; k < n; ++k) {
+                    int t = active[k];
+                    double v = -y[t] * G[t];
+
+                    if (((y[t] == 1) ? alpha[t] < C : alpha[t] > 0) && v >= l_gmax) {
+                        l_gmax = v;
+                        l_pos = k;
+                    }
+                }
+                #pragma omp critical
+                if (l_pos != -1 && (l_gmax > gmax || (l_gmax == gmax && l_pos > gmax_pos))) {
+                    gmax = l_gmax;
+                    gmax_pos = l_pos;
+                }
+            }
+            if (gmax_pos == -1) return true;
+
+            /*j: example in I_low with the largest decrease of the objective*/
+            int i = active[gmax_pos];
+            const double *Ki = K[i];
+            #pragma omp parallel if(parallel)
+            {
+                double l_gmax2 = -INFINITY, l_obj_diff_min = INFINITY;
+                long l_pos = -1;
+
+                #pragma omp for nowait
+                for (long k = 0; k < n; ++k) {
+                    int t = active[k];
+
+                    if ((y[t] == 1) ? alpha[t] <= 0 : alpha[t] >= C) continue;
+                    double v = y[t] * G[t], grad_diff = gmax + v;
+
+                    l_gmax2 = std::max(l_gmax2, v);
+                    if (grad_diff > 0) {
+                        double quad_coef = Ki[i] + K[t][t] - 2.0 * Ki[t];
+                        double obj_diff = -(grad_diff * grad_diff) / ((quad_coef > 0) ? quad_coef : TAU);
+
+                        if (obj_diff <= l_obj_diff_min) {
+                            l_pos = k;
+                            l_obj_diff_min = obj_diff;
+                        }
+                    }
+                }
+                #pragma omp critical
+                {
+                    gmax2 = std::max(gmax2, l_gmax2);
+                    if (l_pos != -1 && (l_obj_diff_min < obj_diff_min ||
+                                        (l_obj_diff_min == obj_diff_min && l_pos > gmin_pos))) {
+                        obj_diff_min = l_obj_diff_min;
+                        gmin_pos = l_pos;
+                    }
+                }
+            }
 
-        int_dll *int_dll::remove(int_dll **node) {
-            int_dll *ret = nullptr;
+            if (gmax + gmax2 < WSS_TOL || gmin_pos == -1) return true;
+            out_i = i;
+            out_j = active[gmin_pos];
 
-            if ((*node) == nullptr) return nullptr;
+            return false;
+        }
 
-            /*remove items from list*/
-            ret = (*node)->prev;
+        template<typename T>
+        bool SMO<T>::be_shrunk(int i, double gmax1, double gmax2) {
+            int y = this->labels[i];
 
-            /*fix reference one*/
-            if ((*node)->prev != nullptr)
-                (*node)->prev->next = (*node)->next;
+            if (this->alpha[i] >= this->C) {
+                return (y == 1) ? (-this->G[i] > gmax1) : (-this->G[i] > gmax2);
+            } else if (this->alpha[i] <= 0) {
+                return (y == 1) ? (this->G[i] > gmax2) : (this->G[i] > gmax1);
+            }
+            return false;
+        }
 
-            /*fix reference two*/
-            if ((*node)->next != nullptr)
-                (*node)->next->prev = (*node)->prev;
+        template<typename T>
+        void SMO<T>::do_shrinking() {
+            double gmax1 = -INFINITY, gmax2 = -INFINITY;
+            size_t k;
+
+            /*gmax1 = max{-y_i*G_i, i in I_up}, gmax2 = max{y_i*G_i, i in I_low}*/
+            for (k = 0; k < this->active_size; ++k) {
+                int t = this->active[k];
+                bool upper = this->alpha[t] >= this->C, lower = this->alpha[t] <= 0;
+
+                if (this->labels[t] == 1) {
+                    if (!upper) gmax1 = std::max(gmax1, -this->G[t]);
+                    if (!lower) gmax2 = std::max(gmax2, this->G[t]);
+                } else {
+                    if (!upper) gmax2 = std::max(gmax2, -this->G[t]);
+                    if (!lower) gmax1 = std::max(gmax1, this->G[t]);
+                }
+            }
 
-            delete *node;
-            (*node) = nullptr;
+            /*near the optimum, bring everything back once to avoid wrong shrinking*/
+            if (!this->unshrink && gmax1 + gmax2 <= WSS_TOL * 10) {
+                this->unshrink = true;
+                reconstruct_gradient();
+                this->active_size = this->samples->getSize();
+            }
 
-            return ret;
+            for (k = 0; k < this->active_size; ++k) {
+                if (!be_shrunk(this->active[k], gmax1, gmax2)) continue;
+                --this->active_size;
+                while (this->active_size > k) {
+                    if (!be_shrunk(this->active[this->active_size], gmax1, gmax2)) {
+                        std::swap(this->active[k], this->active[this->active_size]);
+                        break;
+                    }
+                    --this->active_size;
+                }
+            }
         }
 
-        /*----------------------------------------------------------*
-        * Appends a new node after list                            *
-        *----------------------------------------------------------*/
+        template<typename T>
+        void SMO<T>::reconstruct_gradient() {
+            size_t size = this->samples->getSize(), l;
+            auto const& K = this->kernel_rows;
+
+            if (this->active_size == size) return;
+
+            /*G = G_bar - 1 plus the contribution of the free multipliers*/
+            vector<int> free_svs;
+            for (l = 0; l < size; ++l)
+                if (this->alpha[l] > 0 && this->alpha[l] < this->C) free_svs.push_back(l);
 
-        int_dll *int_dll::append(int_dll *list) {
-            int_dll *tmp = nullptr;
+            #pragma omp parallel for if(size - this->active_size >= PARALLEL_MIN)
+            for (long p = this->active_size; p < long(size); ++p) {
+                int t = this->active[p];
+                double g = 0;
 
-            /*error check*/
-            if (list == nullptr) {
-                cerr << "Error in int linked list\n";
-                return nullptr;
+                for (int s: free_svs) g += this->alpha[s] * this->labels[s] * K[t][s];
+                this->G[t] = this->G_bar[t] - 1.0 + this->labels[t] * g;
             }
+        }
 
-            /*save old next*/
-            tmp = list->next;
+        template<typename T>
+        double SMO<T>::compute_rho() {
+            double ub = INFINITY, lb = -INFINITY, sum_free = 0;
+            size_t k, nr_free = 0;
+
+            for (k = 0; k < this->active_size; ++k) {
+                int t = this->active[k], y = this->labels[t];
+                double yG = y * this->G[t];
+
+                if (this->alpha[t] >= this->C) {
+                    if (y == -1) ub = std::min(ub, yG);
+                    else lb = std::max(lb, yG);
+                } else if (this->alpha[t] <= 0) {
+                    if (y == 1) ub = std::min(ub, yG);
+                    else lb = std::max(lb, yG);
+                } else {
+                    ++nr_free;
+                    sum_free += yG;
+                }
+            }
+
+            return (nr_free > 0) ? sum_free / nr_free : (ub + lb) / 2;
+        }
+
+        template<typename T>
+        void SMO<T>::start_alphas() {
+            size_t i = 0, size = this->samples->getSize();
+            double excess = 0;
 
-            /*new node*/
-            list->next = new int_dll;
-            if (list == nullptr) {
-                cerr << "Error: Out of memory\n";
-                return nullptr;
+            this->solution.bias = 0;
+            for (i = 0; i < size; i++)
+                (*this->samples)[i]->Alpha() = 0;
+            if (!this->hasInitialSolution) return;
+            if (this->initial_alpha.size() != size) {
+                cerr << "The initial solution doesn't match the training data, starting from zero." << endl;
+                return;
+            }
+
+            /*clip to the new box, keeping sum(alpha*y) = 0 by releasing the excess from the same class*/
+            this->solution.bias = this->initial_bias;
+            for (i = 0; i < size; i++) {
+                double alpha = std::min(std::max(this->initial_alpha[i], 0.0), double(this->C));
+                (*this->samples)[i]->Alpha() = alpha;
+                excess += alpha * (*this->samples)[i]->Y();
+            }
+            for (i = 0; i < size && fabs(excess) > this->EPS; i++) {
+                auto p = (*this->samples)[i];
+                if (p->Y() * excess <= 0) continue;
+                double delta = std::min(p->Alpha(), fabs(excess));
+                p->Alpha() -= delta;
+                excess -= delta * p->Y();
             }
+        }
 
-            /*reference fixing*/
-            list->next->prev = list;
-            list->next->next = tmp;
-            if (tmp != nullptr) tmp->prev = list->next;
+        template<typename T>
+        void SMO<T>::setInitialSolution(const Solution &initial) {
+            this->initial_alpha = initial.alpha;
+            this->initial_bias = initial.bias;
+            this->hasInitialSolution = !initial.alpha.empty();
+        }
 
-            /*finishing up*/
-            list = list->next;
-            list->index = -1;
+        template<typename T>
+        void SMO<T>::clearInitialSolution() {
+            this->initial_alpha.clear();
+            this->initial_bias = 0;
+            this->hasInitialSolution = false;
+        }
 
-            /*returning*/
-            return list;
+        template<typename T>
+        std::vector<Solution> SMO<T>::regularizationPath(const std::vector<double> &Cs,
+                                                         const std::function<void(size_t)> &trained) {
+            WarmStartGuard guard(*this);
+            std::vector<Solution> path;
+
+            for (size_t i = 0; i < Cs.size(); i++) {
+                this->setC(Cs[i]);
+                this->train();
+                path.push_back(this->solution);
+                if (trained) trained(i);
+                this->setInitialSolution(this->solution);
+            }
+            return path;
         }
 
         /*----------------------------------------------------------*
-        * Clears linked list                                       *
+        * Support vector set: dense array of indexes plus the       *
+        * position of each example in it, removal swaps with last  *
         *----------------------------------------------------------*/
 
-        void int_dll::free(int_dll **head) {
-            int_dll *list = nullptr;
-            int_dll *tmpl = nullptr;
-
-            if (*head == nullptr) return;
+        template<typename T>
+        void SMO<T>::sv_insert(int i) {
+            if (this->sv_pos[i] >= 0) return;
+            this->sv_pos[i] = this->sv_index.size();
+            this->sv_index.push_back(i);
+        }
 
-            list = *head;
-            while (list != nullptr) {
-                tmpl = list;
-                list = list->next;
-                delete tmpl;
-            }
-            *head = nullptr;
+        template<typename T>
+        void SMO<T>::sv_remove(int i) {
+            int pos = this->sv_pos[i];
+
+            if (pos < 0) return;
+            this->sv_index[pos] = this->sv_index.back();
+            this->sv_pos[this->sv_index[pos]] = pos;
+            this->sv_index.pop_back();
+            this->sv_pos[i] = -1;
         }
 
         template
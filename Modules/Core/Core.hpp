@@ -8,5 +8,10 @@
 #include "include/Timer.hpp"
 #include "include/Data.hpp"
 #include "include/Kernel.hpp"
+#include "include/KernelCache.hpp"
 #include "include/DistanceMetric.hpp"
 #include "include/CoverTree.hpp"
+#include "include/KDTree.hpp"
+#include "include/BallTree.hpp"
+#include "include/HNSW.hpp"
+#include "include/PairwiseDistances.hpp"
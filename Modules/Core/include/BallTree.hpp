@@ -0,0 +1,263 @@
+/*! Ball tree for nearest neighbors queries.
+   \file BallTree.hpp
+*/
+
+#ifndef UFJF_MLTK_BALLTREE_HPP
+#define UFJF_MLTK_BALLTREE_HPP
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+#include "Data.hpp"
+#include "DistanceMetric.hpp"
+
+namespace mltk { namespace metrics {
+    /**
+     * \brief Ball tree for k nearest neighbors queries with any true metric (see dist::IsTrueMetric).
+     *
+     * Each node is a ball centered at one of its points, the pivot, with radius equal to the largest distance
+     * from the pivot to the node's points. A node is split between the points closer to one or the other of two
+     * far apart points, at the median, until at most leaf_size points are left. The triangle inequality gives
+     * d(q, pivot) - radius as a lower bound for the distance from the query to the node's points, which prunes
+     * the queries. Only the metric functor is used, so the tree works for any metric of metrics::dist.
+     * Queries are const and can run concurrently.
+     */
+    template<typename T, typename Callable = dist::Euclidean<T> >
+    class BallTree {
+    public:
+        /// Neighbor found by a query, as (distance, index of the point in the data).
+        using Neighbor = std::pair<double, size_t>;
+
+    private:
+        struct Node {
+            /// Range of the node's points in tree order.
+            size_t begin, end;
+            /// Children, only for inner nodes.
+            size_t left = 0, right = 0;
+            /// Center of the ball, one of the node's points.
+            PointPointer<T> pivot;
+            double radius = 0;
+            bool leaf = true;
+        };
+
+        size_t leaf_size = 40;
+        Callable dist_function;
+        /// Points in tree order.
+        std::vector<PointPointer<T> > points;
+        /// Index in the data of each point.
+        std::vector<size_t> index;
+        std::vector<Node> nodes;
+
+        double distance(const Point<T> &a, const Point<T> &b) const { return this->dist_function(a, b); }
+
+        double distance(const Point<T> &a, const Point<T> &b, double bound) const {
+            return dist::boundedDistance(this->dist_function, a, b, bound);
+        }
+
+        size_t build(std::vector<double> &key, size_t begin, size_t end) {
+            size_t id = nodes.size(), j, dim = points[begin]->size(), pivot = begin, far_a = begin, far_b = begin;
+            std::vector<double> centroid(dim, 0.0);
+            double best = std::numeric_limits<double>::infinity(), largest = -1;
+            Node node;
+
+            // the pivot is the point nearest to the centroid, so the ball is small
+            for (j = begin; j < end; ++j)
+                for (size_t d = 0; d < dim; ++d) centroid[d] += double((*points[j])[d]) / (end - begin);
+            for (j = begin; j < end; ++j) {
+                double sq = 0.0;
+                for (size_t d = 0; d < dim; ++d) {
+                    double diff = double((*points[j])[d]) - centroid[d];
+                    sq += diff * diff;
+                }
+                if (sq < best) {
+                    best = sq;
+                    pivot = j;
+                }
+            }
+            std::swap(points[begin], points[pivot]);
+            std::swap(index[begin], index[pivot]);
+            node.begin = begin;
+            node.end = end;
+            node.pivot = points[begin];
+            for (j = begin; j < end; ++j) {
+                key[j] = distance(*points[begin], *points[j]);
+                if (key[j] > largest) {
+                    largest = key[j];
+                    far_a = j;
+                }
+            }
+            node.radius = std::max(0.0, largest);
+            nodes.push_back(node);
+            if (end - begin <= leaf_size || node.radius <= 0) return id;
+
+            // split between the points closer to far_a or to far_b, the point farthest from far_a
+            auto const a = points[far_a];
+            for (largest = -1, j = begin; j < end; ++j) {
+                key[j] = distance(*a, *points[j]);
+                if (key[j] > largest) {
+                    largest = key[j];
+                    far_b = j;
+                }
+            }
+            auto const b = points[far_b];
+            for (j = begin; j < end; ++j) key[j] -= distance(*b, *points[j]);
+
+            std::vector<size_t> order(end - begin);
+            std::vector<PointPointer<T> > sorted_points(end - begin);
+            std::vector<size_t> sorted_index(end - begin);
+            size_t mid = (end - begin) / 2;
+
+            std::iota(order.begin(), order.end(), begin);
+            std::nth_element(order.begin(), order.begin() + mid, order.end(),
+                             [&key](size_t i1, size_t i2) { return key[i1] < key[i2]; });
+            for (j = 0; j < order.size(); ++j) {
+                sorted_points[j] = points[order[j]];
+                sorted_index[j] = index[order[j]];
+            }
+            std::copy(sorted_points.begin(), sorted_points.end(), points.begin() + begin);
+            std::copy(sorted_index.begin(), sorted_index.end(), index.begin() + begin);
+
+            size_t left = build(key, begin, begin + mid);
+            size_t right = build(key, begin + mid, end);
+            nodes[id].left = left;
+            nodes[id].right = right;
+            nodes[id].leaf = false;
+            return id;
+        }
+
+        /**
+         * \brief Lower bound of the distance from the query to the points of a node.
+         */
+        double lowerBound(const Node &node, double pivot_distance) const {
+            double bound = pivot_distance - node.radius;
+            // integral metric values are truncated, so the bound can be off by one
+            if (std::is_integral<T>::value) bound -= 1;
+            return std::max(0.0, bound);
+        }
+
+        void search(const Point<T> &q, size_t id, double pivot_distance, size_t k,
+                    std::vector<Neighbor> &heap) const {
+            const Node &node = nodes[id];
+
+            if (heap.size() == k && lowerBound(node, pivot_distance) >= heap.front().first) return;
+            if (node.leaf) {
+                for (size_t j = node.begin; j < node.end; ++j) {
+                    // the leaf's points only need their exact distance if they can enter the heap
+                    double bound = (heap.size() < k) ? std::numeric_limits<double>::infinity() : heap.front().first;
+                    double d = (j == node.begin) ? pivot_distance : distance(q, *points[j], bound);
+
+                    if (heap.size() < k) {
+                        heap.emplace_back(d, index[j]);
+                        std::push_heap(heap.begin(), heap.end());
+                    } else if (d < heap.front().first) {
+                        std::pop_heap(heap.begin(), heap.end());
+                        heap.back() = Neighbor(d, index[j]);
+                        std::push_heap(heap.begin(), heap.end());
+                    }
+                }
+                return;
+            }
+            double d_left = distance(q, *nodes[node.left].pivot);
+            double d_right = distance(q, *nodes[node.right].pivot);
+            if (d_left <= d_right) {
+                search(q, node.left, d_left, k, heap);
+                search(q, node.right, d_right, k, heap);
+            } else {
+                search(q, node.right, d_right, k, heap);
+                search(q, node.left, d_left, k, heap);
+            }
+        }
+
+    public:
+        BallTree() = default;
+
+        explicit BallTree(Callable dist_func): dist_function(dist_func) {}
+
+        /**
+         * \brief Build the tree with the points of a dataset.
+         * \param data Dataset.
+         * \param _leaf_size Maximum number of points in a leaf.
+         * \param dist_func Metric functor.
+         */
+        explicit BallTree(const Data<T> &data, size_t _leaf_size = 40, Callable dist_func = Callable())
+                : leaf_size(_leaf_size), dist_function(dist_func) { build(data); }
+
+        /**
+         * \brief Build the tree with the points of a dataset, replacing the current points.
+         * The points are shared with the dataset, not copied.
+         * \param data Dataset.
+         * \return bool false if the metric doesn't satisfy the triangle inequality.
+         */
+        bool build(const Data<T> &data) {
+            size_t n = data.getSize();
+            std::vector<double> key(n);
+
+            clear();
+            if (!dist::IsTrueMetric<Callable>::value) {
+                std::cerr << "The ball tree needs a metric that satisfies the triangle inequality." << std::endl;
+                return false;
+            }
+            points.resize(n);
+            index.resize(n);
+            for (size_t j = 0; j < n; ++j) points[j] = data[j];
+            std::iota(index.begin(), index.end(), 0);
+            if (n > 0) build(key, 0, n);
+            return true;
+        }
+
+        /**
+         * \brief Find the k nearest neighbors of a point.
+         * \param q Query point.
+         * \param k Number of neighbors.
+         * \param heap Max-heap filled with the neighbors, as (distance, index of the point in the data). The
+         * buffer is reused, so a caller that keeps it doesn't allocate.
+         */
+        void kNearest(const Point<T> &q, size_t k, std::vector<Neighbor> &heap) const {
+            heap.clear();
+            if (nodes.empty() || k == 0) return;
+            search(q, 0, distance(q, *nodes[0].pivot), k, heap);
+        }
+
+        /**
+         * \brief Find the k nearest neighbors of a point.
+         * \param q Query point.
+         * \param k Number of neighbors.
+         * \return std::vector<Neighbor> with the neighbors sorted by distance.
+         */
+        std::vector<Neighbor> kNearestNeighbors(const Point<T> &q, size_t k) const {
+            std::vector<Neighbor> heap;
+
+            kNearest(q, k, heap);
+            std::sort_heap(heap.begin(), heap.end());
+            return heap;
+        }
+
+        void clear() {
+            points.clear();
+            index.clear();
+            nodes.clear();
+        }
+
+        /**
+         * \brief Set the maximum number of points in a leaf, used by the next build.
+         * \param _leaf_size Leaf size.
+         */
+        void setLeafSize(size_t _leaf_size) { this->leaf_size = std::max<size_t>(1, _leaf_size); }
+
+        size_t getLeafSize() const { return leaf_size; }
+
+        Callable &metric() { return dist_function; }
+
+        /**
+         * \brief Returns the number of points in the tree.
+         * \return size_t
+         */
+        size_t size() const { return index.size(); }
+    };
+}}
+
+#endif //UFJF_MLTK_BALLTREE_HPP
@@ -30,8 +30,8 @@
 
 #include <vector>
 #include <algorithm>
+#include <atomic>
 #include <map>
-#include <set>
 #include <cmath>
 #include <float.h>
 #include <iostream>
@@ -42,13 +42,17 @@
  * Cover Tree. Allows for insertion, removal, and k-nearest-neighbor
  * queries.
  *
- * The user should define double Point::distance(const Point& p) and
- * bool Point::operator==(const Point& p), where
- * p1.distance(p2)==0 doesn't necessarily mean that p1==p2).
+ * The points are handles (e.g. std::shared_ptr<mltk::Point<T>>) compared
+ * with operator== and dereferenced to compute the distances with Callable,
+ * where a distance of 0 doesn't necessarily mean that p1==p2.
  *
  * For example, a point could consist of a vector and a string
  * name, where their distance measure is simply euclidean distance but to be
  * equal they must have the same name in addition to having distance 0.
+ *
+ * The nodes live in a single arena and refer to each other by index, each node
+ * keeps its children grouped by level in contiguous arrays, and base^level is
+ * precomputed for the levels of the tree.
  */
 namespace mltk { namespace metrics {
     template<typename T, class Point, typename Callable = mltk::metrics::dist::Euclidean<T>>
@@ -59,13 +63,15 @@ namespace mltk { namespace metrics {
          */
         class CoverTreeNode {
         private:
-            //_childMap[i] is a vector of the node's children at level i
-            std::map<int, std::vector<CoverTreeNode *> > _childMap;
+            //_children[i] holds the node's children at level _levels[i], the levels in decreasing order
+            std::vector<int> _levels;
+            std::vector<std::vector<size_t> > _children;
             //_points is all of the points with distance 0 which are not equal.
             std::vector<Point> _points;
-            Callable _distance;
         public:
-            CoverTreeNode(const Point &p);
+            CoverTreeNode() = default;
+
+            explicit CoverTreeNode(const Point &p);
 
             /**
              * Returns the children of the node at level i. Note that this means
@@ -74,19 +80,22 @@ namespace mltk { namespace metrics {
              * Does not include the node itself, though technically every node
              * has itself as a child in a cover tree.
              */
-            std::vector<CoverTreeNode *> getChildren(int level) const;
+            const std::vector<size_t> &getChildren(int level) const;
 
-            void addChild(int level, CoverTreeNode *p);
+            void addChild(int level, size_t child);
 
-            void removeChild(int level, CoverTreeNode *p);
+            void removeChild(int level, size_t child);
 
             void addPoint(const Point &p);
 
             void removePoint(const Point &p);
 
-            const std::vector<Point> &getPoints() { return _points; }
+            const std::vector<Point> &getPoints() const { return _points; }
 
-            double distance(const CoverTreeNode &p) const;
+            /**
+             * Returns the levels with children, in decreasing order.
+             */
+            const std::vector<int> &getLevels() const { return _levels; }
 
             bool isSingle() const;
 
@@ -95,22 +104,45 @@ namespace mltk { namespace metrics {
             const Point &getPoint() const;
 
             /**
-             * Return every child of the node from any level. This is handy for
-             * the destructor.
+             * Return every child of the node from any level.
              */
-            std::vector<CoverTreeNode *> getAllChildren() const;
+            std::vector<size_t> getAllChildren() const;
         }; // CoverTreeNode class
     private:
-        typedef std::pair<double, CoverTreeNode *> distNodePair;
+        typedef std::pair<double, size_t> distNodePair;
+        //distance to a node and position of a point in the input of build
+        typedef std::pair<double, size_t> distPointPair;
+
+        /// Index of a missing node.
+        static constexpr size_t NONE = size_t(-1);
 
-        CoverTreeNode *_root;
+        //arena with the nodes, removed nodes are kept in _free to be reused
+        std::vector<CoverTreeNode> _nodes;
+        std::vector<size_t> _free;
+        size_t _root;
         Callable _distance;
         unsigned int _numNodes;
         int _maxLevel;//The level at which (and above) there is only one node: the root node
         int _minLevel;//A level beneath which there are no more new nodes.
+        //_radii[i] is base^(_minLevel + i), for the levels from _minLevel to _maxLevel
+        std::vector<double> _radii;
+
+        double dist(const Point &p, const Point &q) const { return _distance(*p, *q); }
 
-        std::vector<CoverTreeNode *>
-        kNearestNodes(const Point &p, const unsigned int k) const;
+        double dist(const Point &p, size_t node) const { return _distance(*p, *_nodes[node].getPoint()); }
+
+        /**
+         * base^level, from the table for the levels of the tree.
+         */
+        double radius(int level) const;
+
+        void updateRadii();
+
+        size_t newNode(const Point &p);
+
+        void releaseNode(size_t node);
+
+        std::vector<size_t> kNearestNodes(const Point &p, const unsigned int k) const;
 
         /**
          * Recursive implementation of the insert algorithm (see paper).
@@ -119,34 +151,39 @@ namespace mltk { namespace metrics {
                         const std::vector<distNodePair> &Qi,
                         const int &level);
 
-        /**
-         * Finds the node in Q with the minimum distance to p. Returns a
-         * pair consisting of this node and the distance.
-         */
-        distNodePair distance(const Point &p,
-                              const std::vector<CoverTreeNode *> &Q);
-
-
         void remove_rec(const Point &p,
                         std::map<int, std::vector<distNodePair> > &coverSets,
                         int level,
                         bool &multi);
 
+        /**
+         * Recursive implementation of build: creates the children of node at
+         * the given level and below for the points of set, which are all within
+         * base^level of the node. The points farther than base^(level-1) become
+         * children at this level, the farthest first, each one taking the points
+         * within base^(level-1) of it to its own subtree, and the others stay
+         * with the node for the next level. Large subtrees are built as parallel
+         * tasks, each writing only to its own nodes of the preallocated arena.
+         */
+        void build_rec(size_t node, int level, std::vector<distPointPair> set,
+                       const std::vector<Point> &points, std::atomic<size_t> &used);
+
     public:
         constexpr static const double base = 2.0;
 
         /**
          * Constructs a cover tree which begins with all points in points.
-         *
-         * maxDist should be the maximum distance that any two points
-         * can have between each other. IE p.distance(q) < maxDist for all
-         * p,q that you will ever try to insert. The cover tree may be invalid
-         * if an inaccurate maxDist is given.
          */
-
         CoverTree(const std::vector<Point> &points = std::vector<Point>());
 
-        ~CoverTree();
+        /**
+         * Build the tree from all the points at once, replacing its contents.
+         * Much faster than inserting the points one by one, and parallel with
+         * OpenMP. The tree keeps the covering invariant, so the queries, insert
+         * and remove work as usual, but the separation invariant is only
+         * enforced among the children of each node.
+         */
+        void build(const std::vector<Point> &points);
 
         /**
          * Just for testing/debugging. Returns true iff the cover tree satisfies the
@@ -180,7 +217,16 @@ namespace mltk { namespace metrics {
          */
         std::vector<Point> kNearestNeighbors(const Point &p, const unsigned int k) const;
 
-        CoverTreeNode *getRoot() const;
+        /**
+         * Returns the k nearest points of each query, as the single query
+         * version does. The queries only read the tree and run in parallel.
+         */
+        std::vector<std::vector<Point> > kNearestNeighbors(const std::vector<Point> &queries,
+                                                           const unsigned int k) const;
+
+        const CoverTreeNode *getRoot() const;
+
+        Callable &metric() { return _distance; }
 
         /**
          * Print the cover tree.
@@ -190,86 +236,205 @@ namespace mltk { namespace metrics {
 
     template<typename T, class Point, typename Callable>
     CoverTree<T, Point, Callable>::CoverTree(const std::vector<Point> &points) {
-        _root = NULL;
+        _root = NONE;
         _numNodes = 0;
         // levels don't have meaning until there are at least 2 nodes
         //   min/max levels will be set on addition of 2nd node
         _maxLevel = 0;
         _minLevel = 0;
-        typename std::vector<Point>::const_iterator it;
-        for (it = points.begin(); it != points.end(); ++it) {
-            this->insert(*it);
+        updateRadii();
+        if (!points.empty()) build(points);
+    }
+
+    template<typename T, class Point, typename Callable>
+    void CoverTree<T, Point, Callable>::build(const std::vector<Point> &points) {
+        size_t n = points.size();
+        std::vector<distPointPair> set(n > 0 ? n - 1 : 0);
+        double maxDist = 0.0;
+
+        _nodes.clear();
+        _free.clear();
+        _root = NONE;
+        _numNodes = 0;
+        _maxLevel = 0;
+        _minLevel = 0;
+        if (n == 0) {
+            updateRadii();
+            return;
+        }
+        #pragma omp parallel for reduction(max:maxDist)
+        for (long j = 1; j < (long) n; j++) {
+            set[j - 1] = std::make_pair(dist(points[0], points[j]), size_t(j));
+            maxDist = std::max(maxDist, set[j - 1].first);
+        }
+        // each point is at most one node, so the arena doesn't grow while the tasks hold its nodes
+        _nodes.resize(n);
+        _nodes[0] = CoverTreeNode(points[0]);
+        _root = 0;
+        std::atomic<size_t> used(1);
+        if (maxDist > 0.0) {
+            int rqdLevel = ceilf(std::log(maxDist) / std::log(base));
+            while (std::pow(base, rqdLevel) < maxDist) rqdLevel++;
+            _maxLevel = rqdLevel + 1;
+        }
+        #pragma omp parallel
+        #pragma omp single
+        build_rec(_root, _maxLevel, std::move(set), points, used);
+        _nodes.resize(used);
+        _numNodes = used;
+        if (_numNodes > 1) {
+            // levels are meaningful from the second node on, as in insert
+            _minLevel = _maxLevel;
+            for (auto const &node: _nodes) {
+                if (!node.getLevels().empty()) _minLevel = std::min(_minLevel, node.getLevels().back() - 1);
+            }
         }
+        updateRadii();
     }
 
     template<typename T, class Point, typename Callable>
-    CoverTree<T, Point, Callable>::~CoverTree() {
-        if (_root == NULL) return;
-        //Get all of the root's children (from any level),
-        //delete the root, repeat for each of the children
-        std::vector<CoverTreeNode *> nodes;
-        nodes.push_back(_root);
-        while (!nodes.empty()) {
-            CoverTreeNode *byeNode = nodes[0];
-            nodes.erase(nodes.begin());
-            std::vector<CoverTreeNode *> children = byeNode->getAllChildren();
-            nodes.insert(nodes.begin(), children.begin(), children.end());
-            //std::cout << _numNodes << "\n";
-            delete byeNode;
-            //_numNodes--;
+    void CoverTree<T, Point, Callable>::build_rec(size_t node, int level, std::vector<distPointPair> set,
+                                                  const std::vector<Point> &points, std::atomic<size_t> &used) {
+        const size_t parallelMin = 1024;
+
+        while (!set.empty()) {
+            double maxDist = 0.0;
+            size_t kept = 0;
+            //points at distance 0 share the node
+            for (auto const &s: set) {
+                if (s.first == 0.0) {
+                    _nodes[node].addPoint(points[s.second]);
+                } else {
+                    set[kept++] = s;
+                    maxDist = std::max(maxDist, s.first);
+                }
+            }
+            set.resize(kept);
+            if (set.empty()) return;
+            //skip the levels without children
+            int top = ceilf(std::log(maxDist) / std::log(base));
+            while (std::pow(base, top) < maxDist) top++;
+            level = std::min(level, top);
+
+            double sep = std::pow(base, level - 1);
+            std::vector<distPointPair> near, far;
+            for (auto const &s: set) {
+                if (s.first <= sep) near.push_back(s);
+                else far.push_back(s);
+            }
+            while (!far.empty()) {
+                size_t farthest = 0;
+                for (size_t i = 1; i < far.size(); i++)
+                    if (far[i].first > far[farthest].first) farthest = i;
+                std::swap(far[farthest], far.back());
+                const Point &q = points[far.back().second];
+                far.pop_back();
+
+                size_t child = used++;
+                _nodes[child] = CoverTreeNode(q);
+                _nodes[node].addChild(level, child);
+                std::vector<distPointPair> assigned;
+                kept = 0;
+                for (auto const &s: far) {
+                    double d = dist(q, points[s.second]);
+                    if (d <= sep) assigned.push_back(std::make_pair(d, s.second));
+                    else far[kept++] = s;
+                }
+                far.resize(kept);
+                if (assigned.size() >= parallelMin) {
+                    #pragma omp task firstprivate(child, level, assigned) shared(points, used)
+                    build_rec(child, level - 1, std::move(assigned), points, used);
+                } else {
+                    build_rec(child, level - 1, std::move(assigned), points, used);
+                }
+            }
+            set.swap(near);
+            level--;
+        }
+    }
+
+    template<typename T, class Point, typename Callable>
+    double CoverTree<T, Point, Callable>::radius(int level) const {
+        if (level >= _minLevel && level <= _maxLevel) return _radii[level - _minLevel];
+        return std::pow(base, level);
+    }
+
+    template<typename T, class Point, typename Callable>
+    void CoverTree<T, Point, Callable>::updateRadii() {
+        _radii.resize(_maxLevel - _minLevel + 1);
+        for (int level = _minLevel; level <= _maxLevel; level++) _radii[level - _minLevel] = std::pow(base, level);
+    }
+
+    template<typename T, class Point, typename Callable>
+    size_t CoverTree<T, Point, Callable>::newNode(const Point &p) {
+        if (_free.empty()) {
+            _nodes.emplace_back(p);
+            return _nodes.size() - 1;
         }
+        size_t node = _free.back();
+        _free.pop_back();
+        _nodes[node] = CoverTreeNode(p);
+        return node;
     }
 
     template<typename T, class Point, typename Callable>
-    std::vector<typename CoverTree<T, Point, Callable>::CoverTreeNode *>
+    void CoverTree<T, Point, Callable>::releaseNode(size_t node) {
+        // drop the points and children, the slot is reused by the next insertion
+        _nodes[node] = CoverTreeNode();
+        _free.push_back(node);
+    }
+
+    template<typename T, class Point, typename Callable>
+    std::vector<size_t>
     CoverTree<T, Point, Callable>::kNearestNodes(const Point &p, const unsigned int k) const {
-        if (_root == NULL) return std::vector<CoverTreeNode *>();
-        if (_numNodes < 2) return std::vector<CoverTreeNode *>(1, _root);
+        if (_root == NONE || k == 0) return std::vector<size_t>();
+        if (_numNodes < 2) return std::vector<size_t>(1, _root);
 
         //maxDist is the kth nearest known point to p, and also the farthest
-        //point from p in the set minNodes defined below.
+        //point from p in the heap minNodes defined below.
 
-        double maxDist = _distance(*p, *_root->getPoint());
+        double maxDist = dist(p, _root);
 
-        //minNodes stores the k nearest known points to p.
-        std::set<distNodePair> minNodes;
-        minNodes.insert(std::make_pair(maxDist, _root));
+        //minNodes is a bounded max-heap with the k nearest known points to p.
+        std::vector<distNodePair> minNodes(1, std::make_pair(maxDist, _root));
+        minNodes.reserve(k + 1);
 
         std::vector<distNodePair> Qj(1, std::make_pair(maxDist, _root));
         for (int level = _maxLevel; level >= _minLevel; level--) {
             size_t size = Qj.size();
-            for (int i = 0; i < size; i++) {
-                std::vector<CoverTreeNode *> children = Qj[i].second->getChildren(level);
-                typename std::vector<CoverTreeNode *>::const_iterator it2;
-                for (it2 = children.begin(); it2 != children.end(); ++it2) {
-                    double d = _distance(*p, *(*it2)->getPoint());
-                    if (d < maxDist || minNodes.size() < k) {
-                        minNodes.insert(std::make_pair(d, *it2));
-                        //--minNodes.end() gives us an iterator to the greatest
-                        //element of minNodes.
-                        if (minNodes.size() > k) minNodes.erase(--minNodes.end());
-                        maxDist = (--minNodes.end())->first;
+            for (size_t i = 0; i < size; i++) {
+                const std::vector<size_t> &children = _nodes[Qj[i].second].getChildren(level);
+                for (size_t child: children) {
+                    double d = dist(p, child);
+                    if (minNodes.size() < k) {
+                        minNodes.emplace_back(d, child);
+                        std::push_heap(minNodes.begin(), minNodes.end());
+                        maxDist = minNodes.front().first;
+                    } else if (d < maxDist) {
+                        std::pop_heap(minNodes.begin(), minNodes.end());
+                        minNodes.back() = std::make_pair(d, child);
+                        std::push_heap(minNodes.begin(), minNodes.end());
+                        maxDist = minNodes.front().first;
                     }
-                    Qj.push_back(std::make_pair(d, *it2));
+                    Qj.emplace_back(d, child);
                 }
             }
-            double sep = maxDist + std::pow(base, level);
+            double sep = maxDist + _radii[level - _minLevel];
             size = Qj.size();
-            for (int i = 0; i < size; i++) {
+            for (size_t i = 0; i < size;) {
                 if (Qj[i].first > sep) {
                     //quickly removes an element from a vector w/o preserving order.
                     Qj[i] = Qj.back();
                     Qj.pop_back();
                     size--;
-                    i--;
+                } else {
+                    i++;
                 }
             }
         }
-        std::vector<CoverTreeNode *> kNN;
-        typename std::set<distNodePair>::const_iterator it;
-        for (it = minNodes.begin(); it != minNodes.end(); ++it) {
-            kNN.push_back(it->second);
-        }
+        std::sort_heap(minNodes.begin(), minNodes.end());
+        std::vector<size_t> kNN(minNodes.size());
+        for (size_t i = 0; i < minNodes.size(); i++) kNN[i] = minNodes[i].second;
         return kNN;
     }
 
@@ -277,37 +442,36 @@ namespace mltk { namespace metrics {
     bool CoverTree<T, Point, Callable>::insert_rec(const Point &p,
                                                    const std::vector<distNodePair> &Qi,
                                                    const int &level) {
-        std::vector<std::pair<double, CoverTreeNode *> > Qj;
-        double sep = std::pow(base, level);
+        std::vector<distNodePair> Qj;
+        double sep = radius(level);
         double minDist = DBL_MAX;
-        std::pair<double, CoverTreeNode *> minQiDist(DBL_MAX, NULL);
-        typename std::vector<std::pair<double, CoverTreeNode *> >::const_iterator it;
+        distNodePair minQiDist(DBL_MAX, NONE);
+        typename std::vector<distNodePair>::const_iterator it;
         for (it = Qi.begin(); it != Qi.end(); ++it) {
             if (it->first < minQiDist.first) minQiDist = *it;
             if (it->first < minDist) minDist = it->first;
             if (it->first <= sep) Qj.push_back(*it);
-            std::vector<CoverTreeNode *> children = it->second->getChildren(level);
-            typename std::vector<CoverTreeNode *>::const_iterator it2;
-            for (it2 = children.begin(); it2 != children.end(); ++it2) {
-                double d = _distance(*p, *(*it2)->getPoint());
+            const std::vector<size_t> &children = _nodes[it->second].getChildren(level);
+            for (size_t child: children) {
+                double d = dist(p, child);
                 if (d < minDist) minDist = d;
                 if (d <= sep) {
-                    Qj.push_back(std::make_pair(d, *it2));
+                    Qj.push_back(std::make_pair(d, child));
                 }
             }
         }
-        //std::cout << "level: " << level << ", sep: " << sep << ", dist: " << minQDist.first << "\n";
         if (minDist > sep) {
             return true;
         } else {
             bool found = insert_rec(p, Qj, level - 1);
-            //distNodePair minQiDist = distance(p,Qi);
             if (found && minQiDist.first <= sep) {
-                if (level - 1 < _minLevel) _minLevel = level - 1;
-                minQiDist.second->addChild(level,
-                                           new CoverTreeNode(p));
-                //std::cout << "parent is ";
-                //minQiDist.second->getPoint().print();
+                if (level - 1 < _minLevel) {
+                    _minLevel = level - 1;
+                    updateRadii();
+                }
+                // the arena may grow, so the parent is looked up after the new node is created
+                size_t child = newNode(p);
+                _nodes[minQiDist.second].addChild(level, child);
                 _numNodes++;
                 return false;
             } else {
@@ -324,50 +488,49 @@ namespace mltk { namespace metrics {
         std::vector<distNodePair> &Qi = coverSets[level];
         std::vector<distNodePair> &Qj = coverSets[level - 1];
         double minDist = DBL_MAX;
-        CoverTreeNode *minNode = _root;
-        CoverTreeNode *parent = 0;
-        double sep = std::pow(base, level);
+        size_t minNode = _root;
+        size_t parent = NONE;
+        double sep = radius(level);
         typename std::vector<distNodePair>::const_iterator it;
         //set Qj to be all children q of Qi such that p.distance(q)<=sep
         //and also keep track of the minimum distance from p to a node in Qj
         //note that every node has itself as a child, but the
         //getChildren function only returns non-self-children.
         for (it = Qi.begin(); it != Qi.end(); ++it) {
-            std::vector<CoverTreeNode *> children = it->second->getChildren(level);
-            double dist = it->first;
-            if (dist < minDist) {
-                minDist = dist;
+            const std::vector<size_t> &children = _nodes[it->second].getChildren(level);
+            double d = it->first;
+            if (d < minDist) {
+                minDist = d;
                 minNode = it->second;
             }
-            if (dist <= sep) {
+            if (d <= sep) {
                 Qj.push_back(*it);
             }
-            typename std::vector<CoverTreeNode *>::const_iterator it2;
-            for (it2 = children.begin(); it2 != children.end(); ++it2) {
-                dist = p.distance((*it2)->getPoint());
-                if (dist < minDist) {
-                    minDist = dist;
-                    minNode = *it2;
-                    if (dist == 0.0) parent = it->second;
+            for (size_t child: children) {
+                d = dist(p, child);
+                if (d < minDist) {
+                    minDist = d;
+                    minNode = child;
+                    if (d == 0.0) parent = it->second;
                 }
-                if (dist <= sep) {
-                    Qj.push_back(std::make_pair(dist, *it2));
+                if (d <= sep) {
+                    Qj.push_back(std::make_pair(d, child));
                 }
             }
         }
         if (level > _minLevel) remove_rec(p, coverSets, level - 1, multi);
-        if (minNode->hasPoint(p)) {
+        if (_nodes[minNode].hasPoint(p)) {
             //the multi flag indicates the point we removed is from a
             //node containing multiple points, and we have removed it,
             //so we don't need to do anything else.
             if (multi) return;
-            if (!minNode->isSingle()) {
-                minNode->removePoint(p);
+            if (!_nodes[minNode].isSingle()) {
+                _nodes[minNode].removePoint(p);
                 multi = true;
                 return;
             }
-            if (parent != NULL) parent->removeChild(level, minNode);
-            std::vector<CoverTreeNode *> children = minNode->getChildren(level - 1);
+            if (parent != NONE) _nodes[parent].removeChild(level, minNode);
+            std::vector<size_t> children = _nodes[minNode].getChildren(level - 1);
             std::vector<distNodePair> &Q = coverSets[level - 1];
             if (Q.size() == 1 && Q[0].second == minNode) {
                 Q.pop_back();
@@ -380,78 +543,54 @@ namespace mltk { namespace metrics {
                     }
                 }
             }
-            typename std::vector<CoverTreeNode *>::const_iterator it;
-            for (it = children.begin(); it != children.end(); ++it) {
+            for (size_t child: children) {
                 int i = level - 1;
-                Point q = (*it)->getPoint();
-                double minDQ = DBL_MAX;
-                CoverTreeNode *minDQNode = nullptr;
-                double sep = std::pow(base, i);
+                const Point &q = _nodes[child].getPoint();
+                size_t minDQNode = NONE;
+                double sep = radius(i);
                 bool br = false;
                 while (true) {
-                    std::vector<distNodePair> &
-                            Q = coverSets[i];
-                    typename std::vector<distNodePair>::const_iterator it2;
-                    minDQ = DBL_MAX;
-                    for (it2 = Q.begin(); it2 != Q.end(); ++it2) {
-                        double d = q.distance(it2->second->getPoint());
+                    std::vector<distNodePair> &Q = coverSets[i];
+                    double minDQ = DBL_MAX;
+                    for (auto const &candidate: Q) {
+                        //the removed node is still in the cover sets of the levels above
+                        if (candidate.second == minNode) continue;
+                        double d = dist(q, candidate.second);
                         if (d < minDQ) {
                             minDQ = d;
-                            minDQNode = it2->second;
+                            minDQNode = candidate.second;
                             if (d <= sep) {
                                 br = true;
                                 break;
                             }
                         }
                     }
-                    minDQ = DBL_MAX;
                     if (br) break;
-                    Q.push_back(std::make_pair((*it)->distance(p), *it));
+                    Q.push_back(std::make_pair(dist(p, child), child));
                     i++;
-                    sep = std::pow(base, i);
+                    sep = radius(i);
                 }
-                //minDQNode->getPoint().print();
-                //std::cout << " is level " << i << " parent of ";
-                //(*it)->getPoint().print();
-                minDQNode->addChild(i, *it);
+                _nodes[minDQNode].addChild(i, child);
             }
-            if (parent != NULL) {
-                delete minNode;
+            if (parent != NONE) {
+                releaseNode(minNode);
                 _numNodes--;
             }
         }
     }
 
-    template<typename T, class Point, typename Callable>
-    std::pair<double, typename CoverTree<T, Point, Callable>::CoverTreeNode *>
-    CoverTree<T, Point, Callable>::distance(const Point &p,
-                                            const std::vector<CoverTreeNode *> &Q) {
-        double minDist = DBL_MAX;
-        CoverTreeNode *minNode;
-        typename std::vector<CoverTreeNode *>::const_iterator it;
-        for (it = Q.begin(); it != Q.end(); ++it) {
-            double dist = p.distance((*it)->getPoint());
-            if (dist < minDist) {
-                minDist = dist;
-                minNode = *it;
-            }
-        }
-        return std::make_pair(minDist, minNode);
-    }
-
     template<typename T, class Point, typename Callable>
     void CoverTree<T, Point, Callable>::insert(const Point &newPoint) {
-        if (_root == NULL) {
-            _root = new CoverTreeNode(newPoint);
+        if (_root == NONE) {
+            _root = newNode(newPoint);
             _numNodes = 1;
             return;
         }
 
-        double rootDist = _distance(*newPoint, *_root->getPoint());
-//    double rootDist = newPoint.distance(_root->getPoint());
+        double rootDist = dist(newPoint, _root);
 
         if (rootDist == 0.0) {
-            _root->addPoint(newPoint);
+            _nodes[_root].addPoint(newPoint);
             return;
         }
 
@@ -460,26 +599,28 @@ namespace mltk { namespace metrics {
         if (_numNodes == 1) {
             _maxLevel = rqdLevel + 1;
             _minLevel = rqdLevel - 1;
-            _root->addChild(rqdLevel, new CoverTreeNode(newPoint));
+            updateRadii();
+            size_t child = newNode(newPoint);
+            _nodes[_root].addChild(rqdLevel, child);
             _numNodes++;
             return;
         }
 
         if (rqdLevel >= _maxLevel) {
             _maxLevel = rqdLevel + 1;
+            updateRadii();
         }
 
         //TODO: this is pretty inefficient, there may be a better way
         //to check if the node already exists...
-        CoverTreeNode *n = kNearestNodes(newPoint, 1)[0];
-        if (_distance(*newPoint, *n->getPoint()) == 0.0) {
-            n->addPoint(newPoint);
+        size_t n = kNearestNodes(newPoint, 1)[0];
+        if (dist(newPoint, n) == 0.0) {
+            _nodes[n].addPoint(newPoint);
         } else {
             //insert_rec acts under the assumption that there are no nodes with
             //distance 0 to newPoint in the cover tree (the previous lines check it)
             insert_rec(newPoint,
-                       std::vector<distNodePair>
-                               (1, std::make_pair(_root->distance(newPoint), _root)),
+                       std::vector<distNodePair>(1, std::make_pair(rootDist, _root)),
                        _maxLevel);
         }
     }
@@ -487,38 +628,39 @@ namespace mltk { namespace metrics {
     template<typename T, class Point, typename Callable>
     void CoverTree<T, Point, Callable>::remove(const Point &p) {
         //Most of this function's code is for the special case of removing the root
-        if (_root == NULL) return;
-        bool removingRoot = _root->hasPoint(p);
-        if (removingRoot && !_root->isSingle()) {
-            _root->removePoint(p);
+        if (_root == NONE) return;
+        bool removingRoot = _nodes[_root].hasPoint(p);
+        if (removingRoot && !_nodes[_root].isSingle()) {
+            _nodes[_root].removePoint(p);
             return;
         }
-        CoverTreeNode *newRoot = NULL;
+        size_t newRoot = NONE;
         if (removingRoot) {
             if (_numNodes == 1) {
                 //removing the last node...
-                delete _root;
+                _nodes.clear();
+                _free.clear();
                 _numNodes--;
-                _root = NULL;
+                _root = NONE;
                 return;
             } else {
                 for (int i = _maxLevel; i > _minLevel; i--) {
-                    if (!(_root->getChildren(i).empty())) {
-                        newRoot = _root->getChildren(i).back();
-                        _root->removeChild(i, newRoot);
+                    if (!(_nodes[_root].getChildren(i).empty())) {
+                        newRoot = _nodes[_root].getChildren(i).back();
+                        _nodes[_root].removeChild(i, newRoot);
                         break;
                     }
                 }
             }
         }
         std::map<int, std::vector<distNodePair> > coverSets;
-        coverSets[_maxLevel].push_back(std::make_pair(_root->distance(p), _root));
+        coverSets[_maxLevel].push_back(std::make_pair(dist(p, _root), _root));
         if (removingRoot)
-            coverSets[_maxLevel].push_back(std::make_pair(newRoot->distance(p), newRoot));
+            coverSets[_maxLevel].push_back(std::make_pair(dist(p, newRoot), newRoot));
         bool multi = false;
         remove_rec(p, coverSets, _maxLevel, multi);
         if (removingRoot) {
-            delete _root;
+            releaseNode(_root);
             _numNodes--;
             _root = newRoot;
         }
@@ -527,51 +669,57 @@ namespace mltk { namespace metrics {
     template<typename T, class Point, typename Callable>
     std::vector<Point> CoverTree<T, Point, Callable>::kNearestNeighbors(const Point &p,
                                                                         const unsigned int k) const {
-        if (_root == NULL) return std::vector<Point>();
-        std::vector<CoverTreeNode *> v = kNearestNodes(p, k);
+        if (_root == NONE) return std::vector<Point>();
+        std::vector<size_t> v = kNearestNodes(p, k);
         std::vector<Point> kNN;
-        typename std::vector<CoverTreeNode *>::const_iterator it;
-        for (it = v.begin(); it != v.end(); ++it) {
-            const std::vector<Point> &p = (*it)->getPoints();
-            kNN.insert(kNN.end(), p.begin(), p.end());
+        for (size_t node: v) {
+            const std::vector<Point> &points = _nodes[node].getPoints();
+            kNN.insert(kNN.end(), points.begin(), points.end());
             if (kNN.size() >= k) break;
         }
         return kNN;
     }
 
+    template<typename T, class Point, typename Callable>
+    std::vector<std::vector<Point> >
+    CoverTree<T, Point, Callable>::kNearestNeighbors(const std::vector<Point> &queries, const unsigned int k) const {
+        std::vector<std::vector<Point> > kNN(queries.size());
+
+        #pragma omp parallel for schedule(dynamic, 16)
+        for (long i = 0; i < (long) queries.size(); i++) {
+            kNN[i] = kNearestNeighbors(queries[i], k);
+        }
+        return kNN;
+    }
+
     template<typename T, class Point, typename Callable>
     void CoverTree<T, Point, Callable>::print() const {
-        if (_root == NULL) {
+        if (_root == NONE) {
             std::cout << "Empty Tree\n";
             return;
         }
 
         if (_numNodes == 1) {
             std::cout << "Single Node -- NO levels\n";
-            std::cout << _root->getPoint() << std::endl;
+            std::cout << _nodes[_root].getPoint() << std::endl;
             return;
         }
 
         int d = _maxLevel - _minLevel + 1;
-        std::vector<CoverTreeNode *> Q;
+        std::vector<size_t> Q;
         Q.push_back(_root);
         for (int i = 0; i < d; i++) {
             std::cout << "LEVEL " << _maxLevel - i << "\n";
-            typename std::vector<CoverTreeNode *>::const_iterator it;
-            for (it = Q.begin(); it != Q.end(); ++it) {
-                std::cout << (*it)->getPoint() << std::endl;
-                std::vector<CoverTreeNode *>
-                        children = (*it)->getChildren(_maxLevel - i);
-                typename std::vector<CoverTreeNode *>::const_iterator it2;
-                for (it2 = children.begin(); it2 != children.end(); ++it2) {
+            for (size_t node: Q) {
+                std::cout << _nodes[node].getPoint() << std::endl;
+                for (size_t child: _nodes[node].getChildren(_maxLevel - i)) {
                     std::cout << "  ";
-                    std::cout << (*it2)->getPoint() << std::endl;
+                    std::cout << _nodes[child].getPoint() << std::endl;
                 }
             }
-            std::vector<CoverTreeNode *> newQ;
-            for (it = Q.begin(); it != Q.end(); ++it) {
-                std::vector<CoverTreeNode *>
-                        children = (*it)->getChildren(_maxLevel - i);
+            std::vector<size_t> newQ;
+            for (size_t node: Q) {
+                const std::vector<size_t> &children = _nodes[node].getChildren(_maxLevel - i);
                 newQ.insert(newQ.end(), children.begin(), children.end());
             }
             Q.insert(Q.end(), newQ.begin(), newQ.end());
@@ -580,8 +728,8 @@ namespace mltk { namespace metrics {
     }
 
     template<typename T, class Point, typename Callable>
-    typename CoverTree<T, Point, Callable>::CoverTreeNode *CoverTree<T, Point, Callable>::getRoot() const {
-        return _root;
+    const typename CoverTree<T, Point, Callable>::CoverTreeNode *CoverTree<T, Point, Callable>::getRoot() const {
+        return (_root == NONE) ? nullptr : &_nodes[_root];
     }
 
     template<typename T, class Point, typename Callable>
@@ -590,30 +738,39 @@ namespace mltk { namespace metrics {
     }
 
     template<typename T, class Point, typename Callable>
-    std::vector<typename CoverTree<T, Point, Callable>::CoverTreeNode *>
+    const std::vector<size_t> &
     CoverTree<T, Point, Callable>::CoverTreeNode::getChildren(int level) const {
-        typename std::map<int, std::vector<CoverTreeNode *> >::const_iterator
-                it = _childMap.find(level);
-        if (it != _childMap.end()) {
-            return it->second;
+        static const std::vector<size_t> empty;
+        for (size_t i = 0; i < _levels.size() && _levels[i] >= level; i++) {
+            if (_levels[i] == level) return _children[i];
         }
-        return std::vector<CoverTreeNode *>();
+        return empty;
     }
 
     template<typename T, class Point, typename Callable>
-    void CoverTree<T, Point, Callable>::CoverTreeNode::addChild(int level, CoverTreeNode *p) {
-        _childMap[level].push_back(p);
+    void CoverTree<T, Point, Callable>::CoverTreeNode::addChild(int level, size_t child) {
+        size_t i = 0;
+        while (i < _levels.size() && _levels[i] > level) i++;
+        if (i == _levels.size() || _levels[i] != level) {
+            _levels.insert(_levels.begin() + i, level);
+            _children.insert(_children.begin() + i, std::vector<size_t>());
+        }
+        _children[i].push_back(child);
     }
 
     template<typename T, class Point, typename Callable>
-    void CoverTree<T, Point, Callable>::CoverTreeNode::removeChild(int level, CoverTreeNode *p) {
-        std::vector<CoverTreeNode *> &v = _childMap[level];
-        for (unsigned int i = 0; i < v.size(); i++) {
-            if (v[i] == p) {
-                v[i] = v.back();
-                v.pop_back();
-                break;
+    void CoverTree<T, Point, Callable>::CoverTreeNode::removeChild(int level, size_t child) {
+        for (size_t i = 0; i < _levels.size(); i++) {
+            if (_levels[i] != level) continue;
+            std::vector<size_t> &v = _children[i];
+            for (unsigned int j = 0; j < v.size(); j++) {
+                if (v[j] == child) {
+                    v[j] = v.back();
+                    v.pop_back();
+                    break;
+                }
             }
+            break;
         }
     }
 
@@ -631,11 +788,6 @@ namespace mltk { namespace metrics {
             _points.erase(it);
     }
 
-    template<typename T, class Point, typename Callable>
-    double CoverTree<T, Point, Callable>::CoverTreeNode::distance(const CoverTreeNode &p) const {
-        return _distance(*_points[0], *p.getPoint());
-    }
-
     template<typename T, class Point, typename Callable>
     bool CoverTree<T, Point, Callable>::CoverTreeNode::isSingle() const {
         return _points.size() == 1;
@@ -650,12 +802,10 @@ namespace mltk { namespace metrics {
     const Point &CoverTree<T, Point, Callable>::CoverTreeNode::getPoint() const { return _points[0]; }
 
     template<typename T, class Point, typename Callable>
-    std::vector<typename CoverTree<T, Point, Callable>::CoverTreeNode *>
-    CoverTree<T, Point, Callable>::CoverTreeNode::getAllChildren() const {
-        std::vector<CoverTreeNode *> children;
-        typename std::map<int, std::vector<CoverTreeNode *> >::const_iterator it;
-        for (it = _childMap.begin(); it != _childMap.end(); ++it) {
-            children.insert(children.end(), it->second.begin(), it->second.end());
+    std::vector<size_t> CoverTree<T, Point, Callable>::CoverTreeNode::getAllChildren() const {
+        std::vector<size_t> children;
+        for (auto const &level: _children) {
+            children.insert(children.end(), level.begin(), level.end());
         }
         return children;
     }
@@ -663,38 +813,36 @@ namespace mltk { namespace metrics {
     template<typename T, class Point, typename Callable>
     bool CoverTree<T, Point, Callable>::isValidTree() const {
         if (_numNodes == 0)
-            return _root == NULL;
+            return _root == NONE;
 
-        std::vector<CoverTreeNode *> nodes;
+        std::vector<size_t> nodes;
         nodes.push_back(_root);
         for (int i = _maxLevel; i > _minLevel; i--) {
-            double sep = std::pow(base, i);
-            typename std::vector<CoverTreeNode *>::const_iterator it, it2;
+            double sep = radius(i);
             //verify separation invariant of cover tree: for each level,
             //every point is farther than base^level away
-            for (it = nodes.begin(); it != nodes.end(); ++it) {
-                for (it2 = nodes.begin(); it2 != nodes.end(); ++it2) {
-                    double dist = (*it)->distance((*it2)->getPoint());
-                    if (dist <= sep && dist != 0.0) {
+            for (size_t n1: nodes) {
+                for (size_t n2: nodes) {
+                    double d = dist(_nodes[n1].getPoint(), n2);
+                    if (d <= sep && d != 0.0) {
                         std::cout << "Level " << i << " Separation invariant failed.\n";
                         return false;
                     }
                 }
             }
-            std::vector<CoverTreeNode *> allChildren;
-            for (it = nodes.begin(); it != nodes.end(); ++it) {
-                std::vector<CoverTreeNode *> children = (*it)->getChildren(i);
+            std::vector<size_t> allChildren;
+            for (size_t node: nodes) {
+                const std::vector<size_t> &children = _nodes[node].getChildren(i);
                 //verify covering tree invariant: the children of node n at level
                 //i are no further than base^i away
-                for (it2 = children.begin(); it2 != children.end(); ++it2) {
-                    double dist = (*it2)->distance((*it)->getPoint());
-                    if (dist > sep) {
+                for (size_t child: children) {
+                    double d = dist(_nodes[child].getPoint(), node);
+                    if (d > sep) {
                         std::cout << "Level" << i << " covering tree invariant failed.n";
                         return false;
                     }
                 }
-                allChildren.insert
-                        (allChildren.end(), children.begin(), children.end());
+                allChildren.insert(allChildren.end(), children.begin(), children.end());
             }
             nodes.insert(nodes.begin(), allChildren.begin(), allChildren.end());
         }
@@ -376,6 +376,13 @@ namespace mltk{
          * \return bool
          */
         bool removePoint (int pid);
+        /**
+         * \brief Remove a point from the data given its pointer, keeping the classes distribution updated.
+         * Unlike removePoint(int), it doesn't depend on the ids, so it works after removals and insertions.
+         * \param p Pointer to the point to be removed.
+         * \return bool false if the point isn't in the data.
+         */
+        bool removePoint (const std::shared_ptr<Point< T > > &p);
         /**
          * @brief insertFeatures Returns Data object with only features in array.
          * @param ins_feat (???) Array with features that will be in the Data object.
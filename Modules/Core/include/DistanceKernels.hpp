@@ -0,0 +1,203 @@
+/*! Kernels of the most used distance metrics.
+   \file DistanceKernels.hpp
+*/
+
+#ifndef UFJF_MLTK_DISTANCEKERNELS_HPP
+#define UFJF_MLTK_DISTANCEKERNELS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+namespace mltk{
+    namespace metrics{ namespace dist{ namespace kernels{
+        /*
+         * The double and float overloads are compiled in the core library for AVX-512, AVX2 and the baseline
+         * instruction set, the best one supported by the processor is chosen when the library is loaded. They sum
+         * in a fixed number of lanes combined in a fixed order, so the result doesn't depend on the instruction set.
+         * The templates handle the other types in the order of the metric's expression.
+         *
+         * The kernels with a bound stop once the partial sum passes it, returning the partial sum, otherwise they
+         * return the same value as without the bound. The batch kernels compute the distances from a query to n
+         * points stored one after the other, each with dim values.
+         */
+
+        /**
+         * \brief Sum of the squared differences.
+         */
+        template<typename T>
+        T squaredL2(const T *a, const T *b, size_t dim, double bound = std::numeric_limits<double>::infinity()) {
+            T sum = T();
+
+            for (size_t i = 0; i < dim; i++) {
+                T diff = a[i] - b[i];
+                sum += T(diff * diff);
+                if (sum > bound) break;
+            }
+            return sum;
+        }
+
+        /**
+         * \brief Sum of the absolute differences.
+         */
+        template<typename T>
+        T l1(const T *a, const T *b, size_t dim, double bound = std::numeric_limits<double>::infinity()) {
+            T sum = T();
+
+            for (size_t i = 0; i < dim; i++) {
+                sum += T(std::fabs(T(a[i] - b[i])));
+                if (sum > bound) break;
+            }
+            return sum;
+        }
+
+        /**
+         * \brief Cosine distance, one minus the cosine of the angle between the points, 1 when one of them is
+         * zero.
+         */
+        template<typename T>
+        T cosine(const T *a, const T *b, size_t dim) {
+            T dot = T(), norm_a = T(), norm_b = T();
+
+            for (size_t i = 0; i < dim; i++) {
+                dot += T(a[i] * b[i]);
+                norm_a += T(a[i] * a[i]);
+                norm_b += T(b[i] * b[i]);
+            }
+            T den = std::sqrt(norm_a) * std::sqrt(norm_b);
+            return (den > 0) ? 1 - dot / den : T(1);
+        }
+
+        /**
+         * \brief Sum of log(1 - |a_i - b_i|).
+         */
+        template<typename T>
+        T lorentzian(const T *a, const T *b, size_t dim) {
+            T sum = T();
+
+            for (size_t i = 0; i < dim; i++) sum += T(std::log(T(1 - T(std::fabs(T(a[i] - b[i]))))));
+            return sum;
+        }
+
+        /**
+         * \brief Sum of sqrt(a_i*b_i), the Bhattacharyya coefficient.
+         */
+        template<typename T>
+        T bhattacharyya(const T *a, const T *b, size_t dim) {
+            T sum = T();
+
+            for (size_t i = 0; i < dim; i++) sum += T(std::pow(T(a[i] * b[i]), 0.5));
+            return sum;
+        }
+
+        /**
+         * \brief Sum of (a_i - b_i)^2/b_i.
+         */
+        template<typename T>
+        T pearson(const T *a, const T *b, size_t dim) {
+            T sum = T();
+
+            for (size_t i = 0; i < dim; i++) {
+                T diff = a[i] - b[i];
+                sum += T(T(diff * diff) / b[i]);
+            }
+            return sum;
+        }
+
+        /**
+         * \brief Sum of a_i*log(a_i/b_i).
+         */
+        template<typename T>
+        T kullbackLeibler(const T *a, const T *b, size_t dim) {
+            T sum = T();
+
+            for (size_t i = 0; i < dim; i++) sum += T(a[i] * T(std::log(T(a[i] / b[i]))));
+            return sum;
+        }
+
+        /**
+         * \brief Hassanat distance.
+         */
+        template<typename T>
+        T hassanat(const T *a, const T *b, size_t dim, double bound = std::numeric_limits<double>::infinity()) {
+            T sum = 0;
+
+            for (size_t i = 0; i < dim && !(sum > bound); i++) {
+                auto _min = std::min(a[i], b[i]);
+                if (_min >= 0) {
+                    sum += 1 - (1 + _min) / (1 + std::max(a[i], b[i]));
+                } else {
+                    auto _max = std::max(a[i], b[i]);
+                    sum += 1 - (1 + _min + std::abs(_min)) / (1 + _max + std::abs(_max));
+                }
+            }
+            return sum;
+        }
+
+        template<typename T>
+        void squaredL2Batch(const T *q, const T *refs, size_t n, size_t dim, T *out) {
+            for (size_t j = 0; j < n; j++) out[j] = squaredL2(q, refs + j * dim, dim);
+        }
+
+        template<typename T>
+        void l1Batch(const T *q, const T *refs, size_t n, size_t dim, T *out) {
+            for (size_t j = 0; j < n; j++) out[j] = l1(q, refs + j * dim, dim);
+        }
+
+        template<typename T>
+        void cosineBatch(const T *q, const T *refs, size_t n, size_t dim, T *out) {
+            for (size_t j = 0; j < n; j++) out[j] = cosine(q, refs + j * dim, dim);
+        }
+
+        template<typename T>
+        void lorentzianBatch(const T *q, const T *refs, size_t n, size_t dim, T *out) {
+            for (size_t j = 0; j < n; j++) out[j] = lorentzian(q, refs + j * dim, dim);
+        }
+
+        template<typename T>
+        void bhattacharyyaBatch(const T *q, const T *refs, size_t n, size_t dim, T *out) {
+            for (size_t j = 0; j < n; j++) out[j] = bhattacharyya(q, refs + j * dim, dim);
+        }
+
+        template<typename T>
+        void pearsonBatch(const T *q, const T *refs, size_t n, size_t dim, T *out) {
+            for (size_t j = 0; j < n; j++) out[j] = pearson(q, refs + j * dim, dim);
+        }
+
+        template<typename T>
+        void kullbackLeiblerBatch(const T *q, const T *refs, size_t n, size_t dim, T *out) {
+            for (size_t j = 0; j < n; j++) out[j] = kullbackLeibler(q, refs + j * dim, dim);
+        }
+
+        template<typename T>
+        void hassanatBatch(const T *q, const T *refs, size_t n, size_t dim, T *out) {
+            for (size_t j = 0; j < n; j++) out[j] = hassanat(q, refs + j * dim, dim);
+        }
+
+        // vectorized overloads, defined in DistanceKernels.cpp
+#define MLTK_DECLARE_KERNEL(T) \
+        T squaredL2(const T *a, const T *b, size_t dim, double bound = std::numeric_limits<double>::infinity()); \
+        T l1(const T *a, const T *b, size_t dim, double bound = std::numeric_limits<double>::infinity()); \
+        T cosine(const T *a, const T *b, size_t dim); \
+        T lorentzian(const T *a, const T *b, size_t dim); \
+        T bhattacharyya(const T *a, const T *b, size_t dim); \
+        T pearson(const T *a, const T *b, size_t dim); \
+        T kullbackLeibler(const T *a, const T *b, size_t dim); \
+        T hassanat(const T *a, const T *b, size_t dim, double bound = std::numeric_limits<double>::infinity()); \
+        void squaredL2Batch(const T *q, const T *refs, size_t n, size_t dim, T *out); \
+        void l1Batch(const T *q, const T *refs, size_t n, size_t dim, T *out); \
+        void cosineBatch(const T *q, const T *refs, size_t n, size_t dim, T *out); \
+        void lorentzianBatch(const T *q, const T *refs, size_t n, size_t dim, T *out); \
+        void bhattacharyyaBatch(const T *q, const T *refs, size_t n, size_t dim, T *out); \
+        void pearsonBatch(const T *q, const T *refs, size_t n, size_t dim, T *out); \
+        void kullbackLeiblerBatch(const T *q, const T *refs, size_t n, size_t dim, T *out); \
+        void hassanatBatch(const T *q, const T *refs, size_t n, size_t dim, T *out);
+
+        MLTK_DECLARE_KERNEL(double)
+        MLTK_DECLARE_KERNEL(float)
+#undef MLTK_DECLARE_KERNEL
+    }}}
+}
+
+#endif //UFJF_MLTK_DISTANCEKERNELS_HPP
@@ -2,7 +2,12 @@
 #define DISTANCEMETRIC_HPP_INCLUDED
 
 #include "Point.hpp"
+#include "DistanceKernels.hpp"
+#include <algorithm>
 #include <cmath>
+#include <limits>
+#include <type_traits>
+#include <utility>
 
 namespace mltk{
     namespace metrics{ namespace dist{
@@ -20,6 +25,36 @@ namespace mltk{
             std::string& name() { return m_name; }
 
             virtual T operator()(const Point <T> &p1, const Point <T> &p2) const = 0;
+
+            /**
+             * \brief Distance between two points that may stop early once it can't be smaller than a bound, as in
+             * a k nearest neighbors search, where bound is the k-th smallest distance found so far.
+             * \param p1 First point.
+             * \param p2 Second point.
+             * \param bound Distance above which the exact value isn't needed.
+             * \return T the distance when it's smaller than bound, otherwise a value not smaller than bound.
+             * The default computes the whole distance, metrics that accumulate non-negative terms override it.
+             */
+            virtual T operator()(const Point <T> &p1, const Point <T> &p2, double) const {
+                return (*this)(p1, p2);
+            }
+
+            /**
+             * \brief Distances from a query to a block of points, one call for the whole block instead of one per
+             * pair. The metrics with vectorized kernels override it.
+             * \param q Query point.
+             * \param refs Points stored one after the other, each with the dimension of the query.
+             * \param n Number of points.
+             * \param out Distance from the query to each point.
+             */
+            virtual void distances(const Point <T> &q, const T *refs, size_t n, T *out) const {
+                Point<T> ref(q.size());
+
+                for (size_t j = 0; j < n; j++) {
+                    std::copy(refs + j * q.size(), refs + (j + 1) * q.size(), ref.X().begin());
+                    out[j] = (*this)(q, ref);
+                }
+            }
         };
 
         // Lp Minkowski metrics measures
@@ -35,7 +70,19 @@ namespace mltk{
                 this->m_name = "Euclidean";
             }
             T operator()(const Point <T> &p1, const Point <T> &p2) const {
-                return sqrt(mltk::pow(p1 - p2, 2).sum());
+                return sqrt(kernels::squaredL2(p1.X().data(), p2.X().data(), p1.size()));
+            }
+            T operator()(const Point <T> &p1, const Point <T> &p2, double bound) const {
+                double sq_bound = bound * bound;
+                T sum = kernels::squaredL2(p1.X().data(), p2.X().data(), p1.size(), sq_bound);
+
+                // the square root of a partial sum just past bound^2 can round below bound, the whole sum is needed
+                if (sum > sq_bound && T(sqrt(sum)) < bound) return (*this)(p1, p2);
+                return sqrt(sum);
+            }
+            void distances(const Point <T> &q, const T *refs, size_t n, T *out) const {
+                kernels::squaredL2Batch(q.X().data(), refs, n, q.size(), out);
+                for (size_t j = 0; j < n; j++) out[j] = sqrt(out[j]);
             }
         };
 
@@ -47,7 +94,13 @@ namespace mltk{
                 this->m_name = "Manhattan";
             }
             T operator()(const Point <T> &p1, const Point <T> &p2) const {
-                return mltk::abs(p1 - p2).sum();
+                return kernels::l1(p1.X().data(), p2.X().data(), p1.size());
+            }
+            T operator()(const Point <T> &p1, const Point <T> &p2, double bound) const {
+                return kernels::l1(p1.X().data(), p2.X().data(), p1.size(), bound);
+            }
+            void distances(const Point <T> &q, const T *refs, size_t n, T *out) const {
+                kernels::l1Batch(q.X().data(), refs, n, q.size(), out);
             }
         };
 
@@ -61,6 +114,15 @@ namespace mltk{
             T operator()(const Point <T> &p1, const Point <T> &p2) const {
                 return mltk::max(mltk::abs(p1 - p2));
             }
+            T operator()(const Point <T> &p1, const Point <T> &p2, double bound) const {
+                T largest = T();
+
+                for (size_t i = 0; i < p1.size() && !(largest > bound); i++) {
+                    T diff = T(std::fabs(T(p1[i] - p2[i])));
+                    if (diff > largest) largest = diff;
+                }
+                return largest;
+            }
         };
 
         // L1 Distance measures
@@ -73,7 +135,10 @@ namespace mltk{
                 this->m_name = "Lorentzian";
             }
             T operator()(const Point <T> &p1, const Point <T> &p2) const {
-                return mltk::log(1 - mltk::abs(p1 - p2)).sum();
+                return kernels::lorentzian(p1.X().data(), p2.X().data(), p1.size());
+            }
+            void distances(const Point <T> &q, const T *refs, size_t n, T *out) const {
+                kernels::lorentzianBatch(q.X().data(), refs, n, q.size(), out);
             }
         };
 
@@ -83,6 +148,15 @@ namespace mltk{
             T operator()(const Point <T> &p1, const Point <T> &p2) const {
                 return (mltk::abs(p1 - p2) / (mltk::abs(p1) + mltk::abs(p2))).sum();
             }
+            T operator()(const Point <T> &p1, const Point <T> &p2, double bound) const {
+                T sum = T();
+
+                for (size_t i = 0; i < p1.size(); i++) {
+                    sum += T(T(std::fabs(T(p1[i] - p2[i]))) / T(T(std::fabs(p1[i])) + T(std::fabs(p2[i]))));
+                    if (sum > bound) break;
+                }
+                return sum;
+            }
         };
 
         template<typename T>
@@ -132,7 +206,10 @@ namespace mltk{
                 this->m_name = "Cosine";
             }
             T operator()(const Point <T> &p1, const Point <T> &p2) const {
-                return 1 - (p1 * p2).sum() / (std::sqrt(mltk::pow(p1, 2).sum()) * std::sqrt(mltk::pow(p2, 2).sum()));
+                return kernels::cosine(p1.X().data(), p2.X().data(), p1.size());
+            }
+            void distances(const Point <T> &q, const T *refs, size_t n, T *out) const {
+                kernels::cosineBatch(q.X().data(), refs, n, q.size(), out);
             }
         };
 
@@ -170,7 +247,11 @@ namespace mltk{
                 this->m_name = "Bhattacharyya";
             }
             T operator()(const Point <T> &p1, const Point <T> &p2) const {
-                return -std::sqrt(mltk::pow(p1 * p2, 0.5).sum());
+                return -std::sqrt(kernels::bhattacharyya(p1.X().data(), p2.X().data(), p1.size()));
+            }
+            void distances(const Point <T> &q, const T *refs, size_t n, T *out) const {
+                kernels::bhattacharyyaBatch(q.X().data(), refs, n, q.size(), out);
+                for (size_t j = 0; j < n; j++) out[j] = -std::sqrt(out[j]);
             }
         };
 
@@ -220,7 +301,13 @@ namespace mltk{
                 this->m_name = "SquaredEuclidean";
             }
             T operator()(const Point <T> &p1, const Point <T> &p2) const {
-                return mltk::pow(p1 - p2, 2).sum();
+                return kernels::squaredL2(p1.X().data(), p2.X().data(), p1.size());
+            }
+            T operator()(const Point <T> &p1, const Point <T> &p2, double bound) const {
+                return kernels::squaredL2(p1.X().data(), p2.X().data(), p1.size(), bound);
+            }
+            void distances(const Point <T> &q, const T *refs, size_t n, T *out) const {
+                kernels::squaredL2Batch(q.X().data(), refs, n, q.size(), out);
             }
         };
 
@@ -234,6 +321,16 @@ namespace mltk{
             T operator()(const Point <T> &p1, const Point <T> &p2) const {
                 return mltk::pow((p1 - p2)/(mltk::abs(p1) + mltk::abs(p2)), 2).sum();
             }
+            T operator()(const Point <T> &p1, const Point <T> &p2, double bound) const {
+                T sum = T();
+
+                for (size_t i = 0; i < p1.size(); i++) {
+                    T ratio = T(p1[i] - p2[i]) / T(T(std::fabs(p1[i])) + T(std::fabs(p2[i])));
+                    sum += T(ratio * ratio);
+                    if (sum > bound) break;
+                }
+                return sum;
+            }
         };
 
         template<typename T>
@@ -256,7 +353,10 @@ namespace mltk{
                 this->m_name = "Pearson";
             }
             T operator()(const Point <T> &p1, const Point <T> &p2) const {
-                return (mltk::pow(p1 - p2, 2)/p2).sum();
+                return kernels::pearson(p1.X().data(), p2.X().data(), p1.size());
+            }
+            void distances(const Point <T> &q, const T *refs, size_t n, T *out) const {
+                kernels::pearsonBatch(q.X().data(), refs, n, q.size(), out);
             }
         };
 
@@ -350,7 +450,10 @@ namespace mltk{
                 this->m_name = "KullbackLeibler";
             }
             T operator()(const Point <T> &p1, const Point <T> &p2) const {
-                return (p1 * mltk::log(p1/p2)).sum();
+                return kernels::kullbackLeibler(p1.X().data(), p2.X().data(), p1.size());
+            }
+            void distances(const Point <T> &q, const T *refs, size_t n, T *out) const {
+                kernels::kullbackLeiblerBatch(q.X().data(), refs, n, q.size(), out);
             }
         };
 
@@ -486,19 +589,103 @@ namespace mltk{
                 this->m_name = "Hassanat";
             }
             T operator()(const Point <T> &p1, const Point <T> &p2) const {
-                T sum = 0;
-                for(size_t i = 0; i < p1.size(); i++){
-                    auto _min = std::min(p1[i], p2[i]);
-                    if(_min >= 0){
-                        sum += 1 - (1+_min)/(1+std::max(p1[i], p2[i]));
-                    }else{
-                        auto _max = std::max(p1[i], p2[i]);
-                        sum += 1 - (1+_min + std::abs(_min))/(1+_max + std::abs(_max));
-                    }
-                }
-                return sum;
+                return kernels::hassanat(p1.X().data(), p2.X().data(), p1.size());
+            }
+            T operator()(const Point <T> &p1, const Point <T> &p2, double bound) const {
+                return kernels::hassanat(p1.X().data(), p2.X().data(), p1.size(), bound);
+            }
+            void distances(const Point <T> &q, const T *refs, size_t n, T *out) const {
+                kernels::hassanatBatch(q.X().data(), refs, n, q.size(), out);
             }
         };
+
+        /**
+         * \brief Tells if a metric functor satisfies the triangle inequality, the ball tree relies on it to prune.
+         */
+        template<typename Callable>
+        struct IsTrueMetric : std::false_type {};
+
+        template<typename T>
+        struct IsTrueMetric<Euclidean<T> > : std::true_type {};
+
+        template<typename T>
+        struct IsTrueMetric<Manhattan<T> > : std::true_type {};
+
+        template<typename T>
+        struct IsTrueMetric<Chebyshev<T> > : std::true_type {};
+
+        template<typename T>
+        struct IsTrueMetric<Canberra<T> > : std::true_type {};
+
+        template<typename T>
+        struct IsTrueMetric<Hassanat<T> > : std::true_type {};
+
+        /**
+         * \brief Tells if a metric functor has its own bounded operator, that can stop early.
+         */
+        template<typename Callable, typename T, typename = void>
+        struct HasBoundedDistance : std::false_type {};
+
+        template<typename Callable, typename T>
+        struct HasBoundedDistance<Callable, T, decltype(void(std::declval<const Callable &>()(
+                std::declval<const Point<T> &>(), std::declval<const Point<T> &>(), 0.0)))> : std::true_type {};
+
+        template<typename Callable, typename T>
+        auto boundedDistance(const Callable &dist, const Point<T> &p1, const Point<T> &p2, double bound, int)
+        -> decltype(dist(p1, p2, bound)) {
+            return dist(p1, p2, bound);
+        }
+
+        template<typename Callable, typename T>
+        auto boundedDistance(const Callable &dist, const Point<T> &p1, const Point<T> &p2, double, long)
+        -> decltype(dist(p1, p2)) {
+            return dist(p1, p2);
+        }
+
+        /**
+         * \brief Distance between two points that may stop early once it can't be smaller than a bound. Uses the
+         * bounded operator of the metric when it has one, otherwise computes the whole distance, so it works with
+         * any metric functor.
+         * \param dist Metric functor.
+         * \param p1 First point.
+         * \param p2 Second point.
+         * \param bound Distance above which the exact value isn't needed.
+         * \return double the distance when it's smaller than bound, otherwise a value not smaller than bound.
+         */
+        template<typename Callable, typename T>
+        double boundedDistance(const Callable &dist, const Point<T> &p1, const Point<T> &p2, double bound) {
+            return boundedDistance(dist, p1, p2, bound, 0);
+        }
+
+        template<typename Callable, typename T>
+        auto batchDistances(const Callable &dist, const Point<T> &q, const T *refs, size_t n, T *out, int)
+        -> decltype(dist.distances(q, refs, n, out)) {
+            return dist.distances(q, refs, n, out);
+        }
+
+        template<typename Callable, typename T>
+        void batchDistances(const Callable &dist, const Point<T> &q, const T *refs, size_t n, T *out, long) {
+            Point<T> ref(q.size());
+
+            for (size_t j = 0; j < n; j++) {
+                std::copy(refs + j * q.size(), refs + (j + 1) * q.size(), ref.X().begin());
+                out[j] = dist(q, ref);
+            }
+        }
+
+        /**
+         * \brief Distances from a query to a block of points. Uses the distances call of the metric when it has
+         * one, otherwise computes one distance per point, so it works with any metric functor.
+         * \param dist Metric functor.
+         * \param q Query point.
+         * \param refs Points stored one after the other, each with the dimension of the query.
+         * \param n Number of points.
+         * \param out Distance from the query to each point.
+         */
+        template<typename Callable, typename T>
+        void batchDistances(const Callable &dist, const Point<T> &q, const T *refs, size_t n, T *out) {
+            batchDistances(dist, q, refs, n, out, 0);
+        }
     }
     }
 }
@@ -0,0 +1,619 @@
+/*! Hierarchical navigable small world graph for approximate nearest neighbors queries.
+   \file HNSW.hpp
+*/
+
+#ifndef UFJF_MLTK_HNSW_HPP
+#define UFJF_MLTK_HNSW_HPP
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <string>
+#include <type_traits>
+#include "Data.hpp"
+#include "DistanceMetric.hpp"
+
+namespace mltk { namespace metrics {
+    /**
+     * \brief Hierarchical navigable small world (HNSW) graph for approximate k nearest neighbors queries, meant
+     * for high dimensional data where the trees degrade to brute force.
+     *
+     * Each point is linked to its nearest points in a layered graph, the upper layers hold exponentially fewer
+     * points and act as an express way to the region of the query. A query walks greedily down the layers and
+     * runs a best first search with ef candidates on the bottom one. M is the number of links per point (2M on
+     * the bottom layer), efConstruction and efSearch are the sizes of the candidate lists of the build and of
+     * the queries: larger values give better recall and slower queries.
+     * The Euclidean, SquaredEuclidean and Cosine metrics are computed on packed coordinates, the other metrics
+     * use the functor, which doesn't need to satisfy the triangle inequality.
+     * The build inserts the points in parallel, the graph then depends on the order of the insertions and
+     * can change from run to run with more than one thread. Queries are const and can run concurrently.
+     */
+    template<typename T, typename Callable = dist::Euclidean<T> >
+    class HNSW {
+    public:
+        /// Neighbor found by a query, as (distance, index of the point in the data).
+        using Neighbor = std::pair<double, size_t>;
+
+    private:
+        enum Form { L2, SQUARED_L2, COSINE, GENERIC };
+
+        static constexpr Form form =
+                std::is_same<Callable, dist::Euclidean<T> >::value ? L2 :
+                std::is_same<Callable, dist::SquaredEuclidean<T> >::value ? SQUARED_L2 :
+                std::is_same<Callable, dist::Cosine<T> >::value ? COSINE : GENERIC;
+
+        /**
+         * \brief Point being searched: its packed coordinates and norm, or the point itself for the functor.
+         */
+        struct Query {
+            const double *x;
+            double norm;
+            const Point<T> *p;
+        };
+
+        /**
+         * \brief Buffers reused by the searches of a thread.
+         */
+        struct Scratch {
+            /// Search tag of the last visit to each point.
+            std::vector<unsigned> visited;
+            unsigned tag = 0;
+            /// Packed coordinates of the query and copy of the links read during the build.
+            std::vector<double> query;
+            std::vector<size_t> adjacency;
+            /// Candidates (min-heap) and best points found (max-heap) of a search.
+            std::vector<Neighbor> candidates, top;
+        };
+
+        static Scratch &scratch() {
+            static thread_local Scratch _scratch;
+            return _scratch;
+        }
+
+        size_t M = 16, ef_construction = 200, ef_search = 50, dim = 0, entry = 0;
+        int max_level = -1;
+        unsigned seed = 42;
+        Callable dist_function;
+        /// Coordinates packed in the order of the data and their norms, for the Euclidean and Cosine forms.
+        std::vector<double> coords, norms;
+        /// Points for the metric functor.
+        std::vector<PointPointer<T> > points;
+        /// Links of each point, one list per layer.
+        std::vector<std::vector<std::vector<size_t> > > links;
+        /**
+         * \brief Locks of the links of each point and of the entry point, used by the build. Copies of the
+         * graph get their own locks.
+         */
+        struct Locks {
+            std::vector<std::mutex> nodes;
+            std::mutex entry;
+
+            Locks() = default;
+
+            Locks(const Locks &) {}
+
+            Locks &operator=(const Locks &) { return *this; }
+        };
+        mutable Locks locks;
+
+        /**
+         * \brief Distance in reduced form: squared for the Euclidean metric, the metric itself otherwise.
+         */
+        double distance(const Query &q, size_t j) const {
+            if (form == GENERIC) return this->dist_function(*q.p, *points[j]);
+
+            const double *x = coords.data() + j * dim;
+            double sum = 0.0;
+            if (form == COSINE) {
+                #pragma omp simd reduction(+:sum)
+                for (size_t d = 0; d < dim; ++d) sum += q.x[d] * x[d];
+                double den = std::sqrt(q.norm) * std::sqrt(norms[j]);
+                return (den > 0) ? 1 - sum / den : 1.0;
+            }
+            #pragma omp simd reduction(+:sum)
+            for (size_t d = 0; d < dim; ++d) {
+                double diff = q.x[d] - x[d];
+                sum += diff * diff;
+            }
+            return sum;
+        }
+
+        static double finish(double reduced) {
+            double d = (form == L2) ? std::sqrt(std::max(0.0, reduced)) : reduced;
+            // same precision as the metric functor
+            return double(static_cast<T>(d));
+        }
+
+        Query node(size_t j) const {
+            if (form == GENERIC) return Query{nullptr, 0.0, points[j].get()};
+            return Query{coords.data() + j * dim, norms[j], nullptr};
+        }
+
+        size_t maxLinks(int level) const { return (level == 0) ? 2 * M : M; }
+
+        /**
+         * \brief Move to the nearest neighbor while it's closer to the query, on one layer.
+         */
+        void greedy(const Query &q, int level, size_t &current, double &d, bool locked) const {
+            Scratch &_scratch = scratch();
+            bool changed = true;
+
+            while (changed) {
+                changed = false;
+                const std::vector<size_t> &adjacency = this->adjacency(current, level, locked, _scratch);
+                for (size_t e: adjacency) {
+                    double de = distance(q, e);
+                    if (de < d) {
+                        d = de;
+                        current = e;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        /**
+         * \brief Links of a point on a layer, copied under its lock while the graph is being built.
+         */
+        const std::vector<size_t> &adjacency(size_t j, int level, bool locked, Scratch &_scratch) const {
+            if (!locked) return links[j][level];
+            std::lock_guard<std::mutex> guard(locks.nodes[j]);
+            _scratch.adjacency = links[j][level];
+            return _scratch.adjacency;
+        }
+
+        /**
+         * \brief Best first search on one layer, leaves the ef nearest points found in the max-heap top.
+         */
+        void searchLayer(const Query &q, const Neighbor &start, size_t ef, int level, bool locked) const {
+            Scratch &_scratch = scratch();
+            auto &candidates = _scratch.candidates;
+            auto &top = _scratch.top;
+            size_t n = links.size();
+
+            if (_scratch.visited.size() < n) _scratch.visited.resize(n, 0);
+            if (++_scratch.tag == 0) {
+                std::fill(_scratch.visited.begin(), _scratch.visited.end(), 0);
+                _scratch.tag = 1;
+            }
+            candidates.assign(1, start);
+            top.assign(1, start);
+            _scratch.visited[start.second] = _scratch.tag;
+            while (!candidates.empty()) {
+                std::pop_heap(candidates.begin(), candidates.end(), std::greater<Neighbor>());
+                Neighbor c = candidates.back();
+                candidates.pop_back();
+                if (top.size() >= ef && c.first > top.front().first) break;
+
+                const std::vector<size_t> &adjacency = this->adjacency(c.second, level, locked, _scratch);
+                for (size_t e: adjacency) {
+                    if (_scratch.visited[e] == _scratch.tag) continue;
+                    _scratch.visited[e] = _scratch.tag;
+
+                    double d = distance(q, e);
+                    if (top.size() < ef || d < top.front().first) {
+                        candidates.emplace_back(d, e);
+                        std::push_heap(candidates.begin(), candidates.end(), std::greater<Neighbor>());
+                        top.emplace_back(d, e);
+                        std::push_heap(top.begin(), top.end());
+                        if (top.size() > ef) {
+                            std::pop_heap(top.begin(), top.end());
+                            top.pop_back();
+                        }
+                    }
+                }
+            }
+        }
+
+        /**
+         * \brief Keep up to max_links candidates, sorted by distance, that are closer to the base point than to
+         * the ones already kept, so the links spread in different directions.
+         */
+        void selectNeighbors(std::vector<Neighbor> &sorted, size_t max_links) const {
+            std::vector<Neighbor> selected;
+
+            selected.reserve(max_links);
+            for (auto const &c: sorted) {
+                bool keep = true;
+                Query qc = node(c.second);
+                for (auto const &s: selected) {
+                    if (distance(qc, s.second) < c.first) {
+                        keep = false;
+                        break;
+                    }
+                }
+                if (keep) {
+                    selected.push_back(c);
+                    if (selected.size() == max_links) break;
+                }
+            }
+            sorted.swap(selected);
+        }
+
+        void insert(size_t i, int level) {
+            Scratch &_scratch = scratch();
+            Query q = node(i);
+            size_t current;
+            int top_level;
+
+            {
+                std::lock_guard<std::mutex> guard(locks.entry);
+                current = entry;
+                top_level = max_level;
+            }
+            double d = distance(q, current);
+            for (int l = top_level; l > level; --l) greedy(q, l, current, d, true);
+
+            for (int l = std::min(level, top_level); l >= 0; --l) {
+                searchLayer(q, Neighbor(d, current), ef_construction, l, true);
+
+                std::vector<Neighbor> selected(_scratch.top.begin(), _scratch.top.end());
+                std::sort(selected.begin(), selected.end());
+                current = selected.front().second;
+                d = selected.front().first;
+                selectNeighbors(selected, M);
+                {
+                    std::lock_guard<std::mutex> guard(locks.nodes[i]);
+                    links[i][l].clear();
+                    for (auto const &s: selected) links[i][l].push_back(s.second);
+                }
+                for (auto const &s: selected) connect(s.second, i, s.first, l);
+            }
+            if (level > top_level) {
+                std::lock_guard<std::mutex> guard(locks.entry);
+                if (level > max_level) {
+                    max_level = level;
+                    entry = i;
+                }
+            }
+        }
+
+        /**
+         * \brief Link e to i, pruning the links of e when they're over the limit of the layer.
+         */
+        void connect(size_t e, size_t i, double d, int level) {
+            std::lock_guard<std::mutex> guard(locks.nodes[e]);
+            auto &adjacency = links[e][level];
+            size_t max_links = maxLinks(level);
+
+            if (adjacency.size() < max_links) {
+                adjacency.push_back(i);
+                return;
+            }
+            std::vector<Neighbor> candidates(1, Neighbor(d, i));
+            Query qe = node(e);
+            for (size_t j: adjacency) candidates.emplace_back(distance(qe, j), j);
+            std::sort(candidates.begin(), candidates.end());
+            selectNeighbors(candidates, max_links);
+            adjacency.clear();
+            for (auto const &c: candidates) adjacency.push_back(c.second);
+        }
+
+    public:
+        HNSW() = default;
+
+        explicit HNSW(Callable dist_func): dist_function(dist_func) {}
+
+        /**
+         * \brief Build the graph with the points of a dataset.
+         * \param data Dataset.
+         * \param _M Number of links per point.
+         * \param _ef_construction Size of the candidates list of the build.
+         * \param dist_func Metric functor.
+         */
+        explicit HNSW(const Data<T> &data, size_t _M = 16, size_t _ef_construction = 200,
+                      Callable dist_func = Callable()): dist_function(dist_func) {
+            setM(_M);
+            setEfConstruction(_ef_construction);
+            build(data);
+        }
+
+        /**
+         * \brief Build the graph with the points of a dataset, replacing the current graph.
+         * \param data Dataset.
+         * \return bool
+         */
+        bool build(const Data<T> &data) {
+            size_t n = data.getSize();
+            std::mt19937 generator(seed);
+            std::uniform_real_distribution<double> uniform(0.0, 1.0);
+            double level_mult = 1.0 / std::log(double(std::max<size_t>(2, M)));
+            std::vector<int> levels(n);
+
+            clear();
+            if (n == 0) return true;
+            dim = data.getDim();
+            if (form == GENERIC) {
+                points.resize(n);
+                for (size_t j = 0; j < n; ++j) points[j] = data[j];
+            } else {
+                coords.resize(n * dim);
+                norms.assign(n, 0.0);
+                for (size_t j = 0; j < n; ++j) {
+                    auto const &x = data[j]->X();
+                    double *c = coords.data() + j * dim;
+                    for (size_t d = 0; d < dim; ++d) {
+                        c[d] = x[d];
+                        norms[j] += c[d] * c[d];
+                    }
+                }
+            }
+            // the layer of each point is drawn up front, so it doesn't depend on the insertion order
+            links.resize(n);
+            for (size_t j = 0; j < n; ++j) {
+                levels[j] = int(-std::log(std::max(uniform(generator), 1e-12)) * level_mult);
+                links[j].resize(levels[j] + 1);
+            }
+            locks.nodes = std::vector<std::mutex>(n);
+            entry = 0;
+            max_level = levels[0];
+
+            #pragma omp parallel for schedule(dynamic, 16)
+            for (long j = 1; j < (long) n; ++j) insert(j, levels[j]);
+            return true;
+        }
+
+        /**
+         * \brief Find approximately the k nearest neighbors of a point.
+         * \param q Query point.
+         * \param k Number of neighbors.
+         * \param heap Max-heap filled with the neighbors, as (distance, index of the point in the data), empty
+         * if the point doesn't have the dimension of the graph.
+         */
+        void kNearest(const Point<T> &q, size_t k, std::vector<Neighbor> &heap) const {
+            Scratch &_scratch = scratch();
+            Query query{nullptr, 0.0, &q};
+
+            heap.clear();
+            if (links.empty() || k == 0) return;
+            if (q.size() != dim) {
+                std::cerr << "The point must have the same dimension of the graph!" << std::endl;
+                return;
+            }
+            if (form != GENERIC) {
+                _scratch.query.assign(q.X().begin(), q.X().end());
+                query.x = _scratch.query.data();
+                for (auto const &x: _scratch.query) query.norm += x * x;
+            }
+
+            size_t current = entry;
+            double d = distance(query, current);
+            for (int l = max_level; l > 0; --l) greedy(query, l, current, d, false);
+            searchLayer(query, Neighbor(d, current), std::max(ef_search, k), 0, false);
+
+            auto &top = _scratch.top;
+            while (top.size() > k) {
+                std::pop_heap(top.begin(), top.end());
+                top.pop_back();
+            }
+            for (auto const &neighbor: top) heap.emplace_back(finish(neighbor.first), neighbor.second);
+        }
+
+        /**
+         * \brief Find approximately the k nearest neighbors of a point.
+         * \param q Query point.
+         * \param k Number of neighbors.
+         * \return std::vector<Neighbor> with the neighbors sorted by distance.
+         */
+        std::vector<Neighbor> kNearestNeighbors(const Point<T> &q, size_t k) const {
+            std::vector<Neighbor> heap;
+
+            kNearest(q, k, heap);
+            std::sort_heap(heap.begin(), heap.end());
+            return heap;
+        }
+
+        /**
+         * \brief Save the graph in a binary file. The points are saved with it, so the metric functor must be
+         * the same when the file is loaded.
+         * \param path Path to the file.
+         * \return bool
+         */
+        bool save(const std::string &path) const {
+            uint64_t header[7] = {links.size(), dim, M, ef_construction, ef_search, entry,
+                                  uint64_t(int64_t(max_level))};
+            uint64_t _form = form;
+            std::ofstream output(path, std::ios::binary | std::ios::trunc);
+            std::vector<double> x;
+            std::vector<uint64_t> ids;
+
+            if (!output) {
+                std::cerr << "Could not open " << path << " for writing." << std::endl;
+                return false;
+            }
+            output.write("MLTKHNS1", 8);
+            output.write(reinterpret_cast<const char *>(header), sizeof(header));
+            output.write(reinterpret_cast<const char *>(&_form), sizeof(uint64_t));
+            for (size_t j = 0; j < links.size(); ++j) {
+                uint64_t levels = links[j].size();
+
+                if (form == GENERIC) x.assign(points[j]->X().begin(), points[j]->X().end());
+                else x.assign(coords.begin() + j * dim, coords.begin() + (j + 1) * dim);
+                output.write(reinterpret_cast<const char *>(x.data()), dim * sizeof(double));
+                output.write(reinterpret_cast<const char *>(&levels), sizeof(uint64_t));
+                for (auto const &adjacency: links[j]) {
+                    uint64_t size = adjacency.size();
+                    ids.assign(adjacency.begin(), adjacency.end());
+                    output.write(reinterpret_cast<const char *>(&size), sizeof(uint64_t));
+                    output.write(reinterpret_cast<const char *>(ids.data()), size * sizeof(uint64_t));
+                }
+            }
+            return bool(output);
+        }
+
+        /**
+         * \brief Load a graph saved in a binary file, replacing the current graph. The file is checked before
+         * anything is replaced: the sizes must fit in the file, the entry point and every link must be a point of
+         * the graph on a layer it belongs to.
+         * \param path Path to the file.
+         * \return bool false, keeping the current graph, if the file can't be read or is invalid.
+         */
+        bool load(const std::string &path) {
+            uint64_t header[7], _form, n, _dim, remaining;
+            int64_t top_level;
+            char magic[8];
+            std::ifstream input(path, std::ios::binary | std::ios::ate);
+            std::vector<double> x, _coords, _norms;
+            std::vector<PointPointer<T> > _points;
+            std::vector<std::vector<std::vector<size_t> > > _links;
+            std::vector<uint64_t> ids;
+
+            if (!input) {
+                std::cerr << "Could not open " << path << " for reading." << std::endl;
+                return false;
+            }
+            remaining = uint64_t(input.tellg());
+            input.seekg(0);
+            if (!input.read(magic, 8) || std::memcmp(magic, "MLTKHNS1", 8) != 0 ||
+                !input.read(reinterpret_cast<char *>(header), sizeof(header)) ||
+                !input.read(reinterpret_cast<char *>(&_form), sizeof(uint64_t))) {
+                std::cerr << path << " is not a HNSW graph file." << std::endl;
+                return false;
+            }
+            if (_form != uint64_t(form)) {
+                std::cerr << "The graph in " << path << " was built with another metric." << std::endl;
+                return false;
+            }
+            remaining -= 8 + sizeof(header) + sizeof(uint64_t);
+            n = header[0];
+            _dim = header[1];
+            top_level = int64_t(header[6]);
+            // each point takes at least its coordinates and the number of its layers
+            if (_dim > remaining / sizeof(double) || n > remaining / ((_dim + 1) * sizeof(double)) ||
+                header[2] < 2 || header[3] < 1 || header[4] < 1 ||
+                (n == 0 && top_level != -1) || (n > 0 && (top_level < 0 || header[5] >= n || top_level >= 64))) {
+                std::cerr << path << " has an invalid header." << std::endl;
+                return false;
+            }
+            _links.resize(n);
+            x.resize(_dim);
+            if (form == GENERIC) _points.resize(n);
+            else {
+                _coords.resize(n * _dim);
+                _norms.assign(n, 0.0);
+            }
+            for (size_t j = 0; j < n; ++j) {
+                uint64_t levels = 0;
+
+                if (!input.read(reinterpret_cast<char *>(x.data()), _dim * sizeof(double)) ||
+                    !input.read(reinterpret_cast<char *>(&levels), sizeof(uint64_t))) {
+                    std::cerr << path << " is truncated." << std::endl;
+                    return false;
+                }
+                if (levels < 1 || levels > uint64_t(top_level) + 1) {
+                    std::cerr << path << " has a point with an invalid number of layers." << std::endl;
+                    return false;
+                }
+                if (form == GENERIC) {
+                    _points[j] = mltk::make_point<T>(_dim);
+                    for (size_t d = 0; d < _dim; ++d) (*_points[j])[d] = static_cast<T>(x[d]);
+                } else {
+                    std::copy(x.begin(), x.end(), _coords.begin() + j * _dim);
+                    for (auto const &xd: x) _norms[j] += xd * xd;
+                }
+                _links[j].resize(levels);
+                for (auto &adjacency: _links[j]) {
+                    uint64_t size = 0;
+
+                    if (!input.read(reinterpret_cast<char *>(&size), sizeof(uint64_t)) || size > n) {
+                        std::cerr << path << " is truncated or has an invalid list of links." << std::endl;
+                        return false;
+                    }
+                    ids.resize(size);
+                    if (!input.read(reinterpret_cast<char *>(ids.data()), size * sizeof(uint64_t))) {
+                        std::cerr << path << " is truncated." << std::endl;
+                        return false;
+                    }
+                    adjacency.assign(ids.begin(), ids.end());
+                }
+            }
+            if (n > 0 && _links[header[5]].size() != uint64_t(top_level) + 1) {
+                std::cerr << "The entry point of " << path << " is not on the top layer." << std::endl;
+                return false;
+            }
+            for (size_t j = 0; j < n; ++j) {
+                for (size_t l = 0; l < _links[j].size(); ++l) {
+                    for (size_t e: _links[j][l]) {
+                        if (e >= n || _links[e].size() <= l) {
+                            std::cerr << path << " has a link to a point that is not on its layer." << std::endl;
+                            return false;
+                        }
+                    }
+                }
+            }
+
+            clear();
+            dim = _dim;
+            M = header[2];
+            ef_construction = header[3];
+            ef_search = header[4];
+            entry = header[5];
+            max_level = int(top_level);
+            coords.swap(_coords);
+            norms.swap(_norms);
+            points.swap(_points);
+            links.swap(_links);
+            return true;
+        }
+
+        void clear() {
+            coords.clear();
+            norms.clear();
+            points.clear();
+            links.clear();
+            locks.nodes = std::vector<std::mutex>();
+            max_level = -1;
+            entry = 0;
+        }
+
+        /**
+         * \brief Set the number of links per point, used by the next build.
+         * \param _M Number of links, 16 is the default.
+         */
+        void setM(size_t _M) { this->M = std::max<size_t>(2, _M); }
+
+        /**
+         * \brief Set the size of the candidates list of the build.
+         * \param _ef_construction Size of the list, 200 is the default.
+         */
+        void setEfConstruction(size_t _ef_construction) {
+            this->ef_construction = std::max<size_t>(1, _ef_construction);
+        }
+
+        /**
+         * \brief Set the size of the candidates list of the queries, at least k is used.
+         * \param _ef_search Size of the list, 50 is the default.
+         */
+        void setEfSearch(size_t _ef_search) { this->ef_search = std::max<size_t>(1, _ef_search); }
+
+        /**
+         * \brief Set the seed of the layers drawn for the points.
+         * \param _seed Seed.
+         */
+        void setSeed(unsigned _seed) { this->seed = _seed; }
+
+        size_t getM() const { return M; }
+
+        size_t getEfConstruction() const { return ef_construction; }
+
+        size_t getEfSearch() const { return ef_search; }
+
+        Callable &metric() { return dist_function; }
+
+        /**
+         * \brief Returns the number of points in the graph.
+         * \return size_t
+         */
+        size_t size() const { return links.size(); }
+    };
+}}
+
+#endif //UFJF_MLTK_HNSW_HPP
@@ -0,0 +1,274 @@
+/*! KD-tree for nearest neighbors queries.
+   \file KDTree.hpp
+*/
+
+#ifndef UFJF_MLTK_KDTREE_HPP
+#define UFJF_MLTK_KDTREE_HPP
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+#include "Data.hpp"
+#include "DistanceMetric.hpp"
+
+namespace mltk { namespace metrics {
+    /**
+     * \brief KD-tree for k nearest neighbors queries with the Euclidean, SquaredEuclidean, Manhattan and
+     * Chebyshev metrics.
+     *
+     * The tree is built at once from a dataset: each node splits its points at the median of the dimension with
+     * the widest spread, until at most leaf_size points are left. The points are packed in tree order, so a leaf
+     * is a contiguous block, and each node keeps the bounding box of its points to prune the queries.
+     * Queries are const and can run concurrently.
+     */
+    template<typename T, typename Callable = dist::Euclidean<T> >
+    class KDTree {
+    public:
+        /// Neighbor found by a query, as (distance, index of the point in the data).
+        using Neighbor = std::pair<double, size_t>;
+
+    private:
+        enum Norm { L1, L2, SQUARED_L2, LINF, UNSUPPORTED };
+
+        static constexpr Norm norm =
+                std::is_same<Callable, dist::Euclidean<T> >::value ? L2 :
+                std::is_same<Callable, dist::SquaredEuclidean<T> >::value ? SQUARED_L2 :
+                std::is_same<Callable, dist::Manhattan<T> >::value ? L1 :
+                std::is_same<Callable, dist::Chebyshev<T> >::value ? LINF : UNSUPPORTED;
+
+        struct Node {
+            /// Range of the node's points in tree order.
+            size_t begin, end;
+            /// Children, only for inner nodes.
+            size_t left = 0, right = 0;
+            /// Splitting dimension, -1 for leaves.
+            int split_dim = -1;
+        };
+
+        size_t dim = 0, leaf_size = 40;
+        /// Points packed in tree order.
+        std::vector<double> coords;
+        /// Index in the data of each packed point.
+        std::vector<size_t> index;
+        /// Bounding box of each node, dim values per node.
+        std::vector<double> lower, upper;
+        std::vector<Node> nodes;
+
+        /**
+         * \brief Accumulate the contribution of one coordinate to the distance in reduced form, without the
+         * final square root of the Euclidean metric.
+         */
+        static inline double accumulate(double acc, double diff) {
+            diff = std::fabs(diff);
+            if (norm == LINF) return std::max(acc, diff);
+            if (norm == L1) return acc + diff;
+            return acc + diff * diff;
+        }
+
+        static inline double finish(double reduced) {
+            double d = (norm == L2) ? std::sqrt(reduced) : reduced;
+            // same precision as the metric functor
+            return double(static_cast<T>(d));
+        }
+
+        size_t build(std::vector<size_t> &order, const std::vector<double> &points, size_t begin, size_t end) {
+            size_t id = nodes.size(), j, d;
+            Node node;
+
+            node.begin = begin;
+            node.end = end;
+            lower.resize((id + 1) * dim);
+            upper.resize((id + 1) * dim);
+            for (d = 0; d < dim; ++d) {
+                lower[id * dim + d] = std::numeric_limits<double>::infinity();
+                upper[id * dim + d] = -std::numeric_limits<double>::infinity();
+            }
+            for (j = begin; j < end; ++j) {
+                const double *x = points.data() + order[j] * dim;
+                for (d = 0; d < dim; ++d) {
+                    lower[id * dim + d] = std::min(lower[id * dim + d], x[d]);
+                    upper[id * dim + d] = std::max(upper[id * dim + d], x[d]);
+                }
+            }
+            nodes.push_back(node);
+            if (end - begin <= leaf_size) return id;
+
+            int split_dim = 0;
+            double spread = -1;
+            for (d = 0; d < dim; ++d) {
+                double s = upper[id * dim + d] - lower[id * dim + d];
+                if (s > spread) {
+                    spread = s;
+                    split_dim = int(d);
+                }
+            }
+            // all the points are equal, nothing to split
+            if (spread <= 0) return id;
+
+            size_t mid = begin + (end - begin) / 2;
+            std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                             [&points, split_dim, this](size_t a, size_t b) {
+                                 return points[a * dim + split_dim] < points[b * dim + split_dim];
+                             });
+            size_t left = build(order, points, begin, mid);
+            size_t right = build(order, points, mid, end);
+            nodes[id].left = left;
+            nodes[id].right = right;
+            nodes[id].split_dim = split_dim;
+            return id;
+        }
+
+        /**
+         * \brief Reduced distance from the query to the bounding box of a node.
+         */
+        double boxDistance(const Point<T> &q, size_t id) const {
+            const double *lo = lower.data() + id * dim, *hi = upper.data() + id * dim;
+            double acc = 0.0;
+
+            for (size_t d = 0; d < dim; ++d) {
+                double x = q[d];
+                if (x < lo[d]) acc = accumulate(acc, lo[d] - x);
+                else if (x > hi[d]) acc = accumulate(acc, x - hi[d]);
+            }
+            return acc;
+        }
+
+        void search(const Point<T> &q, size_t id, double box, size_t k, std::vector<Neighbor> &heap) const {
+            const Node &node = nodes[id];
+
+            if (heap.size() == k && box >= heap.front().first) return;
+            if (node.split_dim < 0) {
+                for (size_t j = node.begin; j < node.end; ++j) {
+                    const double *x = coords.data() + j * dim;
+                    double acc = 0.0, bound = (heap.size() < k) ? std::numeric_limits<double>::infinity() :
+                                              heap.front().first;
+
+                    // the reduced distance only grows, so the point is dropped once it passes the k-th smallest
+                    for (size_t d = 0; d < dim && !(acc > bound); ++d) acc = accumulate(acc, double(q[d]) - x[d]);
+                    if (heap.size() < k) {
+                        heap.emplace_back(acc, j);
+                        std::push_heap(heap.begin(), heap.end());
+                    } else if (acc < heap.front().first) {
+                        std::pop_heap(heap.begin(), heap.end());
+                        heap.back() = Neighbor(acc, j);
+                        std::push_heap(heap.begin(), heap.end());
+                    }
+                }
+                return;
+            }
+            double box_left = boxDistance(q, node.left), box_right = boxDistance(q, node.right);
+            if (box_left <= box_right) {
+                search(q, node.left, box_left, k, heap);
+                search(q, node.right, box_right, k, heap);
+            } else {
+                search(q, node.right, box_right, k, heap);
+                search(q, node.left, box_left, k, heap);
+            }
+        }
+
+    public:
+        KDTree() = default;
+
+        /**
+         * \brief Build the tree with the points of a dataset.
+         * \param data Dataset.
+         * \param _leaf_size Maximum number of points in a leaf.
+         */
+        explicit KDTree(const Data<T> &data, size_t _leaf_size = 40): leaf_size(_leaf_size) { build(data); }
+
+        /**
+         * \brief Build the tree with the points of a dataset, replacing the current points.
+         * \param data Dataset.
+         * \return bool false if the metric isn't supported by the KD-tree.
+         */
+        bool build(const Data<T> &data) {
+            size_t n = data.getSize(), j;
+            std::vector<double> points;
+            std::vector<size_t> order(n);
+
+            clear();
+            if (norm == UNSUPPORTED) {
+                std::cerr << "The KD-tree only supports the Euclidean, SquaredEuclidean, Manhattan and Chebyshev "
+                             "metrics." << std::endl;
+                return false;
+            }
+            dim = data.getDim();
+            points.resize(n * dim);
+            for (j = 0; j < n; ++j) std::copy(data[j]->X().begin(), data[j]->X().end(), points.begin() + j * dim);
+            std::iota(order.begin(), order.end(), 0);
+            if (n > 0) build(order, points, 0, n);
+
+            coords.resize(n * dim);
+            index = order;
+            for (j = 0; j < n; ++j)
+                std::copy(points.begin() + order[j] * dim, points.begin() + (order[j] + 1) * dim,
+                          coords.begin() + j * dim);
+            return true;
+        }
+
+        /**
+         * \brief Find the k nearest neighbors of a point.
+         * \param q Query point.
+         * \param k Number of neighbors.
+         * \param heap Max-heap filled with the neighbors, as (distance, index of the point in the data). The
+         * buffer is reused, so a caller that keeps it doesn't allocate.
+         */
+        void kNearest(const Point<T> &q, size_t k, std::vector<Neighbor> &heap) const {
+            heap.clear();
+            if (nodes.empty() || k == 0) return;
+            search(q, 0, boxDistance(q, 0), k, heap);
+            for (auto &neighbor: heap) {
+                neighbor.first = finish(neighbor.first);
+                neighbor.second = index[neighbor.second];
+            }
+        }
+
+        /**
+         * \brief Find the k nearest neighbors of a point.
+         * \param q Query point.
+         * \param k Number of neighbors.
+         * \return std::vector<Neighbor> with the neighbors sorted by distance.
+         */
+        std::vector<Neighbor> kNearestNeighbors(const Point<T> &q, size_t k) const {
+            std::vector<Neighbor> heap;
+
+            kNearest(q, k, heap);
+            std::sort_heap(heap.begin(), heap.end());
+            return heap;
+        }
+
+        /**
+         * \brief Tells if the metric is supported by the KD-tree.
+         * \return bool
+         */
+        static constexpr bool supportsMetric() { return norm != UNSUPPORTED; }
+
+        void clear() {
+            coords.clear();
+            index.clear();
+            lower.clear();
+            upper.clear();
+            nodes.clear();
+        }
+
+        /**
+         * \brief Set the maximum number of points in a leaf, used by the next build.
+         * \param _leaf_size Leaf size.
+         */
+        void setLeafSize(size_t _leaf_size) { this->leaf_size = std::max<size_t>(1, _leaf_size); }
+
+        size_t getLeafSize() const { return leaf_size; }
+
+        /**
+         * \brief Returns the number of points in the tree.
+         * \return size_t
+         */
+        size_t size() const { return index.size(); }
+    };
+}}
+
+#endif //UFJF_MLTK_KDTREE_HPP
@@ -12,11 +12,108 @@
 #include <utility>
 
 #include "Data.hpp"
+#include "KernelCache.hpp"
 #include "Utils.hpp"
 
 namespace mltk{
     enum KernelType {INVALID_TYPE = -1, INNER_PRODUCT, POLYNOMIAL, GAUSSIAN};
 
+    /**
+     * \brief Compile-time kernel policies.
+     *
+     * A kernel policy is any copyable class providing the members below, where a and b point to the features of
+     * two points with the given dimension:
+     *
+     *     template < typename T > double function(const T *a, const T *b, size_t dim) const;
+     *     template < typename T > double functionWithoutDim(const T *a, const T *b, size_t j, size_t dim) const;
+     *
+     * Kernel::compute and DualClassifier::setKernelPolicy are instantiated with the policy, so the whole kernel
+     * evaluation is inlined in the matrix loops. User-defined kernels only need to follow the same interface.
+     */
+    namespace kernels {
+        /**
+         * \brief Inner product kernel, k(a, b) = <a, b>.
+         */
+        struct Linear {
+            double param = 0;
+
+            explicit Linear(double param = 0): param(param) {}
+
+            template < typename T >
+            inline double function(const T *a, const T *b, size_t dim) const {
+                double sum = 0.0;
+
+                for(size_t i = 0; i < dim; ++i)
+                    sum += a[i] * b[i];
+                return sum;
+            }
+
+            template < typename T >
+            inline double functionWithoutDim(const T *a, const T *b, size_t j, size_t dim) const {
+                double sum = 0.0;
+
+                for(size_t i = 0; i < j; ++i)
+                    sum += a[i] * b[i];
+                for(size_t i = j + 1; i < dim; ++i)
+                    sum += a[i] * b[i];
+                return sum;
+            }
+        };
+
+        /**
+         * \brief Polynomial kernel, k(a, b) = <a, b>^param.
+         */
+        struct Polynomial {
+            double param = 1;
+
+            explicit Polynomial(double param = 1): param(param) {}
+
+            template < typename T >
+            inline double function(const T *a, const T *b, size_t dim) const {
+                double sum = Linear().function(a, b, dim);
+
+                //    sum = (param > 1) ? std::pow(sum+1, param) : sum;
+                return (param > 1) ? std::pow(sum, param) : sum;
+            }
+
+            template < typename T >
+            inline double functionWithoutDim(const T *a, const T *b, size_t j, size_t dim) const {
+                double sum = Linear().functionWithoutDim(a, b, j, dim);
+
+                return (param > 1) ? std::pow(sum+1, param) : sum;
+            }
+        };
+
+        /**
+         * \brief Gaussian kernel, k(a, b) = exp(-param*||a - b||^2).
+         */
+        struct Gaussian {
+            double param = 1;
+
+            explicit Gaussian(double param = 1): param(param) {}
+
+            template < typename T >
+            inline double function(const T *a, const T *b, size_t dim) const {
+                double t, sum = 0.0;
+
+                for(size_t i = 0; i < dim; ++i)
+                { t = a[i] - b[i]; sum += t * t; }
+                return std::exp(-1 * sum * param);
+            }
+
+            template < typename T >
+            inline double functionWithoutDim(const T *a, const T *b, size_t j, size_t dim) const {
+                double t, sum = 0.0;
+
+                for(size_t i = 0; i < j; ++i)
+                { t = a[i] - b[i]; sum += t * t; }
+                for(size_t i = j + 1; i < dim; ++i)
+                { t = a[i] - b[i]; sum += t * t; }
+                return std::exp(-1 * sum * param);
+            }
+        };
+    }
+
     /**
      * \brief Class for the kernel computations.
      */
@@ -34,16 +131,42 @@ namespace mltk{
         mltk::dMatrix H;
         /// H matrix without a dimension.
         mltk::dMatrix HwithoutDim;
+        /// Disk cache used to load and store the kernel matrix.
+        std::shared_ptr<KernelCache> cache;
+        /// Disk cache used by the kernels without a cache of their own.
+        static std::shared_ptr<KernelCache> default_cache;
+        /// Kernel matrix mapped from the disk cache, used instead of K while set.
+        std::shared_ptr<const KernelCache::Mapping> mapping;
+        /// Data the kernel matrix was computed from.
+        std::weak_ptr<const void> computed_data;
+        /// Data whose fingerprint is stored in data_key.
+        std::weak_ptr<const void> fingerprinted;
+        /// Fingerprint of the data, reused by every kernel type and parameter computed on it.
+        uint64_t data_key = 0;
+        /**
+         * \brief Tells if the weak reference points to the same data as samples.
+         */
+        template < typename T >
+        static bool sameData(const std::weak_ptr<const void> &data, const std::shared_ptr<Data< T > > &samples) {
+            return !data.expired() && !data.owner_before(samples) && !samples.owner_before(data);
+        }
     public :
         /**
          * \brief Class constructor.
          */
         Kernel(int type = 0, double param = 0);
         /**
-         * \brief getKernelMatrixPointer Returns a reference to the kernel matrix.
+         * \brief getKernelMatrixPointer Returns a reference to the kernel matrix, a matrix mapped from the disk cache
+         * is copied in memory first.
          * \return mltk::dMatrix*
          */
         mltk::dMatrix* getKernelMatrixPointer();
+        /**
+         * \brief getKernelRows Returns the rows of the kernel matrix, read in place from the memory or from the disk
+         * cache mapping. They are valid until the kernel matrix changes.
+         * \return std::vector<const double*>
+         */
+        std::vector<const double*> getKernelRows() const;
         /**
          * \brief Class constructor.
          * \param K Kernel matrix to be set in initialization.
@@ -79,13 +202,54 @@ namespace mltk{
          * \return std::vector<std::vector<double> >
          */
         mltk::dMatrix getKernelMatrix();
-        void recompute(){ this->computed = false;}
         /**
-         * \brief compute Compute the kernel matrix with the given type and parameter.
+         * \brief recompute Compute the kernel matrix again in the next call to compute, this must be called when
+         * the samples were changed in place.
+         */
+        void recompute(){ this->computed = false; this->fingerprinted.reset(); }
+        /**
+         * \brief setCache Set the disk cache used to load and store the kernel matrix.
+         * \param cache Kernel matrix cache, nullptr to use the default cache.
+         */
+        void setCache(std::shared_ptr<KernelCache> cache);
+        /**
+         * \brief setDefaultCache Set the disk cache used by all kernels without a cache of their own.
+         * \param cache Kernel matrix cache, nullptr disables the default cache.
+         */
+        static void setDefaultCache(std::shared_ptr<KernelCache> cache);
+        /**
+         * \brief getCache Returns the disk cache used by the kernel, if any.
+         * \return std::shared_ptr<KernelCache>
+         */
+        std::shared_ptr<KernelCache> getCache() const;
+        /**
+         * \brief compute Compute the kernel matrix with the given type and parameter. Nothing is done if the
+         * matrix was already computed from the same samples.
          * \param samples Data used to compute the kernel matrix.
          */
         template < typename T >
         void compute(std::shared_ptr<Data< T > > samples);
+        /**
+         * \brief compute Compute the kernel matrix with a compile-time kernel policy, the disk cache isn't used.
+         * \param samples Data used to compute the kernel matrix.
+         * \param policy Kernel policy used in the computations.
+         */
+        template < typename Policy, typename T >
+        void compute(std::shared_ptr<Data< T > > samples, const Policy &policy);
+        /**
+         * \brief dispatch Call f with the kernel policy matching the kernel type and parameter.
+         * \param f Callable receiving the kernel policy, it isn't called for invalid kernel types.
+         */
+        template < typename F >
+        void dispatch(F &&f) const;
+        /**
+         * \brief dispatch Call f with the kernel policy matching the given kernel type and parameter.
+         * \param type Kernel type.
+         * \param param Kernel parameter.
+         * \param f Callable receiving the kernel policy, it isn't called for invalid kernel types.
+         */
+        template < typename F >
+        static void dispatch(int type, double param, F &&f);
         /**
          * \brief compute Compute the H matrix with the computed kernel matrix and given samples.
          * \param samples Data used to compute the kernel matrix.
@@ -110,6 +274,15 @@ namespace mltk{
          */
         template < typename T >
         double function(std::shared_ptr<Point< T > > one, std::shared_ptr<Point< T > > two, int dim);
+        /**
+         * \brief function Compute the kernel function between two points.
+         * \param one first point.
+         * \param two second point.
+         * \param dim Dimension of the points.
+         * \return double
+         */
+        template < typename T >
+        double function(const Point< T > &one, const Point< T > &two, size_t dim) const;
         /**
          * \brief function Compute the kernel function between two points without a dimension.
          * \param one first point.
@@ -136,90 +309,136 @@ namespace mltk{
         double featureSpaceNorm(std::shared_ptr<Data< T > > data);
     };
 
+    template < typename F >
+    void Kernel::dispatch(F &&f) const {
+        dispatch(type, param, std::forward<F>(f));
+    }
+
+    template < typename F >
+    void Kernel::dispatch(int type, double param, F &&f) {
+        switch(type)
+        {
+            case KernelType::INNER_PRODUCT:
+                f(kernels::Linear(param));
+                break;
+            case KernelType::POLYNOMIAL:
+                f(kernels::Polynomial(param));
+                break;
+            case KernelType::GAUSSIAN:
+                f(kernels::Gaussian(param));
+                break;
+            default:
+                break;
+        }
+    }
+
     template < typename T >
     void Kernel::compute(const std::shared_ptr<Data< T > > samples){
+        size_t size = samples->getSize();
+
+        if(computed && sameData(computed_data, samples)) return;
+
+        auto _cache = getCache();
+        uint64_t key = 0;
+        mapping.reset();
+        if(_cache){
+            // the data is hashed once, changing the kernel type or parameter only rehashes the key
+            if(!sameData(fingerprinted, samples)){
+                data_key = KernelCache::fingerprint(*samples);
+                fingerprinted = samples;
+            }
+            key = KernelCache::fingerprint(data_key, type, param);
+            mapping = _cache->map(key, size);
+            if(mapping){
+                K.clear();
+                computed = true;
+                computed_data = samples;
+                return;
+            }
+        }
+        computed = false;
+        K.assign(size, std::vector<double>(size, 0.0));
+
+        // the kernel type is resolved once, outside of the matrix loops
+        dispatch([&](auto const& policy){ this->compute(samples, policy); });
+        computed = true;
+        computed_data = samples;
+        if(_cache) _cache->store(key, K);
+    }
+
+    template < typename Policy, typename T >
+    void Kernel::compute(const std::shared_ptr<Data< T > > samples, const Policy &policy){
         size_t i, j, size = samples->getSize(), dim = samples->getDim();
 
-        if(computed) return;
+        if(computed && sameData(computed_data, samples)) return;
+        mapping.reset();
         K.assign(size, std::vector<double>(size, 0.0));
 
         //Calculating Matrix
         for(i = 0; i < size; ++i){
+            const T *a = (*samples)[i]->X().data();
             for(j = i; j < size; ++j){
-                K[i][j] = function((*samples)[i], (*samples)[j], dim);
+                K[i][j] = policy.function(a, (*samples)[j]->X().data(), dim);
                 K[j][i] = K[i][j];
             }
         }
         computed = true;
+        computed_data = samples;
     }
 
     template < typename T >
     mltk::dMatrix* Kernel::generateMatrixH(const std::shared_ptr<Data< T > > samples) {
-        int i = 0, j = 0;
-        size_t size = samples->getSize(), dim = samples->getDim();
+        size_t i, j, size = samples->getSize(), dim = samples->getDim();
 
-        H.resize(size, std::vector<double>(size));
+        H.assign(size, std::vector<double>(size, 0.0));
 
         /* Calculating Matrix */
-        for(i = 0; i < size; ++i) {
-            for (j = i; j < size; ++j) {
-                H[i][j] = function(samples->getPoint(i), samples->getPoint(j), dim) * samples->getPoint(i)->Y() *
-                        samples->getPoint(j)->Y();
-                H[j][i] = H[i][j];
+        dispatch([&](auto const& policy){
+            for(i = 0; i < size; ++i) {
+                auto const& a = (*samples)[i];
+                for (j = i; j < size; ++j) {
+                    auto const& b = (*samples)[j];
+                    H[i][j] = policy.function(a->X().data(), b->X().data(), dim) * a->Y() * b->Y();
+                    H[j][i] = H[i][j];
+                }
             }
-        }
+        });
         std::clog << "\nH matrix generated.\n";
         return &H;
     }
 
     template < typename T >
     mltk::dMatrix* Kernel::generateMatrixHwithoutDim(const std::shared_ptr<Data< T > > samples, int dim) {
-        int i = 0, j = 0;
-        size_t size = samples->getSize();
+        size_t i, j, size = samples->getSize(), sdim = samples->getDim();
 
-        HwithoutDim.resize(size, std::vector<double>(size));
+        HwithoutDim.assign(size, std::vector<double>(size, 0.0));
 
         /* Calculating Matrix */
-        for(i = 0; i < size; ++i) {
-            for (j = i; j < size; ++j) {
-                HwithoutDim[i][j] = functionWithoutDim((*samples)[i], (*samples)[j], dim, samples->getDim()) *
-                                    samples->getPoint(i)->Y() * samples->getPoint(j)->Y();
-                HwithoutDim[j][i] = HwithoutDim[i][j];
+        dispatch([&](auto const& policy){
+            for(i = 0; i < size; ++i) {
+                auto const& a = (*samples)[i];
+                for (j = i; j < size; ++j) {
+                    auto const& b = (*samples)[j];
+                    HwithoutDim[i][j] = policy.functionWithoutDim(a->X().data(), b->X().data(), dim, sdim) *
+                                        a->Y() * b->Y();
+                    HwithoutDim[j][i] = HwithoutDim[i][j];
+                }
             }
-        }
+        });
     // clog << "\nH matrix without dim generated.\n";
         return &HwithoutDim;
     }
 
     template < typename T >
     double Kernel::function(std::shared_ptr<Point< T > > one, std::shared_ptr<Point< T > > two, int dim){
-        int i = 0;
-        double t, sum = 0.0;
-        std::vector< T > a = one->X(), b = two->X();
-
-        // a.erase(a.end());
-        //b.erase(b.end());
-
-        switch(type)
-        {
-            case 0: //Produto Interno
-                for(i = 0; i < dim; ++i)
-                    sum += a[i] * b[i];
-                break;
-            case 1: //Polinomial
-                for(i = 0; i < dim; ++i)
-                    sum += a[i] * b[i];
-                //    sum = (param > 1) ? std::pow(sum+1, param) : sum;
-                sum = (param > 1) ? std::pow(sum, param) : sum;
-                break;
+        return function(*one, *two, dim);
+    }
 
-            case 2: //Gaussiano
-                for(i = 0; i < dim; ++i)
-                { t = a[i] - b[i]; sum += t * t; }
-                sum = std::exp(-1 * sum * param);
-                break;
-        }
+    template < typename T >
+    double Kernel::function(const Point< T > &one, const Point< T > &two, size_t dim) const {
+        double sum = 0.0;
 
+        dispatch([&](auto const& policy){ sum = policy.function(one.X().data(), two.X().data(), dim); });
         /*The '+1' here accounts for the bias term "b" in SVM formulation since
         <w,x> = \sum_i \alpha_i y_i k(x_i,x) + b and b=\sum_i \alpha_i y_i*/
 
@@ -228,31 +447,9 @@ namespace mltk{
 
     template < typename T >
     double Kernel::functionWithoutDim(std::shared_ptr<Point< T > > one, std::shared_ptr<Point< T > > two, int j, int dim) {
-        int i = 0;
-        double t, sum = 0.0;
+        double sum = 0.0;
 
-        switch(type)
-        {
-            case 0: //Produto Interno
-                for(i = 0; i < dim; ++i)
-                    if(i != j)
-                        sum += one->X()[i] * two->X()[i];
-                break;
-
-            case 1: //Polinomial
-                for(i = 0; i < dim; ++i)
-                    if(i != j)
-                        sum += one->X()[i] * two->X()[i];
-                sum = (param > 1) ? std::pow(sum+1, param) : sum;
-                break;
-
-            case 2: //Gaussiano
-                for(i = 0; i < dim; ++i)
-                    if(i != j)
-                    { t = one->X()[i] - two->X()[i]; sum += t * t; }
-                sum = std::exp(-1 * sum * param);
-                break;
-        }
+        dispatch([&](auto const& policy){ sum = policy.functionWithoutDim(one->X().data(), two->X().data(), j, dim); });
         /*The '+1' here accounts for the bias term "b" in SVM formulation since
         <w,x> = \sum_i \alpha_i y_i k(x_i,x) + b and b=\sum_i \alpha_i y_i*/
         return sum;// + 1.0f;
@@ -263,6 +460,7 @@ namespace mltk{
         size_t i, j, size = data.getSize();
         double sum, sum1;
         auto points = data.getPoints();
+        auto K = getKernelRows();
 
         sum = sum1 = 0;
 
@@ -281,6 +479,7 @@ namespace mltk{
         size_t i = 0, j = 0, size = data->getSize();
         double sum1 = 0.0;
         double sum  = 0.0;
+        auto K = getKernelRows();
 
         for(i = 0; i < size; ++i)
         {
@@ -0,0 +1,200 @@
+/*! Kernel matrix disk cache
+   \file KernelCache.hpp
+*/
+
+#ifndef KERNELCACHE__HPP
+#define KERNELCACHE__HPP
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Data.hpp"
+#include "Utils.hpp"
+
+namespace mltk{
+    /**
+     * \brief Persistent cache of kernel matrices stored in a directory.
+     *
+     * Each matrix is written to its own file, named after a fingerprint of the data, the features kept, the kernel
+     * type and the kernel parameter. The file is a fixed size header followed by the matrix in row-major order, so
+     * it can be mapped directly in memory by later runs. Matrices are written to a unique temporary file renamed
+     * in place, so concurrent writers never see each other's partial files. When the files in the directory exceed
+     * the size cap, the least recently used ones are removed. A cache can be shared by learners trained at the same
+     * time, the stores and evictions are serialized.
+     */
+    class KernelCache {
+    public:
+        /// Header of a cached kernel matrix file, followed by rows*cols doubles.
+        struct Header {
+            char magic[8];
+            uint64_t key;
+            uint64_t rows;
+            uint64_t cols;
+        };
+
+        /**
+         * \brief A cached kernel matrix mapped in memory, the rows are read straight from the file pages. The
+         * mapping is released when the last reference to it goes away.
+         */
+        class Mapping {
+        private:
+            void *address = nullptr;
+            size_t bytes = 0, size = 0;
+            /// Matrix values, when memory mapping isn't available.
+            std::vector<double> buffer;
+            const double *values = nullptr;
+
+            friend class KernelCache;
+
+        public:
+            Mapping() = default;
+            Mapping(const Mapping&) = delete;
+            Mapping& operator=(const Mapping&) = delete;
+            ~Mapping();
+
+            /**
+             * \brief Returns the i-th row of the matrix.
+             * \return const double*
+             */
+            const double* row(size_t i) const { return values + i * size; }
+
+            /**
+             * \brief Returns the number of rows of the matrix.
+             * \return size_t
+             */
+            size_t getSize() const { return size; }
+        };
+
+    private:
+        /// Directory where the matrices are stored.
+        std::string directory;
+        /// Maximum number of bytes that can be used by the cache directory.
+        size_t max_size;
+        /// Serializes the stores and evictions of the learners sharing the cache.
+        mutable std::mutex lock;
+
+        std::string filePath(uint64_t key) const;
+
+        void evictUnlocked(size_t incoming);
+
+    public:
+        /**
+         * \brief Class constructor, the directory is created if it doesn't exist.
+         * \param directory Directory where the kernel matrices will be stored.
+         * \param max_size Maximum number of bytes used by the cache (1GB is the default).
+         */
+        explicit KernelCache(std::string directory, size_t max_size = size_t(1) << 30);
+
+        /**
+         * \brief Computes the fingerprint of a dataset, from its size, the features kept and the features values.
+         * \param data Data used to compute the kernel matrix.
+         * \return uint64_t
+         */
+        template < typename T >
+        static uint64_t fingerprint(Data< T > &data);
+        /**
+         * \brief Computes the fingerprint of a kernel matrix from the fingerprint of its data, so the data is only
+         * hashed once for all the kernel parameters tried on it.
+         * \param data_key Fingerprint of the data used to compute the kernel matrix.
+         * \param type Kernel type.
+         * \param param Kernel parameter.
+         * \return uint64_t
+         */
+        static uint64_t fingerprint(uint64_t data_key, int type, double param);
+        /**
+         * \brief Computes the fingerprint of a kernel matrix.
+         * \param data Data used to compute the kernel matrix.
+         * \param type Kernel type.
+         * \param param Kernel parameter.
+         * \return uint64_t
+         */
+        template < typename T >
+        static uint64_t fingerprint(Data< T > &data, int type, double param) {
+            return fingerprint(fingerprint(data), type, param);
+        }
+        /**
+         * \brief Map a kernel matrix of the cache in memory, without copying it.
+         * \param key Fingerprint of the matrix.
+         * \param size Expected number of rows and columns of the matrix.
+         * \return std::shared_ptr<const Mapping>, nullptr if the matrix wasn't found.
+         */
+        std::shared_ptr<const Mapping> map(uint64_t key, size_t size) const;
+        /**
+         * \brief Load a kernel matrix from the cache.
+         * \param key Fingerprint of the matrix.
+         * \param size Expected number of rows and columns of the matrix.
+         * \param K Matrix where the values will be loaded.
+         * \return bool informing if the matrix was found.
+         */
+        bool load(uint64_t key, size_t size, dMatrix &K) const;
+        /**
+         * \brief Store a kernel matrix in the cache, evicting old matrices if needed.
+         * \param key Fingerprint of the matrix.
+         * \param K Matrix to be stored.
+         * \return bool informing if the matrix was stored.
+         */
+        bool store(uint64_t key, const dMatrix &K);
+        /**
+         * \brief Remove the least recently used matrices until the given number of bytes fit in the cache.
+         * \param incoming Number of bytes that will be added to the cache.
+         */
+        void evict(size_t incoming = 0);
+        /**
+         * \brief Remove all the matrices from the cache.
+         */
+        void clear();
+        /**
+         * \brief Returns the number of bytes used by the cached matrices.
+         * \return size_t
+         */
+        size_t getUsedSize() const;
+
+        const std::string& getDirectory() const { return directory; }
+
+        size_t getMaxSize() const { return max_size; }
+
+        void setMaxSize(size_t _max_size) { this->max_size = _max_size; evict(); }
+    };
+
+    /**
+     * \brief FNV-1a hash of a sequence of bytes, continuing from the given hash.
+     */
+    inline uint64_t fnv1a(uint64_t hash, const void *bytes, size_t n){
+        auto p = static_cast<const unsigned char*>(bytes);
+
+        for(size_t i = 0; i < n; i++){
+            hash ^= p[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    template < typename T >
+    uint64_t KernelCache::fingerprint(Data< T > &data){
+        uint64_t hash = 14695981039346656037ULL;
+        auto mix = [&hash](const void *bytes, size_t n){ hash = fnv1a(hash, bytes, n); };
+        uint64_t size = data.getSize(), dim = data.getDim();
+
+        mix(&size, sizeof(size));
+        mix(&dim, sizeof(dim));
+        for(int fname: data.getFeaturesNames()){
+            int64_t f = fname;
+            mix(&f, sizeof(f));
+        }
+        for(size_t i = 0; i < size; i++){
+            auto const& x = data[i]->X();
+            for(size_t j = 0; j < dim; j++){
+                double v = x[j];
+                mix(&v, sizeof(v));
+            }
+        }
+        return hash;
+    }
+}
+
+#endif
@@ -81,6 +81,20 @@ namespace mltk{
        * \return int
        */
       virtual double evaluate (const Point< T > &p, bool raw_value=false) = 0;
+      /**
+       * \brief Returns the evaluation of all the points of a dataset.
+       * \param data Points to be evaluated.
+       * \param raw_value Return the raw values of the Learner instead of the predicted classes.
+       * \return std::vector<double>
+       */
+      virtual std::vector<double> batchEvaluate (Data< T > &data, bool raw_value=false) {
+          std::vector<double> values(data.getSize());
+
+          for(size_t i = 0; i < values.size(); i++){
+              values[i] = this->evaluate(*data[i], raw_value);
+          }
+          return values;
+      }
       
       /*********************************************
        *               Getters                     *
@@ -151,6 +165,11 @@ namespace mltk{
        * \param verbose level of verbose.
        */
       void setVerbose(int verbose) {this->verbose = verbose;}
+      /**
+       * \brief Returns the level of verbose.
+       * \return int
+       */
+      int getVerbose() const { return verbose; }
       /**
        * \brief setStartTime Set the initial time of the Learner.
        * \param start_time Initial time.
@@ -0,0 +1,248 @@
+/*! Distances between all the pairs of points of a dataset.
+   \file PairwiseDistances.hpp
+*/
+
+#ifndef UFJF_MLTK_PAIRWISEDISTANCES_HPP
+#define UFJF_MLTK_PAIRWISEDISTANCES_HPP
+
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include "Data.hpp"
+#include "DistanceMetric.hpp"
+
+namespace mltk { namespace metrics {
+    /**
+     * \brief Distances between all the pairs of points of a dataset, in single precision. Only the upper triangle
+     * is stored, row by row, n(n-1)/2 values.
+     */
+    class DistanceMatrix {
+    private:
+        size_t n = 0;
+        std::vector<float> values;
+
+    public:
+        DistanceMatrix() = default;
+
+        explicit DistanceMatrix(size_t _n): n(_n), values((_n > 1) ? _n * (_n - 1) / 2 : 0) {}
+
+        /**
+         * \brief Position of the pair (i, j), i < j, in the stored triangle.
+         */
+        size_t index(size_t i, size_t j) const { return i * n - i * (i + 1) / 2 + (j - i - 1); }
+
+        /**
+         * \brief Distance between the points i and j of the dataset.
+         */
+        float operator()(size_t i, size_t j) const {
+            if (i == j) return 0;
+            if (i > j) std::swap(i, j);
+            return values[index(i, j)];
+        }
+
+        /**
+         * \brief Returns the number of points.
+         * \return size_t
+         */
+        size_t size() const { return n; }
+
+        std::vector<float> &data() { return values; }
+
+        const std::vector<float> &data() const { return values; }
+    };
+
+    /**
+     * \brief The k nearest neighbors of each point of a dataset, the point itself excluded, as a matrix of n rows
+     * with the neighbors sorted by distance. The distances are in single precision.
+     */
+    class NeighborGraph {
+    private:
+        size_t n = 0, k = 0;
+        std::vector<float> dists;
+        std::vector<size_t> ids;
+
+    public:
+        NeighborGraph() = default;
+
+        NeighborGraph(size_t _n, size_t _k): n(_n), k(_k), dists(_n * _k), ids(_n * _k) {}
+
+        /**
+         * \brief Distances from the point i to its neighbors, k values.
+         */
+        const float *distances(size_t i) const { return dists.data() + i * k; }
+
+        float *distances(size_t i) { return dists.data() + i * k; }
+
+        /**
+         * \brief Indexes in the dataset of the neighbors of the point i, k values.
+         */
+        const size_t *neighbors(size_t i) const { return ids.data() + i * k; }
+
+        size_t *neighbors(size_t i) { return ids.data() + i * k; }
+
+        /**
+         * \brief Returns the number of points.
+         * \return size_t
+         */
+        size_t size() const { return n; }
+
+        /**
+         * \brief Returns the number of neighbors of each point.
+         * \return size_t
+         */
+        size_t getK() const { return k; }
+    };
+
+    /// Side of the square tiles of point pairs computed at a time, a tile of points stays in cache for its rows.
+    const size_t PAIRWISE_TILE = 256;
+
+    /**
+     * \brief Pack the points of a dataset one after the other, as the distances call of the metrics expects.
+     */
+    template<typename T>
+    std::vector<T> packPoints(const Data<T> &data) {
+        size_t n = data.getSize(), dim = data.getDim();
+        std::vector<T> coords(n * dim);
+
+        for (size_t j = 0; j < n; j++) std::copy(data[j]->X().begin(), data[j]->X().end(), coords.begin() + j * dim);
+        return coords;
+    }
+
+    /**
+     * \brief Tiles of the upper triangle, as (row tile, column tile) with the row tile not after the column tile.
+     */
+    inline std::vector<std::pair<size_t, size_t> > upperTiles(size_t n) {
+        size_t n_tiles = (n + PAIRWISE_TILE - 1) / PAIRWISE_TILE;
+        std::vector<std::pair<size_t, size_t> > tiles;
+
+        for (size_t I = 0; I < n_tiles; I++)
+            for (size_t J = I; J < n_tiles; J++) tiles.emplace_back(I, J);
+        return tiles;
+    }
+
+    /**
+     * \brief Compute the distances between all the pairs of points of a dataset. Only the upper triangle is
+     * computed, in tiles shared among the threads.
+     * \param data Dataset.
+     * \param metric Metric functor.
+     * \return DistanceMatrix with n(n-1)/2 distances, n^2/2 floats of memory.
+     */
+    template<typename T, typename Callable = dist::Euclidean<T> >
+    DistanceMatrix pairwiseDistances(const Data<T> &data, Callable metric = Callable()) {
+        size_t n = data.getSize(), dim = data.getDim();
+        DistanceMatrix matrix(n);
+        std::vector<T> coords = packPoints(data);
+        auto tiles = upperTiles(n);
+
+        #pragma omp parallel
+        {
+            std::vector<T> out(PAIRWISE_TILE);
+
+            #pragma omp for schedule(dynamic)
+            for (long t = 0; t < (long) tiles.size(); t++) {
+                size_t i0 = tiles[t].first * PAIRWISE_TILE, i1 = std::min(n, i0 + PAIRWISE_TILE);
+                size_t j_begin = tiles[t].second * PAIRWISE_TILE, j_end = std::min(n, j_begin + PAIRWISE_TILE);
+
+                for (size_t i = i0; i < i1; i++) {
+                    size_t j0 = std::max(j_begin, i + 1);
+                    if (j0 >= j_end) continue;
+
+                    // the pairs (i, j0..j_end) are contiguous in the stored triangle
+                    float *row = matrix.data().data() + matrix.index(i, j0);
+                    dist::batchDistances(metric, *data[i], coords.data() + j0 * dim, j_end - j0, out.data());
+                    for (size_t c = 0; c < j_end - j0; c++) row[c] = float(out[c]);
+                }
+            }
+        }
+        return matrix;
+    }
+
+    /**
+     * \brief Find the k nearest neighbors of every point of a dataset. Each distance of the upper triangle is
+     * computed once and offered to the neighbors of both points, so only k distances per point are kept. Ties are
+     * broken by the index of the points, so the graph doesn't depend on the number of threads.
+     * \param data Dataset.
+     * \param k Number of neighbors, at most n - 1.
+     * \param metric Metric functor.
+     * \return NeighborGraph with the neighbors of each point sorted by distance.
+     */
+    template<typename T, typename Callable = dist::Euclidean<T> >
+    NeighborGraph pairwiseNeighbors(const Data<T> &data, size_t k, Callable metric = Callable()) {
+        using Neighbor = std::pair<double, size_t>;
+        size_t n = data.getSize(), dim = data.getDim();
+        size_t _k = (n > 1) ? std::min(k, n - 1) : 0;
+        NeighborGraph graph(n, _k);
+        std::vector<T> coords = packPoints(data);
+        auto tiles = upperTiles(n);
+        // bounded max-heap of each point, the heaps of a tile of points share a lock
+        std::vector<Neighbor> heaps(n * _k);
+        std::vector<size_t> counts(n, 0);
+        std::vector<std::mutex> locks((n + PAIRWISE_TILE - 1) / PAIRWISE_TILE);
+
+        if (_k == 0) return graph;
+        auto push = [&heaps, &counts, _k](size_t i, double d, size_t j) {
+            Neighbor *heap = heaps.data() + i * _k;
+            Neighbor neighbor(d, j);
+
+            if (counts[i] < _k) {
+                heap[counts[i]++] = neighbor;
+                std::push_heap(heap, heap + counts[i]);
+            } else if (neighbor < heap[0]) {
+                std::pop_heap(heap, heap + _k);
+                heap[_k - 1] = neighbor;
+                std::push_heap(heap, heap + _k);
+            }
+        };
+
+        #pragma omp parallel
+        {
+            std::vector<T> tile(PAIRWISE_TILE * PAIRWISE_TILE);
+
+            #pragma omp for schedule(dynamic)
+            for (long t = 0; t < (long) tiles.size(); t++) {
+                size_t I = tiles[t].first, J = tiles[t].second;
+                size_t i0 = I * PAIRWISE_TILE, i1 = std::min(n, i0 + PAIRWISE_TILE);
+                size_t j_begin = J * PAIRWISE_TILE, j_end = std::min(n, j_begin + PAIRWISE_TILE);
+
+                for (size_t i = i0; i < i1; i++) {
+                    size_t j0 = (I == J) ? i + 1 : j_begin;
+                    if (j0 < j_end)
+                        dist::batchDistances(metric, *data[i], coords.data() + j0 * dim, j_end - j0,
+                                             tile.data() + (i - i0) * PAIRWISE_TILE + (j0 - j_begin));
+                }
+                {
+                    std::lock_guard<std::mutex> lock(locks[I]);
+                    for (size_t i = i0; i < i1; i++)
+                        for (size_t j = (I == J) ? i + 1 : j_begin; j < j_end; j++)
+                            push(i, tile[(i - i0) * PAIRWISE_TILE + (j - j_begin)], j);
+                    // on the diagonal the rows and columns are the same points
+                    if (I == J) {
+                        for (size_t i = i0; i < i1; i++)
+                            for (size_t j = i + 1; j < j_end; j++)
+                                push(j, tile[(i - i0) * PAIRWISE_TILE + (j - j_begin)], i);
+                    }
+                }
+                if (I != J) {
+                    std::lock_guard<std::mutex> lock(locks[J]);
+                    for (size_t j = j_begin; j < j_end; j++)
+                        for (size_t i = i0; i < i1; i++)
+                            push(j, tile[(i - i0) * PAIRWISE_TILE + (j - j_begin)], i);
+                }
+            }
+        }
+
+        #pragma omp parallel for
+        for (long i = 0; i < (long) n; i++) {
+            Neighbor *heap = heaps.data() + i * _k;
+
+            std::sort_heap(heap, heap + _k);
+            for (size_t r = 0; r < _k; r++) {
+                graph.distances(i)[r] = float(heap[r].first);
+                graph.neighbors(i)[r] = heap[r].second;
+            }
+        }
+        return graph;
+    }
+}}
+
+#endif //UFJF_MLTK_PAIRWISEDISTANCES_HPP
@@ -4,7 +4,10 @@
 
 #include "Data.hpp"
 #include "DistanceMetric.hpp"
+#include "PairwiseDistances.hpp"
 #include <random>
+#include <algorithm>
+#include <limits>
 
 namespace mltk{
     template < typename T >
@@ -40,6 +43,47 @@ namespace mltk{
     class OverSampling{
     protected:
         Callable distance_metric;
+
+        /**
+         * \brief Nearest points to the point pos of a dataset at distinct and non-zero distances, sorted by distance
+         * and then by position. The candidates are the neighbors of pos in a graph of the dataset, with their exact
+         * distances computed again, the distances to the whole dataset are computed only when the candidates don't
+         * have k such points.
+         * \param data Dataset.
+         * \param graph Neighbors graph of the dataset.
+         * \param pos Position of the point in the dataset.
+         * \param k Number of neighbors.
+         * \return std::vector<size_t> with the positions of at most k neighbors.
+         */
+        std::vector<size_t> distinctNeighbors(const Data< T > &data, const metrics::NeighborGraph &graph, size_t pos,
+                                              size_t k){
+            std::vector<std::pair<double, size_t> > distance;
+            size_t n = data.getSize();
+
+            for(int pass = 0; pass < 2; pass++){
+                size_t n_candidates = (pass == 0) ? graph.getK() : n;
+
+                distance.clear();
+                for(size_t c = 0; c < n_candidates; c++){
+                    size_t j = (pass == 0) ? graph.neighbors(pos)[c] : c;
+                    distance.emplace_back(distance_metric(*data[pos], *data[j]), j);
+                }
+                std::sort(distance.begin(), distance.end());
+                // keep one point at each distance, without the points on top of pos
+                distance.erase(std::unique(distance.begin(), distance.end(), [](auto &d1, auto &d2){
+                    return d1.first == d2.first;
+                }), distance.end());
+                distance.erase(std::remove_if(distance.begin(), distance.end(), [](auto &d){
+                    return d.first == 0;
+                }), distance.end());
+                if(distance.size() >= k || graph.getK() + 1 >= n) break;
+            }
+
+            std::vector<size_t> neighbors;
+            for(size_t i = 0; (i < k) && (i < distance.size()); i++) neighbors.push_back(distance[i].second);
+            return neighbors;
+        }
+
     public:
         OverSampling()=default;
         explicit OverSampling(Callable dist_metric): distance_metric(dist_metric) {}
@@ -61,7 +105,7 @@ namespace mltk{
 
     public:
         explicit SMOTE(size_t k = 1, double r = 0.1, size_t seed = 0, Callable dist_metric = Callable())
-        : k(k), r(r), seed(seed), OverSampling<T>(dist_metric) {}
+        : OverSampling<T, Callable>(dist_metric), seed(seed), k(k), r(r) {}
 
         Data< T > operator()(Data< T > &data) override {
             std::random_device rd;
@@ -79,37 +123,20 @@ namespace mltk{
             std::vector<SamplePointer< T > > artificial_data;
             Data< T > Z;
             Z.classesCopy(data, class_copy);
-            
+            // the k nearest neighbors of every point come from one neighbors graph of the Z set, with room for
+            // points at equal distances
+            size_t q = (Z.getSize() > 1) ? std::min(Z.getSize() - 1, 2 * k + 1) : 0;
+            auto graph = metrics::pairwiseNeighbors(Z, q, this->distance_metric);
+
             // iterate through all the elements from the Z set
-            for(auto z = Z.begin(); z != Z.end(); ++z){
-                std::vector<std::pair<size_t, double> > distance(Z.getSize());
+            for(size_t pos = 0; pos < Z.getSize(); pos++){
                 std::vector<SamplePointer< T > > k_neighbors(k);
-                size_t id = 0;
-                auto _z = *(*z);
-
-                // compute the metrics from a point to the rest
-                std::transform(Z.begin(), Z.end(), distance.begin(), [this, &_z, &id](auto p){
-                    id++;
-                    return std::make_pair(id, this->distance_metric(_z, *p));
-                });
-
-                // sort the distances in increasing metrics order
-                std::sort(distance.begin(), distance.end(), [](auto &d1, auto &d2){
-                    return d1.second < d2.second;
-                });
-
-                // remove points with equal metrics or duplicate ids
-                distance.erase(std::unique(distance.begin(), distance.end(), [](auto &d1, auto &d2){
-                    return (d1.second == d2.second) || ((d1.first == d2.first));
-                }), distance.end());
-
-                distance.erase(std::remove_if(distance.begin(), distance.end(), [](auto &d){
-                    return d.second == 0;
-                }), distance.end());
+                auto _z = *Z[pos];
+                auto neighbors = this->distinctNeighbors(Z, graph, pos, k);
 
                 // get the k neighbors
-                for(size_t i = 0; (i < k) && (i < distance.size()); i++){
-                    k_neighbors[i] = data[distance[i].first-1];
+                for(size_t i = 0; i < neighbors.size(); i++){
+                    k_neighbors[i] = Z[neighbors[i]];
                 }
 
                 // create the artificial points and insert them to the dataset
@@ -151,7 +178,7 @@ namespace mltk{
         
     public:
         explicit BorderlineSMOTEOne(size_t k = 1, double r = 0.1, size_t m = 1, size_t seed = 0, Callable dist_metric = Callable())
-        : k(k), r(r), m(m), seed(seed), OverSampling<T>(dist_metric) {}
+        : OverSampling<T, Callable>(dist_metric), seed(seed), k(k), m(m), r(r) {}
 
         Data< T > operator()(Data< T > &data) override {
             // Find the majority class
@@ -162,41 +189,25 @@ namespace mltk{
             Data< T > danger_subset;
             std::set<size_t> danger_ids;
 
+            // the m nearest neighbors of every point come from one neighbors graph of the dataset, with room for
+            // points at equal distances
+            size_t n = data.getSize(), q = (n > 1) ? std::min(n - 1, 2 * m + 1) : 0;
+            auto graph = metrics::pairwiseNeighbors(data, q, this->distance_metric);
+
             // iterate through all the elements from the Z set
-            for(auto z = data.begin(); z != data.end(); ++z){
-                std::vector<std::pair<size_t, double> > distance(data.getSize());
+            for(size_t pos = 0; pos < n; pos++){
                 std::vector<SamplePointer< T > > M(m);
-                size_t id = 0;
-                auto _z = (*z);
-
-                // compute the euclidean metrics from a point to the rest
-                std::transform(data.begin(), data.end(), distance.begin(), [this, &_z, &id](auto p){
-                    id++;
-                    return std::make_pair(id, this->distance_metric(*_z, *p));
-                });
-
-                // sort the distances in increasing metrics order
-                std::sort(distance.begin(), distance.end(), [](auto &d1, auto &d2){
-                    return d1.second < d2.second;
-                });
-                
-                // remove points with equal metrics or duplicate ids
-                distance.erase(std::unique(distance.begin(), distance.end(), [](auto &d1, auto &d2){
-                    return (d1.second == d2.second) || ((d1.first == d2.first));
-                }), distance.end());
-
-                distance.erase(std::remove_if(distance.begin(), distance.end(), [](auto &d){
-                    return d.second == 0;
-                }), distance.end());
+                auto _z = data[pos];
+                auto neighbors = this->distinctNeighbors(data, graph, pos, m);
 
                 // get the m neighbors
-                for(size_t i = 0; (i < m) && (i < distance.size()); i++){
-                    M[i] = data[distance[i].first-1];
+                for(size_t i = 0; i < neighbors.size(); i++){
+                    M[i] = data[neighbors[i]];
                 }
                 
                 // set m' as the number of points on the majority class set on m neighbors
                 size_t m_ = std::count_if(M.begin(), M.end(), [&maj_class](auto &p){
-                    return p->Y() == maj_class;
+                    return p && p->Y() == maj_class;
                 });
                 
                 // insert the point to the danger subset if m/2 <= m' < m
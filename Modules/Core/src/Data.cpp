@@ -590,6 +590,33 @@ namespace mltk{
         return true;
     }
 
+    template < typename T >
+    bool mltk::Data< T >::removePoint(const std::shared_ptr<Point< T > > &p){
+        auto it = std::find(points.begin(), points.end(), p);
+        int pos = int(it - points.begin());
+
+        if(it == points.end()) return false;
+        if(stats.n_pos > 0 || stats.n_neg > 0){
+            if(p->Y() == 1) stats.n_pos--;
+            else if(p->Y() == -1) stats.n_neg--;
+        }
+        if(this->isClassification()){
+            size_t class_pos = std::find(classes.begin(), classes.end(), p->Y()) - classes.begin();
+
+            if(class_pos < class_distribution.size() && class_distribution[class_pos] > 0)
+                class_distribution[class_pos]--;
+        }
+        points.erase(it);
+        if(!index.empty()){
+            index.erase(std::remove(index.begin(), index.end(), pos), index.end());
+            for(auto &i: index) if(i > pos) i--;
+        }
+        size--;
+        if(size == 0) is_empty = true;
+
+        return true;
+    }
+
     template < typename T >
     void mltk::Data< T >::write(const string& fname, string ext){
         int i, j;
@@ -0,0 +1,200 @@
+/*! Kernels of the most used distance metrics
+   \brief Vectorized double and float kernels, compiled for several instruction sets.
+   \file DistanceKernels.cpp
+*/
+
+#include "DistanceKernels.hpp"
+
+// one clone of each kernel per instruction set, the loader picks the best one the processor supports
+#if defined(__x86_64__) && defined(__linux__) && \
+    ((defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 6) || (defined(__clang__) && __clang_major__ >= 14))
+#define MLTK_KERNEL __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define MLTK_KERNEL
+#endif
+
+#if defined(__GNUC__)
+#define MLTK_INLINE inline __attribute__((always_inline))
+#else
+#define MLTK_INLINE inline
+#endif
+
+namespace mltk{
+    namespace metrics{ namespace dist{ namespace kernels{
+        namespace {
+            const double INF = std::numeric_limits<double>::infinity();
+
+            /// Number of partial sums, as many as fit in a 64 byte vector.
+            template<typename T>
+            constexpr size_t lanes() { return 64 / sizeof(T); }
+
+            /// Number of blocks of lanes between checks of the bound.
+            constexpr size_t CHECK_BLOCKS = 4;
+
+            /**
+             * \brief Add the partial sums, pairwise in a fixed order.
+             */
+            template<typename T, size_t N>
+            MLTK_INLINE T combine(const T (&acc)[N]) {
+                T tmp[N];
+
+                std::copy(acc, acc + N, tmp);
+                for (size_t width = N / 2; width > 0; width /= 2)
+                    for (size_t l = 0; l < width; l++) tmp[l] += tmp[l + width];
+                return tmp[0];
+            }
+
+            /**
+             * \brief Sum of Term(a_i, b_i), each lane accumulates every lanes()-th term, so the inner loop is a
+             * vector operation. With a finite bound the sum stops once the partial sum passes it, which needs
+             * non-negative terms.
+             */
+            template<typename Term, typename T>
+            MLTK_INLINE T reduce(const T *a, const T *b, size_t dim, double bound) {
+                constexpr size_t L = lanes<T>();
+                const bool bounded = bound < INF;
+                T acc[L] = {}, sum;
+                size_t i = 0, blocks = 0;
+
+                for (; i + L <= dim; i += L) {
+                    for (size_t l = 0; l < L; l++) acc[l] += Term::apply(a[i + l], b[i + l]);
+                    if (bounded && ++blocks % CHECK_BLOCKS == 0 && (sum = combine(acc)) > bound) return sum;
+                }
+                sum = combine(acc);
+                for (; i < dim; i++) sum += Term::apply(a[i], b[i]);
+                return sum;
+            }
+
+            struct SquaredDiff {
+                template<typename T>
+                static MLTK_INLINE T apply(T x, T y) { T diff = x - y; return diff * diff; }
+            };
+
+            struct AbsDiff {
+                template<typename T>
+                static MLTK_INLINE T apply(T x, T y) { return std::fabs(x - y); }
+            };
+
+            struct Product {
+                template<typename T>
+                static MLTK_INLINE T apply(T x, T y) { return x * y; }
+            };
+
+            struct Lorentzian {
+                template<typename T>
+                static MLTK_INLINE T apply(T x, T y) { return std::log(1 - std::fabs(x - y)); }
+            };
+
+            struct Bhattacharyya {
+                template<typename T>
+                static MLTK_INLINE T apply(T x, T y) { return std::sqrt(x * y); }
+            };
+
+            struct Pearson {
+                template<typename T>
+                static MLTK_INLINE T apply(T x, T y) { T diff = x - y; return diff * diff / y; }
+            };
+
+            struct KullbackLeibler {
+                template<typename T>
+                static MLTK_INLINE T apply(T x, T y) { return x * std::log(x / y); }
+            };
+
+            struct Hassanat {
+                // the terms of both branches are selected before the division, so the loop has no jumps
+                template<typename T>
+                static MLTK_INLINE T apply(T x, T y) {
+                    T _min = std::min(x, y), _max = std::max(x, y);
+                    T num = (_min >= 0) ? 1 + _min : 1 + _min + std::fabs(_min);
+                    T den = (_min >= 0) ? 1 + _max : 1 + _max + std::fabs(_max);
+                    return 1 - num / den;
+                }
+            };
+
+            /**
+             * \brief Cosine distance with the squared norm of the first point already computed, the norms and the
+             * inner product use the same lanes as reduce.
+             */
+            template<typename T>
+            MLTK_INLINE T cosine(const T *a, const T *b, size_t dim, T norm_a) {
+                constexpr size_t L = lanes<T>();
+                T dot[L] = {}, norm[L] = {};
+                size_t i = 0;
+
+                for (; i + L <= dim; i += L) {
+                    for (size_t l = 0; l < L; l++) {
+                        dot[l] += a[i + l] * b[i + l];
+                        norm[l] += b[i + l] * b[i + l];
+                    }
+                }
+                T sum_dot = combine(dot), norm_b = combine(norm);
+                for (; i < dim; i++) {
+                    sum_dot += a[i] * b[i];
+                    norm_b += b[i] * b[i];
+                }
+                T den = std::sqrt(norm_a) * std::sqrt(norm_b);
+                return (den > 0) ? 1 - sum_dot / den : T(1);
+            }
+
+            template<typename Term, typename T>
+            MLTK_INLINE void reduceBatch(const T *q, const T *refs, size_t n, size_t dim, T *out) {
+                for (size_t j = 0; j < n; j++) out[j] = reduce<Term>(q, refs + j * dim, dim, INF);
+            }
+        }
+
+#define MLTK_DEFINE_KERNEL(T) \
+        MLTK_KERNEL T squaredL2(const T *a, const T *b, size_t dim, double bound) { \
+            return reduce<SquaredDiff>(a, b, dim, bound); \
+        } \
+        MLTK_KERNEL T l1(const T *a, const T *b, size_t dim, double bound) { \
+            return reduce<AbsDiff>(a, b, dim, bound); \
+        } \
+        MLTK_KERNEL T cosine(const T *a, const T *b, size_t dim) { \
+            return cosine(a, b, dim, reduce<Product>(a, a, dim, INF)); \
+        } \
+        MLTK_KERNEL T lorentzian(const T *a, const T *b, size_t dim) { \
+            return reduce<Lorentzian>(a, b, dim, INF); \
+        } \
+        MLTK_KERNEL T bhattacharyya(const T *a, const T *b, size_t dim) { \
+            return reduce<Bhattacharyya>(a, b, dim, INF); \
+        } \
+        MLTK_KERNEL T pearson(const T *a, const T *b, size_t dim) { \
+            return reduce<Pearson>(a, b, dim, INF); \
+        } \
+        MLTK_KERNEL T kullbackLeibler(const T *a, const T *b, size_t dim) { \
+            return reduce<KullbackLeibler>(a, b, dim, INF); \
+        } \
+        MLTK_KERNEL T hassanat(const T *a, const T *b, size_t dim, double bound) { \
+            return reduce<Hassanat>(a, b, dim, bound); \
+        } \
+        MLTK_KERNEL void squaredL2Batch(const T *q, const T *refs, size_t n, size_t dim, T *out) { \
+            reduceBatch<SquaredDiff>(q, refs, n, dim, out); \
+        } \
+        MLTK_KERNEL void l1Batch(const T *q, const T *refs, size_t n, size_t dim, T *out) { \
+            reduceBatch<AbsDiff>(q, refs, n, dim, out); \
+        } \
+        MLTK_KERNEL void cosineBatch(const T *q, const T *refs, size_t n, size_t dim, T *out) { \
+            T norm_q = reduce<Product>(q, q, dim, INF); \
+            for (size_t j = 0; j < n; j++) out[j] = cosine(q, refs + j * dim, dim, norm_q); \
+        } \
+        MLTK_KERNEL void lorentzianBatch(const T *q, const T *refs, size_t n, size_t dim, T *out) { \
+            reduceBatch<Lorentzian>(q, refs, n, dim, out); \
+        } \
+        MLTK_KERNEL void bhattacharyyaBatch(const T *q, const T *refs, size_t n, size_t dim, T *out) { \
+            reduceBatch<Bhattacharyya>(q, refs, n, dim, out); \
+        } \
+        MLTK_KERNEL void pearsonBatch(const T *q, const T *refs, size_t n, size_t dim, T *out) { \
+            reduceBatch<Pearson>(q, refs, n, dim, out); \
+        } \
+        MLTK_KERNEL void kullbackLeiblerBatch(const T *q, const T *refs, size_t n, size_t dim, T *out) { \
+            reduceBatch<KullbackLeibler>(q, refs, n, dim, out); \
+        } \
+        MLTK_KERNEL void hassanatBatch(const T *q, const T *refs, size_t n, size_t dim, T *out) { \
+            reduceBatch<Hassanat>(q, refs, n, dim, out); \
+        }
+
+        MLTK_DEFINE_KERNEL(double)
+        MLTK_DEFINE_KERNEL(float)
+#undef MLTK_DEFINE_KERNEL
+    }}}
+}
@@ -1,10 +1,13 @@
 #include "Kernel.hpp"
 
+#include <memory>
 #include <utility>
 
 namespace mltk{
     using namespace std;
 
+    std::shared_ptr<KernelCache> Kernel::default_cache = nullptr;
+
     Kernel::Kernel(int type, double param){
         this->type = type;
         this->param = param;
@@ -34,14 +37,47 @@ namespace mltk{
 
     void Kernel::setKernelMatrix(mltk::dMatrix _K){
         this->K = std::move(_K);
+        this->mapping.reset();
     }
 
     mltk::dMatrix Kernel::getKernelMatrix(){
-        return K;
+        return *getKernelMatrixPointer();
     }
 
     mltk::dMatrix* Kernel::getKernelMatrixPointer(){
+        if(mapping){
+            size_t size = mapping->getSize();
+
+            K.resize(size);
+            for(size_t i = 0; i < size; i++){
+                K[i].assign(mapping->row(i), mapping->row(i) + size);
+            }
+            mapping.reset();
+        }
         return &K;
     }
+
+    std::vector<const double*> Kernel::getKernelRows() const{
+        size_t size = (mapping) ? mapping->getSize() : K.size();
+        std::vector<const double*> rows(size);
+
+        for(size_t i = 0; i < size; i++){
+            rows[i] = (mapping) ? mapping->row(i) : K[i].data();
+        }
+        return rows;
+    }
+
+    void Kernel::setCache(std::shared_ptr<KernelCache> _cache){
+        this->cache = std::move(_cache);
+    }
+
+    void Kernel::setDefaultCache(std::shared_ptr<KernelCache> _cache){
+        // learners trained in parallel may be reading it
+        std::atomic_store(&default_cache, std::move(_cache));
+    }
+
+    std::shared_ptr<KernelCache> Kernel::getCache() const{
+        return (cache) ? cache : std::atomic_load(&default_cache);
+    }
 }
 
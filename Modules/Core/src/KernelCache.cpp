@@ -0,0 +1,207 @@
+/*! Kernel matrix disk cache
+   \brief Implementation of the persistent kernel matrix cache.
+   \file KernelCache.cpp
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include "KernelCache.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mltk{
+    namespace fs = std::filesystem;
+
+    static const char KERNEL_CACHE_MAGIC[8] = {'M', 'L', 'T', 'K', 'K', 'M', 'A', 'T'};
+    static const char *KERNEL_CACHE_EXT = ".kmat";
+
+    KernelCache::KernelCache(std::string _directory, size_t _max_size)
+            : directory(std::move(_directory)), max_size(_max_size) {
+        std::error_code ec;
+
+        fs::create_directories(directory, ec);
+        if(ec){
+            std::cerr << "Could not create the kernel cache directory " << directory << ": " << ec.message() << std::endl;
+        }
+    }
+
+    std::string KernelCache::filePath(uint64_t key) const {
+        std::ostringstream name;
+
+        name << std::hex << std::setw(16) << std::setfill('0') << key << KERNEL_CACHE_EXT;
+        return (fs::path(directory) / name.str()).string();
+    }
+
+    KernelCache::Mapping::~Mapping() {
+#if defined(__unix__) || defined(__APPLE__)
+        if(address) munmap(address, bytes);
+#endif
+    }
+
+    uint64_t KernelCache::fingerprint(uint64_t data_key, int type, double param) {
+        uint64_t hash = fnv1a(14695981039346656037ULL, &data_key, sizeof(data_key));
+        int64_t itype = type;
+
+        hash = fnv1a(hash, &itype, sizeof(itype));
+        return fnv1a(hash, &param, sizeof(param));
+    }
+
+    std::shared_ptr<const KernelCache::Mapping> KernelCache::map(uint64_t key, size_t size) const {
+        std::string path = filePath(key);
+        size_t bytes = sizeof(Header) + size * size * sizeof(double);
+        auto mapping = std::make_shared<Mapping>();
+        std::error_code ec;
+        const Header *header;
+
+        if(size == 0 || !fs::exists(path, ec) || fs::file_size(path, ec) != bytes) return nullptr;
+
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0) return nullptr;
+
+        void *address = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if(address == MAP_FAILED) return nullptr;
+
+        mapping->address = address;
+        mapping->bytes = bytes;
+        header = static_cast<const Header*>(address);
+        mapping->values = reinterpret_cast<const double*>(static_cast<const char*>(address) + sizeof(Header));
+#else
+        std::ifstream input(path, std::ios::binary);
+        Header read_header{};
+
+        mapping->buffer.resize(size * size);
+        if(!input.read(reinterpret_cast<char*>(&read_header), sizeof(Header)) ||
+           !input.read(reinterpret_cast<char*>(mapping->buffer.data()), size * size * sizeof(double))) return nullptr;
+        mapping->values = mapping->buffer.data();
+        header = &read_header;
+#endif
+        if(std::memcmp(header->magic, KERNEL_CACHE_MAGIC, sizeof(KERNEL_CACHE_MAGIC)) != 0 || header->key != key ||
+           header->rows != size || header->cols != size) return nullptr;
+        mapping->size = size;
+
+        // touch the file so the eviction policy sees it as recently used
+        fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+
+        return mapping;
+    }
+
+    bool KernelCache::load(uint64_t key, size_t size, dMatrix &K) const {
+        auto mapping = map(key, size);
+
+        if(!mapping) return false;
+        K.resize(size);
+        for(size_t i = 0; i < size; i++){
+            K[i].assign(mapping->row(i), mapping->row(i) + size);
+        }
+        return true;
+    }
+
+    bool KernelCache::store(uint64_t key, const dMatrix &K) {
+        size_t rows = K.size(), cols = (rows > 0) ? K[0].size() : 0;
+        size_t bytes = sizeof(Header) + rows * cols * sizeof(double);
+        std::string path = filePath(key), tmp_path;
+        std::error_code ec;
+        Header header{};
+
+        if(rows == 0 || bytes > max_size) return false;
+        std::lock_guard<std::mutex> guard(lock);
+        evictUnlocked(bytes);
+
+        std::memcpy(header.magic, KERNEL_CACHE_MAGIC, sizeof(KERNEL_CACHE_MAGIC));
+        header.key = key;
+        header.rows = rows;
+        header.cols = cols;
+        // each writer gets its own temporary file, the rename publishes complete matrices only
+#if defined(__unix__) || defined(__APPLE__)
+        std::vector<char> name(path.begin(), path.end());
+        const char suffix[] = ".XXXXXX";
+
+        name.insert(name.end(), suffix, suffix + sizeof(suffix));
+        int fd = mkstemp(name.data());
+        if(fd < 0) return false;
+        close(fd);
+        tmp_path = name.data();
+#else
+        std::random_device rd;
+        tmp_path = path + "." + std::to_string(rd()) + std::to_string(rd());
+#endif
+        {
+            std::ofstream output(tmp_path, std::ios::binary | std::ios::trunc);
+
+            if(output){
+                output.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+                for(auto const& row: K){
+                    output.write(reinterpret_cast<const char*>(row.data()), cols * sizeof(double));
+                }
+            }
+            if(!output){
+                output.close();
+                fs::remove(tmp_path, ec);
+                return false;
+            }
+        }
+        fs::rename(tmp_path, path, ec);
+        if(ec){
+            fs::remove(tmp_path, ec);
+            return false;
+        }
+        return true;
+    }
+
+    void KernelCache::evict(size_t incoming) {
+        std::lock_guard<std::mutex> guard(lock);
+
+        evictUnlocked(incoming);
+    }
+
+    void KernelCache::evictUnlocked(size_t incoming) {
+        std::vector<std::pair<fs::file_time_type, fs::path> > files;
+        std::error_code ec;
+        size_t used = 0;
+
+        for(auto const& entry: fs::directory_iterator(directory, ec)){
+            if(entry.path().extension() != KERNEL_CACHE_EXT) continue;
+            used += entry.file_size(ec);
+            files.emplace_back(entry.last_write_time(ec), entry.path());
+        }
+        if(used + incoming <= max_size) return;
+
+        std::sort(files.begin(), files.end());
+        for(auto const& file: files){
+            if(used + incoming <= max_size) break;
+            size_t fsize = fs::file_size(file.second, ec);
+            if(fs::remove(file.second, ec)) used -= fsize;
+        }
+    }
+
+    void KernelCache::clear() {
+        std::lock_guard<std::mutex> guard(lock);
+        std::error_code ec;
+
+        for(auto const& entry: fs::directory_iterator(directory, ec)){
+            if(entry.path().extension() == KERNEL_CACHE_EXT) fs::remove(entry.path(), ec);
+        }
+    }
+
+    size_t KernelCache::getUsedSize() const {
+        std::error_code ec;
+        size_t used = 0;
+
+        for(auto const& entry: fs::directory_iterator(directory, ec)){
+            if(entry.path().extension() == KERNEL_CACHE_EXT) used += entry.file_size(ec);
+        }
+        return used;
+    }
+}
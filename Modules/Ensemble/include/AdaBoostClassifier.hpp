@@ -43,10 +43,11 @@ namespace mltk {
                     learner->train();
                     // compute the probability of miss classification for each point
                     Point<double> errors(_size, 0.0);
+                    auto preds = learner->batchEvaluate(*this->samples);
                     for(size_t i = 0; i < _size; i++){
                         auto point = (*this->samples)[i];
 
-                        if(point->Y() != learner->evaluate(*point)) errors[i] = weights[i];
+                        if(point->Y() != preds[i]) errors[i] = weights[i];
                     }
                     // compute the estimator error as the weighted average of each point error
                     err[m] = mltk::dot(weights, errors)/weights.sum();
@@ -75,6 +76,28 @@ namespace mltk {
                 return classes[class_pos];
             }
 
+            std::vector<double> batchEvaluate(Data<T> &data, bool raw_value = false) override {
+                auto classes = this->samples->getClasses();
+                size_t i, size = data.getSize();
+                std::vector<std::vector<double> > prob(size, std::vector<double>(classes.size(), 0.0));
+                std::vector<double> preds(size);
+
+                // each estimator classifies all the points at once
+                for(size_t m = 0; m < n_estimators; m++) {
+                    auto estimator_preds = this->learners[m]->batchEvaluate(data);
+
+                    for(i = 0; i < size; i++) {
+                        for(size_t c = 0; c < classes.size(); c++) {
+                            if(estimator_preds[i] == classes[c]) prob[i][c] += this->_alpha[m];
+                        }
+                    }
+                }
+                for(i = 0; i < size; i++) {
+                    preds[i] = classes[std::max_element(prob[i].begin(), prob[i].end()) - prob[i].begin()];
+                }
+                return preds;
+            }
+
             std::string getFormulationString() override {
                 return this->learners[0]->getFormulationString();
             }
@@ -50,6 +50,27 @@ namespace mltk {
                 return classes[std::max_element(votes.X().begin(), votes.X().end()) - votes.X().begin()];
             }
 
+            std::vector<double> batchEvaluate(Data<T> &data, bool raw_value = false) override {
+                auto classes = this->samples->getClasses();
+                size_t j, size = data.getSize();
+                std::vector<std::vector<int> > votes(size, std::vector<int>(classes.size(), 0));
+                std::vector<double> preds(size);
+
+                // each estimator classifies all the points at once
+                for (size_t i = 0; i < n_estimators; i++) {
+                    auto estimator_preds = this->learners[i]->batchEvaluate(data);
+
+                    for (j = 0; j < size; j++) {
+                        size_t pred_pos = std::find(classes.begin(), classes.end(), int(estimator_preds[j])) - classes.begin();
+                        if (pred_pos < classes.size()) votes[j][pred_pos]++;
+                    }
+                }
+                for (j = 0; j < size; j++) {
+                    preds[j] = classes[std::max_element(votes[j].begin(), votes[j].end()) - votes[j].begin()];
+                }
+                return preds;
+            }
+
             std::string getFormulationString() override {
                 return this->learners[0]->getFormulationString();
             }
@@ -86,6 +86,31 @@ namespace mltk{
                 return _classes[max_votes];
             }
 
+            std::vector<double> batchEvaluate(Data<T> &data, bool raw_value = false) override {
+                auto _classes = this->samples->getClasses();
+                size_t j, size = data.getSize();
+                std::vector<std::vector<double> > votes(size, std::vector<double>(_classes.size(), 0.0));
+                std::vector<double> preds(size);
+
+                if (voting_type == "soft") {
+                    assert(this->weights.size() > 0);
+                }
+
+                // each learner classifies all the points at once
+                for (size_t i = 0; i < this->learners.size(); i++) {
+                    auto learner_preds = this->learners[i]->batchEvaluate(data);
+
+                    for (j = 0; j < size; j++) {
+                        size_t pred_pos = std::find(_classes.begin(), _classes.end(), learner_preds[j]) - _classes.begin();
+                        if (pred_pos < _classes.size()) votes[j][pred_pos] += (voting_type == "soft") ? this->weights[i] : 1.0;
+                    }
+                }
+                for (j = 0; j < size; j++) {
+                    preds[j] = _classes[std::max_element(votes[j].begin(), votes[j].end()) - votes[j].begin()];
+                }
+                return preds;
+            }
+
             void setWeights(const std::vector<double> weights) {
                 assert(weights.size() == this->learners.size());
                 this->weights.X().resize(weights.size());
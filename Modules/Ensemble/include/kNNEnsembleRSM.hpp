@@ -20,16 +20,16 @@ namespace ensemble {
             std::vector<std::vector<size_t>> subspaces;
         public:
             kNNEnsembleRSM() = default;
-            kNNEnsembleRSM(const Data<T> &samples, size_t _k, double _r): k(_k), r(_r) {
+            kNNEnsembleRSM(const Data<T> &samples, size_t _k, double _r, const std::string &algorithm = "auto"): k(_k), r(_r) {
                 this->samples = make_data<T>(samples);
                 this->learners.resize(7);
-                this->learners[0] = std::make_shared<classifier::KNNClassifier<T, metrics::dist::Euclidean<T>>>(k);
-                this->learners[1] = std::make_shared<classifier::KNNClassifier<T, metrics::dist::Lorentzian<T>>>(k);
-                this->learners[2] = std::make_shared<classifier::KNNClassifier<T, metrics::dist::Cosine<T>>>(k);
-                this->learners[3] = std::make_shared<classifier::KNNClassifier<T, metrics::dist::Bhattacharyya<T>>>(k);
-                this->learners[4] = std::make_shared<classifier::KNNClassifier<T, metrics::dist::Pearson<T>>>(k);
-                this->learners[5] = std::make_shared<classifier::KNNClassifier<T, metrics::dist::KullbackLeibler<T>>>(k);
-                this->learners[6] = std::make_shared<classifier::KNNClassifier<T, metrics::dist::Hassanat<T>>>(k);
+                this->learners[0] = std::make_shared<classifier::KNNClassifier<T, metrics::dist::Euclidean<T>>>(k, algorithm);
+                this->learners[1] = std::make_shared<classifier::KNNClassifier<T, metrics::dist::Lorentzian<T>>>(k, algorithm);
+                this->learners[2] = std::make_shared<classifier::KNNClassifier<T, metrics::dist::Cosine<T>>>(k, algorithm);
+                this->learners[3] = std::make_shared<classifier::KNNClassifier<T, metrics::dist::Bhattacharyya<T>>>(k, algorithm);
+                this->learners[4] = std::make_shared<classifier::KNNClassifier<T, metrics::dist::Pearson<T>>>(k, algorithm);
+                this->learners[5] = std::make_shared<classifier::KNNClassifier<T, metrics::dist::KullbackLeibler<T>>>(k, algorithm);
+                this->learners[6] = std::make_shared<classifier::KNNClassifier<T, metrics::dist::Hassanat<T>>>(k, algorithm);
 
                 RSM<double> rsm(r, this->samples->getDim(), this->seed);
                 size_t samp_size = this->samples->getSize() / this->learners.size();
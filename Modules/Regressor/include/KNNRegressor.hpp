@@ -4,6 +4,9 @@
 
 #include "PrimalRegressor.hpp"
 #include "DistanceMetric.hpp"
+#include "KDTree.hpp"
+#include "BallTree.hpp"
+#include "HNSW.hpp"
 #include <assert.h>
 
 namespace mltk{
@@ -18,16 +21,55 @@ namespace mltk{
                 size_t k;
                 /// Function to compute the metrics between two points
                 Callable dist_function;
+                /// Search algorithm: "brute", "kdtree", "balltree", "hnsw" or "auto", see classifier::KNNClassifier.
+                std::string algorithm;
+                metrics::KDTree<T, Callable> kdtree;
+                metrics::BallTree<T, Callable> balltree;
+                metrics::HNSW<T, Callable> hnsw;
+                /// Maximum number of points in the leaves of the trees.
+                size_t leaf_size = 40;
+
+                void clearIndexes() {
+                    kdtree.clear();
+                    balltree.clear();
+                    hnsw.clear();
+                }
             public:
                 KNNRegressor(std::shared_ptr<Data < T>
 
                 > _samples,
                 size_t _k, Callable
-                dist_func = Callable()
+                dist_func = Callable(), std::string _algorithm = "brute"
                 )
                 :
 
-                PrimalRegressor<T> (_samples), k(_k), dist_function(dist_func) {}
+                PrimalRegressor<T> (_samples), k(_k), dist_function(dist_func), algorithm(_algorithm) {}
+
+                /**
+                 * \brief Set the maximum number of points in the leaves of the KD-tree and ball tree.
+                 * \param _leaf_size Leaf size, 40 is the default.
+                 */
+                void setLeafSize(size_t _leaf_size) { this->leaf_size = _leaf_size; }
+
+                /**
+                 * \brief HNSW graph used by the "hnsw" algorithm, see classifier::KNNClassifier::hnswIndex.
+                 * \return metrics::HNSW<T, Callable>&
+                 */
+                metrics::HNSW<T, Callable> &hnswIndex() { return hnsw; }
+
+                /**
+                 * \brief Set the samples, the indexes built by train are dropped, so the queries use brute force
+                 * until the next train.
+                 */
+                void setSamples(const Data<T> &samples) override {
+                    PrimalRegressor<T>::setSamples(samples);
+                    clearIndexes();
+                }
+
+                void setSamples(DataPointer<T> samples) override {
+                    PrimalRegressor<T>::setSamples(samples);
+                    clearIndexes();
+                }
 
                 bool train() override;
 
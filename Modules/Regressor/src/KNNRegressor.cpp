@@ -1,5 +1,7 @@
 #include "KNNRegressor.hpp"
 #include <memory>
+#include <limits>
+#include <algorithm>
 
 namespace mltk{
     namespace regressor {
@@ -10,35 +12,70 @@ namespace mltk{
 
         template<typename T, typename Callable>
         double KNNRegressor<T, Callable>::evaluate(const Point<T> &p, bool raw_value) {
-            auto points = this->samples->getPoints();
-            std::vector<double> distances(this->samples->getSize());
-            std::vector<int> classes = this->samples->getClasses();
-            std::vector<size_t> idx(distances.size()), freq(classes.size());
-            auto p0 = std::make_shared<Point<T> >(p);
-            // fill the index vector
-            std::iota(idx.begin(), idx.end(), 0);
-
-            // compute the metrics from the sample to be evaluated to the samples vector
-            std::transform(points.begin(), points.end(), distances.begin(),
-                           [p0, this](const std::shared_ptr<Point<T> > q) {
-                               return this->dist_function(*p0, *q);
-                           });
-            // sort the index vector by the metrics from the sample to be evaluated
-            std::stable_sort(idx.begin(), idx.end(), [&distances](size_t i1, size_t i2) {
-                return distances[i1] < distances[i2];
-            });
+            size_t n = this->samples->getSize();
+
+            if (n > 0 && (kdtree.size() == n || balltree.size() == n || (algorithm == "hnsw" && hnsw.size() == n))) {
+                std::vector<std::pair<double, size_t> > neighbors;
+                double sum = 0.0;
+
+                if (kdtree.size() == n) kdtree.kNearest(p, this->k, neighbors);
+                else if (balltree.size() == n) balltree.kNearest(p, this->k, neighbors);
+                else hnsw.kNearest(p, this->k, neighbors);
+                for (auto const &neighbor: neighbors) sum += (*this->samples)[neighbor.second]->Y();
+                // the index may return fewer than k neighbors, the average is over the ones found
+                return neighbors.empty() ? 0.0 : sum / neighbors.size();
+            }
+
+            std::vector<std::pair<double, size_t> > heap;
+            size_t _k = std::min(this->k, n);
+
+            // bounded max-heap with the k smallest (distance, index) pairs, the same neighbors as a stable sort
+            // by distance, once it's full the distances stop early when they can't enter it
+            for (size_t j = 0; j < n; ++j) {
+                double bound = (heap.empty() || heap.size() < _k) ? std::numeric_limits<double>::infinity() :
+                               heap.front().first;
+                double d = metrics::dist::boundedDistance(dist_function, p, *(*this->samples)[j], bound);
+
+                if (heap.size() < _k) {
+                    heap.emplace_back(d, j);
+                    std::push_heap(heap.begin(), heap.end());
+                } else if (_k > 0 && d < heap.front().first) {
+                    std::pop_heap(heap.begin(), heap.end());
+                    heap.back() = std::make_pair(d, j);
+                    std::push_heap(heap.begin(), heap.end());
+                }
+            }
+            std::sort_heap(heap.begin(), heap.end());
 
             double sum = 0.0;
 
-            // sum the values in the k nearest neighbors and return the average
-            for (size_t j = 0; j < this->k; j++) {
-                sum += points[idx[j]]->Y();
+            // sum the values in the k nearest neighbors and return the average, over fewer than k neighbors if
+            // there are fewer samples, and 0 without samples
+            for (auto const &neighbor: heap) {
+                sum += (*this->samples)[neighbor.second]->Y();
             }
-            return sum / this->k;
+            return heap.empty() ? 0.0 : sum / heap.size();
         }
 
         template<typename T, typename Callable>
         bool KNNRegressor<T, Callable>::train() {
+            bool kd = metrics::KDTree<T, Callable>::supportsMetric() && this->samples->getDim() <= 16;
+
+            kdtree.clear();
+            balltree.clear();
+            if (algorithm == "hnsw") {
+                hnsw.metric() = dist_function;
+                return hnsw.build(*this->samples);
+            }
+            if (algorithm == "kdtree" || (algorithm == "auto" && kd)) {
+                kdtree.setLeafSize(leaf_size);
+                return kdtree.build(*this->samples);
+            }
+            if (algorithm == "balltree" || (algorithm == "auto" && metrics::dist::IsTrueMetric<Callable>::value)) {
+                balltree.metric() = dist_function;
+                balltree.setLeafSize(leaf_size);
+                return balltree.build(*this->samples);
+            }
             return true;
         }
 
@@ -9,6 +9,7 @@
 
 #include "Classifier.hpp"
 #include "DualClassifier.hpp"
+#include "SMO.hpp"
 #include "Data.hpp"
 #include "Solution.hpp"
 
@@ -68,9 +69,10 @@ namespace mltk{
             size_t size = samples.getSize(), i, j, idp, idy, n_classes = classes.size();
             std::vector<std::vector<size_t> > confusion_m(n_classes, std::vector<size_t>(n_classes, 0));
             double acc = 0.0;
+            auto preds = learner.batchEvaluate(samples);
 
             for(i = 0; i < size; i++){
-                int pred = learner.evaluate(*(samples[i]));
+                int pred = preds[i];
                 for(j = 0, idp = 0, idy = 0; j < n_classes; j++){
                     if(classes[j] == pred){
                         idp = j;
@@ -178,9 +180,10 @@ namespace mltk{
                     }
 
                     size_t i = 0;
+                    auto preds = classifier.batchEvaluate(_test_sample);
                     for(auto it = _test_sample.begin(); it != _test_sample.end(); it++, i++){
                         auto point = (*it);
-                        double _y = classifier.evaluate(*point);
+                        double _y = preds[i];
 
                         if(point->Y() != _y){
                             if(verbose > 1)
@@ -206,9 +209,10 @@ namespace mltk{
                     }
 
                     size_t i = 0;
+                    auto preds = classifier.batchEvaluate(_test_sample);
                     for(auto it = _test_sample.begin(); it != _test_sample.end(); it++, i++){
                         auto point = (*it);
-                        double _y = classifier.evaluate(*point);
+                        double _y = preds[i];
 
                         if(point->Y() != _y){
                             if(verbose > 1)
@@ -305,9 +309,10 @@ namespace mltk{
                 bias = s.bias;
 
                 i = 0;
+                auto preds = classifier.batchEvaluate(valid_pair.test);
                 for(auto it = valid_pair.test.begin(); it != valid_pair.test.end(); it++, i++){
                     auto point = (*it);
-                    double _y = classifier.evaluate(*point);
+                    double _y = preds[i];
 
                     if(point->Y() != _y){
                         if(verbose > 1)
@@ -336,9 +341,10 @@ namespace mltk{
                 }
 
                 size_t i = 0;
+                auto preds = dual->batchEvaluate(valid_pair.test);
                 for(auto it = valid_pair.test.begin(); it != valid_pair.test.end(); it++, i++){
                     auto point = (*it);
-                    double _y = dual->evaluate(*point);
+                    double _y = preds[i];
 
                     if(point->Y() != _y){
                         if(verbose > 1)
@@ -359,6 +365,84 @@ namespace mltk{
 
             return solution;
         }
+
+        /**
+         * @brief Executes several executions of the k fold cross-validation over a regularization path. In each fold
+         * the SMO is trained with SMO::regularizationPath, every value of C warm-started from the previous one, and
+         * each solution of the path is evaluated on the test fold.
+         * @param Cs Values of C, in the order of the path (increasing values make the warm starts shorter).
+         * @param qtde Number of executions.
+         * @param fold Number of folds.
+         * @return std::vector<ValidationSolution> Cross-validation results for each value of C.
+         */
+        template <typename T>
+        std::vector<ValidationSolution> kkfold(Data<T> &samples, classifier::SMO<T> &smo, const std::vector<double> &Cs,
+                                               const size_t &qtde, const size_t &fold, const size_t &seed = 0,
+                                               const int &verbose = 0){
+            auto classes = samples.getClasses();
+            std::vector<ValidationSolution> solutions(Cs.size());
+            std::vector<double> errors(Cs.size(), 0.0);
+            // the folds train from zero, the warm start of the caller is given back at the end
+            typename classifier::SMO<T>::WarmStartGuard guard(smo);
+
+            smo.clearInitialSolution();
+            for(size_t r = 0; r < qtde; r++){
+                samples.shuffle(seed + r);
+                std::vector<Data< T > > folds = samples.splitSample(fold, seed + r);
+
+                for(size_t j = 0; j < fold; j++){
+                    auto &test = folds[j];
+                    auto train = mltk::make_data< T >();
+
+                    for(size_t i = 0; i < fold; i++){
+                        if(i == j) continue;
+                        for(auto it = folds[i].begin(); it != folds[i].end(); it++) train->insertPoint(*it);
+                    }
+                    train->setClasses(classes);
+                    smo.setSamples(train);
+                    smo.setSeed(seed + r);
+                    smo.regularizationPath(Cs, [&](size_t c){
+                        auto preds = smo.batchEvaluate(test);
+                        size_t fp = 0, fn = 0, tp = 0, tn = 0, erro = 0;
+
+                        for(size_t i = 0; i < test.getSize(); i++){
+                            if(test[i]->Y() != preds[i]){
+                                erro++;
+                                if(classes.size() == 2 && test[i]->Y() == -1) fp++; else fn++;
+                            }else{
+                                if(classes.size() == 2 && test[i]->Y() == -1) tn++; else tp++;
+                            }
+                        }
+                        errors[c] += ((double)erro/(double)test.getSize())*100.0;
+                        if(classes.size() == 2){
+                            // a fold without positive predictions counts as zero precision
+                            if(tp + fp > 0) solutions[c].precision += (double)tp/(double)(tp + fp);
+                            if(tp + fn > 0) solutions[c].recall += (double)tp/(double)(tp + fn);
+                            if(tn + fp > 0) solutions[c].tnrate += (double)tn/(double)(tn + fp);
+                            solutions[c].falseNegative += fn;
+                            solutions[c].falsePositive += fp;
+                            solutions[c].trueNegative += tn;
+                            solutions[c].truePositive += tp;
+                        }
+                        if(verbose) std::cout << "Execution " << r + 1 << ", fold " << j + 1 << ", C = " << Cs[c]
+                                              << ": " << erro << " errors\n";
+                    });
+                }
+            }
+            for(size_t c = 0; c < Cs.size() && qtde > 0 && fold > 0; c++){
+                solutions[c].accuracy = 100.0 - errors[c]/(qtde*fold);
+                solutions[c].precision /= qtde*fold;
+                solutions[c].recall /= qtde*fold;
+                solutions[c].tnrate /= qtde*fold;
+                solutions[c].falseNegative /= qtde*fold;
+                solutions[c].falsePositive /= qtde*fold;
+                solutions[c].trueNegative /= qtde*fold;
+                solutions[c].truePositive /= qtde*fold;
+                if(verbose) std::cout << "C = " << Cs[c] << ": " << fold << "-Fold Cross Validation accuracy "
+                                      << solutions[c].accuracy << "%\n";
+            }
+            return solutions;
+        }
     }
 }
 #endif
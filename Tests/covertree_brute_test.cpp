@@ -0,0 +1,126 @@
+//
+// Checks the neighbors found by the cover tree, built by insertions or at once, single and batch queries, against
+// brute force, with duplicated points and k larger than the number of points.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <set>
+#include "../Modules/Core/Core.hpp"
+#include "test_data.hpp"
+
+using namespace mltk;
+
+using PointPtr = std::shared_ptr<Point<double>>;
+using Tree = metrics::CoverTree<double, PointPtr, metrics::dist::Euclidean<double>>;
+
+/// Points in a few clusters, every fifth point is a copy of an earlier one, in another point object.
+std::vector<PointPtr> make_points(size_t n, size_t dim, unsigned seed){
+    std::mt19937 gen(seed);
+    auto noise = test_data::normal();
+    auto clusters = [](size_t i, Point<double>& p, std::mt19937&){
+        for(size_t d = 0; d < p.size(); d++) p[d] += 4.0 * (i % 3);
+        return 0.0;
+    };
+    std::vector<PointPtr> points;
+
+    for(size_t i = 0; i < n; i++){
+        if(i > 0 && i % 5 == 0) points.push_back(std::make_shared<Point<double>>(*points[gen() % i]));
+        else points.push_back(test_data::make_sample(gen, i, dim, noise, clusters));
+    }
+    return points;
+}
+
+/// Number of queries whose neighbors are not the brute force ones: the first min(k, n) points returned must
+/// be distinct points of the data at the sorted brute force distances.
+int compare(const std::string& name, const std::vector<PointPtr>& points, const std::vector<PointPtr>& queries,
+            const std::vector<std::vector<PointPtr>>& found, size_t k){
+    metrics::dist::Euclidean<double> metric;
+    std::set<Point<double>*> in_data;
+    int errors = 0;
+
+    for(auto const& p: points) in_data.insert(p.get());
+    for(size_t i = 0; i < queries.size(); i++){
+        size_t _k = std::min(k, points.size());
+        std::vector<double> expected;
+        std::set<Point<double>*> returned;
+        bool same = found[i].size() >= _k;
+
+        for(auto const& p: points) expected.push_back(metric(*queries[i], *p));
+        std::sort(expected.begin(), expected.end());
+        for(size_t r = 0; same && r < found[i].size(); r++){
+            same = in_data.count(found[i][r].get()) > 0 && returned.insert(found[i][r].get()).second;
+            if(same && r < _k){
+                double d = metric(*queries[i], *found[i][r]);
+                same = std::fabs(d - expected[r]) <= 1e-9 * (1 + expected[r]);
+            }
+        }
+        if(!same) errors++;
+    }
+    if(errors > 0) std::cerr << name << " k=" << k << ": " << errors << " queries differ from brute force." << std::endl;
+    return errors;
+}
+
+int main(int argc, char* argv[]){
+    int errors = 0;
+    auto points = make_points(1500, 4, 1), queries = make_points(150, 4, 2);
+    // queries on top of points of the tree, duplicated ones included
+    for(size_t i = 0; i < 50; i++) queries.push_back(points[i * 7]);
+
+    Tree inserted;
+    for(auto const& p: points) inserted.insert(p);
+    if(!inserted.isValidTree()){
+        std::cerr << "The cover tree built by insertions is not valid." << std::endl;
+        errors++;
+    }
+
+    for(size_t k: {1, 5, 20, 1600}){
+        std::vector<std::vector<PointPtr>> found;
+
+        for(auto const& q: queries) found.push_back(inserted.kNearestNeighbors(q, k));
+        errors += compare("inserted", points, queries, found, k);
+    }
+
+    // the tree still answers as brute force after removing points
+    std::vector<PointPtr> kept;
+    for(size_t i = 0; i < points.size(); i++){
+        if(i % 4 == 1) inserted.remove(points[i]);
+        else kept.push_back(points[i]);
+    }
+    for(size_t k: {3, 1600}){
+        std::vector<std::vector<PointPtr>> found;
+
+        for(auto const& q: queries) found.push_back(inserted.kNearestNeighbors(q, k));
+        errors += compare("after remove", kept, queries, found, k);
+    }
+
+    // bulk build and batch queries, which run in parallel. The bulk build only keeps the separation invariant
+    // among siblings, so isValidTree doesn't apply, the queries must still be exact.
+    Tree built(points);
+    for(size_t k: {1, 5, 20, 1600}){
+        auto found = built.kNearestNeighbors(queries, k);
+        bool same_as_single = found.size() == queries.size();
+
+        errors += compare("bulk built", points, queries, found, k);
+        for(size_t i = 0; same_as_single && i < queries.size(); i++)
+            same_as_single = found[i] == built.kNearestNeighbors(queries[i], k);
+        if(!same_as_single){
+            std::cerr << "The batch queries differ from the single queries at k=" << k << "." << std::endl;
+            errors++;
+        }
+    }
+    // insertions after the bulk build
+    auto more = make_points(300, 4, 3);
+    std::vector<PointPtr> all = points;
+    for(auto const& p: more){
+        built.insert(p);
+        all.push_back(p);
+    }
+    errors += compare("bulk built and inserted", all, queries, built.kNearestNeighbors(queries, 10), 10);
+
+    if(errors > 0) return 1;
+    std::cout << "The cover tree matches brute force." << std::endl;
+    return 0;
+}
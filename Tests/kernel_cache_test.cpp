@@ -0,0 +1,161 @@
+//
+// Checks the disk cache of kernel matrices: a stored matrix is loaded back unchanged, other data or kernel
+// parameters miss, truncated or corrupted files are rejected and the least recently used matrices are evicted
+// when the cache is over its size.
+//
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include "../Modules/Core/Core.hpp"
+#include "test_data.hpp"
+
+using namespace mltk;
+namespace fs = std::filesystem;
+
+/// Standard normal points labeled -1 and 1 in turn.
+Data<double> make_samples(size_t n, size_t dim, unsigned seed){
+    return test_data::make_samples(n, dim, seed, test_data::normal(), test_data::classes_by_index(2));
+}
+
+dMatrix gaussian_matrix(Data<double>& data, double gamma){
+    size_t n = data.getSize();
+    dMatrix K(n, std::vector<double>(n));
+    Kernel kernel(GAUSSIAN, gamma);
+
+    for(size_t i = 0; i < n; i++)
+        for(size_t j = 0; j < n; j++) K[i][j] = kernel.function(*data[i], *data[j], data.getDim());
+    return K;
+}
+
+/// File of a cached matrix, named after its fingerprint in hexadecimal.
+std::string cache_file(const KernelCache& cache, uint64_t key){
+    std::ostringstream name;
+
+    name << std::hex << std::setw(16) << std::setfill('0') << key << ".kmat";
+    return (fs::path(cache.getDirectory()) / name.str()).string();
+}
+
+int main(int argc, char* argv[]){
+    const double gamma = 0.5;
+    auto directory = fs::temp_directory_path() / ("mltk_kernel_cache_test_" + std::to_string(std::random_device()()));
+    Data<double> data = make_samples(40, 5, 1);
+    dMatrix K = gaussian_matrix(data, gamma), loaded;
+    size_t n = data.getSize(), matrix_bytes = sizeof(KernelCache::Header) + n * n * sizeof(double);
+    int errors = 0;
+    KernelCache cache(directory.string());
+
+    // round trip, through a copy in memory and through the mapping
+    uint64_t key = KernelCache::fingerprint(data, GAUSSIAN, gamma);
+    if(!cache.store(key, K)){
+        std::cerr << "The kernel matrix wasn't stored." << std::endl;
+        errors++;
+    }
+    if(!cache.load(key, n, loaded) || loaded != K){
+        std::cerr << "The loaded kernel matrix differs from the stored one." << std::endl;
+        errors++;
+    }
+    auto mapping = cache.map(key, n);
+    for(size_t i = 0; mapping && i < n; i++)
+        if(!std::equal(K[i].begin(), K[i].end(), mapping->row(i))){
+            std::cerr << "The mapped kernel matrix differs from the stored one." << std::endl;
+            errors++;
+            break;
+        }
+    if(!mapping){
+        std::cerr << "The kernel matrix couldn't be mapped." << std::endl;
+        errors++;
+    }
+    mapping = nullptr;
+
+    // another kernel parameter, kernel type or data value must miss
+    Data<double> same = make_samples(40, 5, 1), changed = make_samples(40, 5, 1);
+    (*changed[7])[3] += 1e-9;
+    uint64_t other_param = KernelCache::fingerprint(data, GAUSSIAN, gamma * 2);
+    uint64_t other_type = KernelCache::fingerprint(data, POLYNOMIAL, gamma);
+    uint64_t other_data = KernelCache::fingerprint(changed, GAUSSIAN, gamma);
+    if(KernelCache::fingerprint(same, GAUSSIAN, gamma) != key){
+        std::cerr << "The fingerprint of equal data changed." << std::endl;
+        errors++;
+    }
+    for(uint64_t miss: {other_param, other_type, other_data}){
+        if(miss == key || cache.load(miss, n, loaded) || cache.map(miss, n)){
+            std::cerr << "A kernel matrix was found for other data or kernel parameters." << std::endl;
+            errors++;
+        }
+    }
+    if(cache.load(key, n + 1, loaded)){
+        std::cerr << "A kernel matrix was loaded with the wrong size." << std::endl;
+        errors++;
+    }
+
+    // truncated file
+    std::string path = cache_file(cache, key);
+    fs::resize_file(path, matrix_bytes - sizeof(double));
+    if(cache.load(key, n, loaded) || cache.map(key, n)){
+        std::cerr << "A truncated kernel matrix file was accepted." << std::endl;
+        errors++;
+    }
+
+    // corrupted magic and key, with the right file size
+    for(size_t offset: {size_t(0), offsetof(KernelCache::Header, key)}){
+        cache.store(key, K);
+        {
+            std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+            char byte;
+            file.seekg(offset);
+            file.read(&byte, 1);
+            byte ^= 0x5a;
+            file.seekp(offset);
+            file.write(&byte, 1);
+        }
+        if(fs::file_size(path) != matrix_bytes || cache.load(key, n, loaded) || cache.map(key, n)){
+            std::cerr << "A corrupted kernel matrix file was accepted." << std::endl;
+            errors++;
+        }
+    }
+
+    // eviction: room for two matrices, the least recently used one goes when a third is stored
+    cache.clear();
+    cache.setMaxSize(2 * matrix_bytes + matrix_bytes / 2);
+    std::vector<uint64_t> keys;
+    auto now = fs::file_time_type::clock::now();
+    for(int i = 0; i < 2; i++){
+        keys.push_back(KernelCache::fingerprint(data, GAUSSIAN, gamma + i));
+        cache.store(keys.back(), K);
+        // explicit times, the clock of the file system may not tell the stores apart
+        fs::last_write_time(cache_file(cache, keys.back()), now - std::chrono::hours(2 - i));
+    }
+    keys.push_back(KernelCache::fingerprint(data, GAUSSIAN, gamma + 2));
+    cache.store(keys.back(), K);
+    if(cache.load(keys[0], n, loaded) || !cache.load(keys[1], n, loaded) || !cache.load(keys[2], n, loaded)){
+        std::cerr << "The least recently used kernel matrix wasn't the one evicted." << std::endl;
+        errors++;
+    }
+    if(cache.getUsedSize() > cache.getMaxSize()){
+        std::cerr << "The kernel cache uses more than its size: " << cache.getUsedSize() << std::endl;
+        errors++;
+    }
+    cache.setMaxSize(matrix_bytes);
+    if(cache.getUsedSize() > matrix_bytes){
+        std::cerr << "The kernel cache wasn't evicted when its size was reduced." << std::endl;
+        errors++;
+    }
+    Data<double> larger = make_samples(60, 5, 2);
+    if(cache.store(key, gaussian_matrix(larger, gamma))){
+        std::cerr << "A kernel matrix larger than the cache was stored." << std::endl;
+        errors++;
+    }
+
+    cache.clear();
+    fs::remove_all(directory);
+
+    if(errors > 0) return 1;
+    std::cout << "The kernel cache stores, rejects and evicts matrices as expected." << std::endl;
+    return 0;
+}
@@ -0,0 +1,76 @@
+//
+// Checks that KNNClassifier::batchEvaluate predicts the same classes as evaluate, and that the bounded Chebyshev
+// distance is exact below its bound.
+//
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include "../Modules/Core/Core.hpp"
+#include "../Modules/Classifier/Classifier.hpp"
+#include "test_data.hpp"
+
+using namespace mltk;
+
+/// Three blobs labeled 1 to 3, each one moved along its own features.
+Data<double> make_blobs(size_t n, size_t dim, unsigned seed){
+    auto shift = [](int label, size_t d){ return 2.0 * label * ((d % 3) == size_t(label - 1)); };
+
+    return test_data::make_samples(n, dim, seed, test_data::normal(), test_data::classes_by_index(3, shift));
+}
+
+template<typename Callable>
+int compare(const std::string& name, Data<double>& train, Data<double>& test, size_t k){
+    classifier::KNNClassifier<double, Callable> knn(train, k);
+    knn.train();
+    auto predictions = knn.batchEvaluate(test);
+    int errors = 0;
+
+    for(size_t i = 0; i < test.getSize(); i++){
+        if(predictions[i] != knn.evaluate(*test[i])) errors++;
+    }
+    if(errors > 0) std::cerr << name << " k=" << k << ": " << errors << " predictions differ." << std::endl;
+    return errors;
+}
+
+int main(int argc, char* argv[]){
+    int errors = 0;
+    Data<double> train = make_blobs(700, 9, 1), test = make_blobs(300, 9, 2);
+
+    for(size_t k: {1, 5, 16}){
+        errors += compare<metrics::dist::Euclidean<double>>("Euclidean", train, test, k);
+        errors += compare<metrics::dist::SquaredEuclidean<double>>("SquaredEuclidean", train, test, k);
+        errors += compare<metrics::dist::Cosine<double>>("Cosine", train, test, k);
+        errors += compare<metrics::dist::Manhattan<double>>("Manhattan", train, test, k);
+        errors += compare<metrics::dist::Lorentzian<double>>("Lorentzian", train, test, k);
+        errors += compare<metrics::dist::Chebyshev<double>>("Chebyshev", train, test, k);
+        errors += compare<test_data::PlainManhattan>("user metric", train, test, k);
+    }
+
+    // fewer finite distances than k: most training points have a NaN feature, one is the zero vector
+    Data<double> partial = make_blobs(40, 4, 3), queries = make_blobs(20, 4, 4);
+    for(size_t i = 4; i < partial.getSize(); i++) (*partial[i])[0] = std::nan("");
+    for(size_t d = 0; d < 4; d++) (*partial[0])[d] = 0.0;
+    for(size_t d = 0; d < 4; d++) (*queries[0])[d] = 0.0;
+    for(size_t k: {3, 7}){
+        errors += compare<metrics::dist::Euclidean<double>>("Euclidean with NaN", partial, queries, k);
+        errors += compare<metrics::dist::Cosine<double>>("Cosine with NaN", partial, queries, k);
+        errors += compare<metrics::dist::Manhattan<double>>("Manhattan with NaN", partial, queries, k);
+    }
+
+    // below the bound the bounded distance is the exact one, identical points are at zero
+    metrics::dist::Chebyshev<double> chebyshev;
+    int bounded_errors = 0;
+    for(size_t i = 0; i < test.getSize(); i++){
+        double exact = chebyshev(*test[i], *train[i]);
+        if(chebyshev(*test[i], *test[i], 1.0) != 0.0 || chebyshev(*test[i], *train[i], exact + 1.0) != exact)
+            bounded_errors++;
+    }
+    if(bounded_errors > 0)
+        std::cerr << "Chebyshev: " << bounded_errors << " bounded distances differ from the exact ones." << std::endl;
+    errors += bounded_errors;
+
+    if(errors > 0) return 1;
+    std::cout << "batchEvaluate matches evaluate." << std::endl;
+    return 0;
+}
@@ -0,0 +1,231 @@
+//
+// Checks the neighbors found by the KD-tree, the ball tree and the HNSW graph against brute force, and that the
+// kNN learners don't query an index built for other samples.
+//
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include "../Modules/Core/Core.hpp"
+#include "../Modules/Classifier/Classifier.hpp"
+#include "../Modules/Regressor/include/KNNRegressor.hpp"
+#include "test_data.hpp"
+
+using namespace mltk;
+
+/// Uniform points in [-1, 1)^dim labeled by the sign of the first feature.
+Data<double> make_uniform(size_t n, size_t dim, unsigned seed){
+    return test_data::make_samples(n, dim, seed, test_data::uniform(-1.0, 1.0), test_data::sign_of_first);
+}
+
+/// Distances of the k nearest neighbors of q, sorted, by brute force.
+template<typename Callable>
+std::vector<double> brute_distances(const Data<double>& data, const Point<double>& q, size_t k){
+    Callable metric;
+    std::vector<double> dists;
+
+    for(size_t j = 0; j < data.getSize(); j++) dists.push_back(metric(q, *data[j]));
+    std::sort(dists.begin(), dists.end());
+    dists.resize(std::min(k, dists.size()));
+    return dists;
+}
+
+/// Number of queries whose neighbors are not at the same distances as the brute force neighbors.
+template<typename Index, typename Callable>
+int compare(const std::string& name, Index& index, const Data<double>& data, const Data<double>& queries, size_t k){
+    int errors = 0;
+
+    index.build(data);
+    for(size_t i = 0; i < queries.getSize(); i++){
+        auto expected = brute_distances<Callable>(data, *queries[i], k);
+        auto neighbors = index.kNearestNeighbors(*queries[i], k);
+        bool same = neighbors.size() == expected.size();
+
+        for(size_t r = 0; same && r < neighbors.size(); r++){
+            Callable metric;
+            double d = metric(*queries[i], *data[neighbors[r].second]);
+            same = std::fabs(d - expected[r]) <= 1e-9 * (1 + expected[r]) &&
+                   std::fabs(neighbors[r].first - d) <= 1e-9 * (1 + d);
+        }
+        if(!same) errors++;
+    }
+    if(errors > 0) std::cerr << name << " k=" << k << ": " << errors << " queries differ from brute force." << std::endl;
+    return errors;
+}
+
+/// Fraction of the brute force k nearest neighbors found by the HNSW graph.
+template<typename Callable>
+double recall(const metrics::HNSW<double, Callable>& hnsw, const Data<double>& data, const Data<double>& queries,
+              size_t k){
+    size_t found = 0;
+
+    for(size_t i = 0; i < queries.getSize(); i++){
+        auto expected = brute_distances<Callable>(data, *queries[i], k);
+        auto neighbors = hnsw.kNearestNeighbors(*queries[i], k);
+
+        // the neighbors closer than the k-th brute force distance are true neighbors
+        for(auto const& neighbor: neighbors) found += neighbor.first <= expected.back() * (1 + 1e-9);
+    }
+    return double(found) / (queries.getSize() * std::min(k, data.getSize()));
+}
+
+void write_bytes(const std::string& path, const std::vector<char>& bytes){
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    output.write(bytes.data(), bytes.size());
+}
+
+/// Load of the HNSW graphs saved in files, valid or corrupted.
+int check_hnsw_files(const Data<double>& data, const Data<double>& queries){
+    const std::string path = "hnsw_test_graph.bin";
+    metrics::HNSW<double> hnsw(data), loaded;
+    int errors = 0;
+
+    hnsw.setEfSearch(64);
+    if(!hnsw.save(path) || !loaded.load(path)){
+        std::cerr << "Could not save and load the HNSW graph." << std::endl;
+        return 1;
+    }
+    auto same_answers = [&](const metrics::HNSW<double>& other){
+        for(size_t i = 0; i < queries.getSize(); i++)
+            if(other.kNearestNeighbors(*queries[i], 5) != hnsw.kNearestNeighbors(*queries[i], 5)) return false;
+        return true;
+    };
+    if(!same_answers(loaded)){
+        std::cerr << "The loaded HNSW graph gives other neighbors." << std::endl;
+        errors++;
+    }
+
+    std::ifstream input(path, std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    input.close();
+    const size_t entry_offset = 8 + 5 * sizeof(uint64_t);
+    std::vector<std::vector<char> > corrupted(3, bytes);
+    uint64_t bad = data.getSize() + 5;
+
+    // entry point out of the graph, last link out of the graph, truncated file
+    std::memcpy(corrupted[0].data() + entry_offset, &bad, sizeof(uint64_t));
+    std::memcpy(corrupted[1].data() + bytes.size() - sizeof(uint64_t), &bad, sizeof(uint64_t));
+    corrupted[2].resize(bytes.size() / 2);
+    for(size_t c = 0; c < corrupted.size(); c++){
+        write_bytes(path, corrupted[c]);
+        if(loaded.load(path)){
+            std::cerr << "Corrupted HNSW file " << c << " was loaded." << std::endl;
+            errors++;
+        }else if(loaded.size() != data.getSize() || !same_answers(loaded)){
+            std::cerr << "A rejected HNSW file changed the graph." << std::endl;
+            errors++;
+        }
+    }
+    std::remove(path.c_str());
+
+    // a query of another dimension finds nothing
+    auto wrong = make_point<double>(data.getDim() + 1);
+    if(!hnsw.kNearestNeighbors(*wrong, 5).empty()){
+        std::cerr << "The HNSW graph answered a query of another dimension." << std::endl;
+        errors++;
+    }
+    return errors;
+}
+
+int main(int argc, char* argv[]){
+    int errors = 0;
+    Data<double> data = make_uniform(2000, 5, 1), queries = make_uniform(200, 5, 2);
+
+    for(size_t k: {1, 7, 2500}){
+        metrics::KDTree<double, metrics::dist::Euclidean<double>> kd_euclidean;
+        metrics::KDTree<double, metrics::dist::Manhattan<double>> kd_manhattan;
+        metrics::KDTree<double, metrics::dist::Chebyshev<double>> kd_chebyshev;
+        metrics::BallTree<double, metrics::dist::Euclidean<double>> ball_euclidean;
+        metrics::BallTree<double, metrics::dist::Manhattan<double>> ball_manhattan;
+
+        // small leaves, so the queries go through several levels of the trees
+        kd_euclidean.setLeafSize(10);
+        kd_manhattan.setLeafSize(10);
+        kd_chebyshev.setLeafSize(10);
+        ball_euclidean.setLeafSize(10);
+        ball_manhattan.setLeafSize(10);
+
+        errors += compare<decltype(kd_euclidean), metrics::dist::Euclidean<double>>("KD-tree Euclidean",
+                kd_euclidean, data, queries, k);
+        errors += compare<decltype(kd_manhattan), metrics::dist::Manhattan<double>>("KD-tree Manhattan",
+                kd_manhattan, data, queries, k);
+        errors += compare<decltype(kd_chebyshev), metrics::dist::Chebyshev<double>>("KD-tree Chebyshev",
+                kd_chebyshev, data, queries, k);
+        errors += compare<decltype(ball_euclidean), metrics::dist::Euclidean<double>>("Ball tree Euclidean",
+                ball_euclidean, data, queries, k);
+        errors += compare<decltype(ball_manhattan), metrics::dist::Manhattan<double>>("Ball tree Manhattan",
+                ball_manhattan, data, queries, k);
+    }
+
+    Data<double> high = make_uniform(3000, 32, 4), high_queries = make_uniform(100, 32, 5);
+    metrics::HNSW<double, metrics::dist::Euclidean<double>> hnsw_euclidean(high);
+    metrics::HNSW<double, metrics::dist::Cosine<double>> hnsw_cosine(high);
+    metrics::HNSW<double, metrics::dist::Manhattan<double>> hnsw_manhattan(high);
+    hnsw_euclidean.setEfSearch(100);
+    hnsw_cosine.setEfSearch(100);
+    hnsw_manhattan.setEfSearch(100);
+    for(size_t k: {1, 10}){
+        double r[3] = {recall(hnsw_euclidean, high, high_queries, k), recall(hnsw_cosine, high, high_queries, k),
+                       recall(hnsw_manhattan, high, high_queries, k)};
+        for(double value: r){
+            if(value < 0.9){
+                std::cerr << "HNSW recall at k=" << k << " is " << value << "." << std::endl;
+                errors++;
+            }
+        }
+    }
+    errors += check_hnsw_files(data, queries);
+
+    // new samples of the same size, without training again, must not be answered by the old index
+    Data<double> other = make_uniform(2000, 5, 3);
+    for(auto const& p: other) p->Y() = ((*p)[1] > 0) ? 1 : -1;
+    Data<double> other_queries = make_uniform(200, 5, 6);
+    for(std::string algorithm: {"covertree", "kdtree", "balltree", "hnsw"}){
+        classifier::KNNClassifier<double> knn(data, 5, algorithm), brute(other, 5);
+        int differ = 0;
+
+        knn.train();
+        brute.train();
+        knn.setSamples(other);
+        for(auto const& q: queries) differ += knn.evaluate(*q) != brute.evaluate(*q);
+        auto batch = knn.batchEvaluate(other_queries), expected = brute.batchEvaluate(other_queries);
+        for(size_t i = 0; i < batch.size(); i++) differ += batch[i] != expected[i];
+        if(differ > 0) std::cerr << "KNNClassifier " << algorithm << " after setSamples: " << differ
+                                 << " predictions differ." << std::endl;
+        errors += differ;
+
+        regressor::KNNRegressor<double> knn_reg(make_data<double>(data), 5, {}, algorithm);
+        regressor::KNNRegressor<double> brute_reg(make_data<double>(other), 5);
+        differ = 0;
+        knn_reg.train();
+        knn_reg.setSamples(other);
+        for(auto const& q: queries) differ += std::fabs(knn_reg.evaluate(*q) - brute_reg.evaluate(*q)) > 1e-12;
+        if(differ > 0) std::cerr << "KNNRegressor " << algorithm << " after setSamples: " << differ
+                                 << " predictions differ." << std::endl;
+        errors += differ;
+    }
+
+    // k larger than the number of samples: the regression averages the samples there are
+    Data<double> few = make_uniform(4, 5, 7);
+    double mean = 0;
+    for(size_t i = 0; i < few.getSize(); i++) few[i]->Y() = double(i + 1), mean += double(i + 1) / few.getSize();
+    for(std::string algorithm: {"brute", "kdtree", "balltree", "hnsw"}){
+        regressor::KNNRegressor<double> knn_reg(make_data<double>(few), 10, {}, algorithm);
+
+        knn_reg.train();
+        double value = knn_reg.evaluate(*queries[0]);
+        if(std::fabs(value - mean) > 1e-12){
+            std::cerr << "KNNRegressor " << algorithm << " with k > n: " << value << " instead of " << mean << "."
+                      << std::endl;
+            errors++;
+        }
+    }
+
+    if(errors > 0) return 1;
+    std::cout << "The indexes match brute force." << std::endl;
+    return 0;
+}
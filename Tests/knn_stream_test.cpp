@@ -0,0 +1,134 @@
+//
+// Checks the online mode of KNNClassifier: partialFit and evict against a model trained on the points left in
+// the window, the data given to the model is not changed and the points expire at query time.
+//
+
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <thread>
+#include "../Modules/Core/Core.hpp"
+#include "../Modules/Classifier/Classifier.hpp"
+#include "test_data.hpp"
+
+using namespace mltk;
+
+/// Standard normal point labeled by the side of the line x0 + x1 = 0.
+PointPointer<double> random_point(std::mt19937& gen, size_t dim){
+    auto dist = test_data::normal();
+    auto labeling = [](size_t, Point<double>& p, std::mt19937&){ return (p[0] + p[1] > 0) ? 1.0 : -1.0; };
+
+    return test_data::make_sample(gen, 0, dim, dist, labeling);
+}
+
+int check_window(const std::string& algorithm, const Data<double>& queries){
+    const size_t dim = 3, window = 50;
+    std::mt19937 gen(7);
+    auto data = make_data<double>();
+    // points alive in the window, in arrival order, as (id, point)
+    std::deque<std::pair<size_t, PointPointer<double>>> alive;
+    int errors = 0;
+
+    for(size_t i = 0; i < 30; i++){
+        auto p = random_point(gen, dim);
+        data->insertPoint(p);
+        alive.emplace_back(i, p);
+    }
+    classifier::KNNClassifier<double> knn(5, algorithm);
+    knn.setVerbose(0);
+    knn.setSamples(data);
+    knn.train();
+    knn.setWindow(window);
+
+    for(size_t t = 1; t <= 200; t++){
+        auto p = random_point(gen, dim);
+        size_t id = knn.partialFit(*p, double(t));
+        alive.emplace_back(id, p);
+        while(alive.size() > window) alive.pop_front();
+        if(t % 7 == 0){
+            size_t victim = alive[gen() % alive.size()].first;
+            if(!knn.evict(victim)){
+                std::cerr << algorithm << ": could not evict the point " << victim << "." << std::endl;
+                errors++;
+            }
+            for(auto it = alive.begin(); it != alive.end(); ++it){
+                if(it->first == victim){
+                    alive.erase(it);
+                    break;
+                }
+            }
+        }
+    }
+    if(data->getSize() != 30){
+        std::cerr << algorithm << ": the stream changed the data given to the model." << std::endl;
+        errors++;
+    }
+    if(knn.getWindowCount() != alive.size()){
+        std::cerr << algorithm << ": " << knn.getWindowCount() << " points in the window, expected "
+                  << alive.size() << "." << std::endl;
+        errors++;
+    }
+    if(algorithm == "kdtree" && knn.getAlgorithm() != "brute"){
+        std::cerr << "The KD-tree dropped by the stream is not reported." << std::endl;
+        errors++;
+    }
+
+    Data<double> kept;
+    for(auto const& a: alive) kept.insertPoint(make_point<double>(*a.second));
+    classifier::KNNClassifier<double> reference(kept, 5);
+    reference.train();
+    Data<double> _queries = queries;
+    auto batch = knn.batchEvaluate(_queries);
+    int differ = 0;
+    for(size_t i = 0; i < queries.getSize(); i++){
+        double expected = reference.evaluate(*queries[i]);
+        differ += (knn.evaluate(*queries[i]) != expected) + (batch[i] != expected);
+    }
+    if(differ > 0) std::cerr << algorithm << ": " << differ << " predictions differ from a model of the window."
+                             << std::endl;
+    return errors + differ;
+}
+
+int check_expiry(){
+    std::mt19937 gen(8);
+    int errors = 0;
+
+    // times from the model's clock, the points expire without a new point arriving
+    classifier::KNNClassifier<double> clock_knn(3);
+    clock_knn.setVerbose(0);
+    clock_knn.setWindow(0, 0.05);
+    for(size_t i = 0; i < 10; i++) clock_knn.partialFit(*random_point(gen, 3));
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    clock_knn.evaluate(*random_point(gen, 3));
+    if(clock_knn.getWindowCount() != 0){
+        std::cerr << clock_knn.getWindowCount() << " points outlived the maximum age at query time." << std::endl;
+        errors++;
+    }
+
+    // times given by the caller, expired before querying
+    classifier::KNNClassifier<double> timed_knn(3);
+    timed_knn.setVerbose(0);
+    timed_knn.setWindow(0, 5.0);
+    for(size_t i = 0; i < 10; i++) timed_knn.partialFit(*random_point(gen, 3), double(i));
+    timed_knn.expire(12.5);
+    if(timed_knn.getWindowCount() != 2){
+        std::cerr << timed_knn.getWindowCount() << " points in the window after expire, expected 2." << std::endl;
+        errors++;
+    }
+    return errors;
+}
+
+int main(int argc, char* argv[]){
+    std::mt19937 gen(9);
+    Data<double> queries;
+    int errors = 0;
+
+    for(size_t i = 0; i < 200; i++) queries.insertPoint(random_point(gen, 3));
+    for(std::string algorithm: {"brute", "covertree", "kdtree"}) errors += check_window(algorithm, queries);
+    errors += check_expiry();
+
+    if(errors > 0) return 1;
+    std::cout << "The online mode keeps the window." << std::endl;
+    return 0;
+}
@@ -0,0 +1,123 @@
+//
+// Checks the voting and the decision DAG of OneVsOne against binary learners trained here for each pair of
+// classes, and that training the pairs in parallel gives the same model.
+//
+
+#include <iostream>
+#include <random>
+#include "../Modules/Core/Core.hpp"
+#include "../Modules/Classifier/Classifier.hpp"
+#include "test_data.hpp"
+
+using namespace mltk;
+
+/// Overlapping blobs of n_classes classes, labeled 1 to n_classes.
+Data<double> make_classes(size_t n, size_t dim, size_t n_classes, unsigned seed){
+    auto shift = [](int label, size_t d){ return 3.0 * std::cos(label * (d + 1.0)); };
+
+    return test_data::make_samples(n, dim, seed, test_data::normal(), test_data::classes_by_index(n_classes, shift));
+}
+
+int main(int argc, char* argv[]){
+    const size_t n_classes = 5;
+    Data<double> data = make_classes(600, 3, n_classes, 1), test = make_classes(400, 3, n_classes, 2);
+    auto classes = data.getClasses();
+    Kernel kernel(GAUSSIAN, 0.5);
+    classifier::SMO<double> smo(nullptr, &kernel);
+    int errors = 0;
+
+    smo.setWorkingSetSelection(classifier::SMO<double>::SECOND_ORDER);
+
+    classifier::OneVsOne<double> ovo(data, smo), parallel_ovo(data, smo);
+    ovo.train();
+    parallel_ovo.setThreads(4);
+    parallel_ovo.train();
+
+    // one binary learner for each pair i < j, class i labeled +1, seeded as the pair p of OneVsOne
+    std::vector<std::vector<std::shared_ptr<classifier::SMO<double>>>> pairs(n_classes);
+    std::vector<std::shared_ptr<Kernel>> kernels;
+    size_t p = 0;
+    for(size_t i = 0; i < n_classes; i++){
+        pairs[i].resize(n_classes);
+        for(size_t j = i + 1; j < n_classes; j++, p++){
+            Data<double> binary;
+            std::vector<int> current = {classes[i], classes[j]};
+
+            binary.classesCopy(data, current);
+            binary.setClasses({-1, 1});
+            for(size_t k = 0; k < binary.getSize(); k++) binary[k]->Y() = (binary[k]->Y() == classes[i]) ? 1 : -1;
+            kernels.push_back(std::make_shared<Kernel>(GAUSSIAN, 0.5));
+            pairs[i][j] = std::make_shared<classifier::SMO<double>>(nullptr, kernels.back().get());
+            pairs[i][j]->setWorkingSetSelection(classifier::SMO<double>::SECOND_ORDER);
+            pairs[i][j]->setSeed(p);
+            pairs[i][j]->setSamples(binary);
+            pairs[i][j]->train();
+        }
+    }
+
+    size_t wrong_votes = 0, wrong_dag = 0, not_winner = 0, differ_parallel = 0, hits_votes = 0, hits_dag = 0;
+    for(size_t t = 0; t < test.getSize(); t++){
+        const Point<double>& q = *test[t];
+        std::vector<std::vector<bool>> wins(n_classes, std::vector<bool>(n_classes, false));
+        std::vector<size_t> votes(n_classes, 0);
+
+        for(size_t i = 0; i < n_classes; i++){
+            for(size_t j = i + 1; j < n_classes; j++){
+                bool first = pairs[i][j]->evaluate(q) == 1;
+                wins[i][j] = first;
+                wins[j][i] = !first;
+                votes[first ? i : j]++;
+            }
+        }
+        double expected_vote = classes[std::max_element(votes.begin(), votes.end()) - votes.begin()];
+        size_t first = 0, last = n_classes - 1;
+        while(first < last){
+            if(wins[first][last]) last--;
+            else first++;
+        }
+        double expected_dag = classes[first];
+
+        ovo.setDecisionMode(classifier::OneVsOne<double>::VOTING);
+        double vote = ovo.evaluate(q);
+        ovo.setDecisionMode(classifier::OneVsOne<double>::DAG);
+        double dag = ovo.evaluate(q);
+        parallel_ovo.setDecisionMode(classifier::OneVsOne<double>::VOTING);
+        differ_parallel += parallel_ovo.evaluate(q) != vote;
+        parallel_ovo.setDecisionMode(classifier::OneVsOne<double>::DAG);
+        differ_parallel += parallel_ovo.evaluate(q) != dag;
+
+        wrong_votes += vote != expected_vote;
+        wrong_dag += dag != expected_dag;
+        hits_votes += vote == q.Y();
+        hits_dag += dag == q.Y();
+
+        // a class that wins against all the others is chosen by both modes
+        for(size_t c = 0; c < n_classes; c++){
+            if(votes[c] == n_classes - 1 && (vote != classes[c] || dag != classes[c])) not_winner++;
+        }
+    }
+
+    if(wrong_votes > 0 || wrong_dag > 0){
+        std::cerr << wrong_votes << " votes and " << wrong_dag << " DAG decisions differ from the pairwise learners."
+                  << std::endl;
+        errors++;
+    }
+    if(not_winner > 0){
+        std::cerr << "A class winning all its pairs was not chosen for " << not_winner << " points." << std::endl;
+        errors++;
+    }
+    if(differ_parallel > 0){
+        std::cerr << differ_parallel << " predictions differ when the pairs train in parallel." << std::endl;
+        errors++;
+    }
+    // the blobs overlap, a sanity bound on the accuracy
+    if(hits_votes < 0.6 * test.getSize() || hits_dag < 0.6 * test.getSize()){
+        std::cerr << "Accuracy " << double(hits_votes) / test.getSize() << " voting and "
+                  << double(hits_dag) / test.getSize() << " with the DAG." << std::endl;
+        errors++;
+    }
+
+    if(errors > 0) return 1;
+    std::cout << "OneVsOne matches its pairwise learners." << std::endl;
+    return 0;
+}
@@ -0,0 +1,184 @@
+//
+// Checks the pairwise distance matrix and the neighbors graph against brute force, and the neighbors used by SMOTE
+// and Borderline SMOTE on data with duplicated points and tied distances.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <set>
+#include "../Modules/Core/Core.hpp"
+#include "../Modules/Core/include/Sampling.hpp"
+#include "test_data.hpp"
+
+using namespace mltk;
+
+/// Points with coordinates on a small grid, so there are duplicated points and many tied distances.
+Data<double> make_grid(size_t n, size_t dim, unsigned seed){
+    auto labeling = [](size_t, Point<double>& p, std::mt19937& gen){
+        return (p[0] + std::uniform_int_distribution<int>(0, 4)(gen) > 5) ? 1.0 : -1.0;
+    };
+
+    return test_data::make_samples(n, dim, seed, std::uniform_int_distribution<int>(0, 4), labeling);
+}
+
+/// Standard normal points, all in the class 1.
+Data<double> make_normal(size_t n, size_t dim, unsigned seed){
+    return test_data::make_samples(n, dim, seed, test_data::normal(), test_data::classes_by_index(1));
+}
+
+/// Points of the data sorted by the distance to the point pos, then by position, without pos.
+template<typename Callable>
+std::vector<std::pair<double, size_t>> brute_row(const Data<double>& data, size_t pos){
+    Callable metric;
+    std::vector<std::pair<double, size_t>> row;
+
+    for(size_t j = 0; j < data.getSize(); j++)
+        if(j != pos) row.emplace_back(metric(*data[pos], *data[j]), j);
+    std::sort(row.begin(), row.end());
+    return row;
+}
+
+/// Positions of the k nearest points at distinct and non-zero distances, by brute force.
+template<typename Callable>
+std::vector<size_t> brute_distinct(const Data<double>& data, size_t pos, size_t k){
+    auto row = brute_row<Callable>(data, pos);
+    std::vector<size_t> neighbors;
+    double last = 0;
+
+    for(size_t r = 0; r < row.size() && neighbors.size() < k; r++){
+        if(row[r].first == 0 || (!neighbors.empty() && row[r].first == last)) continue;
+        neighbors.push_back(row[r].second);
+        last = row[r].first;
+    }
+    return neighbors;
+}
+
+template<typename Callable>
+int check_pairwise(const std::string& name, const Data<double>& data){
+    auto matrix = metrics::pairwiseDistances(data, Callable());
+    int errors = 0, wrong = 0;
+
+    for(size_t i = 0; i < data.getSize(); i++){
+        auto row = brute_row<Callable>(data, i);
+        for(auto const& d: row) wrong += matrix(i, d.second) != float(d.first);
+    }
+    if(wrong > 0){
+        std::cerr << name << ": " << wrong << " distances of the matrix differ from brute force." << std::endl;
+        errors++;
+    }
+
+    for(size_t k: std::vector<size_t>{1, 6, 40, data.getSize() + 3}){
+        auto graph = metrics::pairwiseNeighbors(data, k, Callable());
+        size_t _k = std::min(k, data.getSize() - 1);
+
+        wrong = graph.size() != data.getSize() || graph.getK() != _k;
+        for(size_t i = 0; !wrong && i < data.getSize(); i++){
+            auto row = brute_row<Callable>(data, i);
+            for(size_t r = 0; r < _k; r++)
+                wrong += graph.neighbors(i)[r] != row[r].second || graph.distances(i)[r] != float(row[r].first);
+        }
+        if(wrong > 0){
+            std::cerr << name << " k=" << k << ": the neighbors graph differs from brute force." << std::endl;
+            errors++;
+        }
+    }
+    return errors;
+}
+
+/// Coordinates of the points from the position begin on.
+std::vector<std::vector<double>> tail(const Data<double>& data, size_t begin){
+    std::vector<std::vector<double>> coords;
+
+    for(size_t i = begin; i < data.getSize(); i++) coords.push_back(data[i]->X());
+    return coords;
+}
+
+/// SMOTE against the same generation with the neighbors found by brute force.
+int check_smote(size_t k, size_t seed){
+    Data<double> data = make_grid(300, 3, 5), expected = make_grid(300, 3, 5);
+    SMOTE<double> smote(k, 0.1, seed);
+    auto classes = expected.getClasses();
+    auto class_distribution = expected.getClassesDistribution();
+    std::vector<int> minority = {classes[std::min_element(class_distribution.begin(), class_distribution.end()) -
+                                         class_distribution.begin()]};
+    std::vector<SamplePointer<double>> artificial;
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    Data<double> Z;
+
+    Z.classesCopy(expected, minority);
+    for(size_t pos = 0; pos < Z.getSize(); pos++){
+        for(size_t j: brute_distinct<metrics::dist::Euclidean<double>>(Z, pos, k)){
+            double alpha = distribution(generator);
+            Point<double> s(Z.getDim(), 0.0, 0);
+            s = *Z[pos] + alpha * (*Z[pos] - *Z[j]);
+            s.Y() = minority[0];
+            artificial.push_back(make_point<double>(s));
+        }
+    }
+    std::shuffle(artificial.begin(), artificial.end(), std::default_random_engine(seed));
+    for(auto const& p: artificial) expected.insertPoint(p);
+
+    smote(data);
+    if(tail(data, 300) != tail(expected, 300)){
+        std::cerr << "SMOTE k=" << k << ": the artificial points differ from brute force neighbors." << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/// Borderline SMOTE against the same danger subset found with brute force neighbors.
+int check_borderline(size_t m, size_t seed){
+    Data<double> data = make_grid(300, 3, 6), expected = make_grid(300, 3, 6);
+    BorderlineSMOTEOne<double> borderline(3, 0.1, m, seed);
+    auto classes = expected.getClasses();
+    auto class_distribution = expected.getClassesDistribution();
+    int maj_class = classes[std::max_element(class_distribution.begin(), class_distribution.end()) -
+                            class_distribution.begin()];
+    Data<double> danger_subset;
+    std::set<size_t> danger_ids;
+
+    for(size_t pos = 0; pos < expected.getSize(); pos++){
+        auto neighbors = brute_distinct<metrics::dist::Euclidean<double>>(expected, pos, m);
+        size_t m_ = 0;
+
+        for(size_t j: neighbors) m_ += expected[j]->Y() == maj_class;
+        if(m_ >= (m / 2) && m_ < m){
+            danger_ids.insert(expected[pos]->Id());
+            danger_subset.insertPoint(expected[pos]);
+        }
+    }
+    if(danger_subset.getSize() > 0){
+        SMOTE<double> smote(3, 0.1, seed);
+        smote(danger_subset);
+    }
+    for(size_t i = 0; i < danger_subset.getSize(); i++)
+        if(danger_ids.find(danger_subset[i]->Id()) != danger_ids.end()) expected.insertPoint(danger_subset[i]);
+
+    borderline(data);
+    if(danger_ids.empty() || tail(data, 0) != tail(expected, 0)){
+        std::cerr << "Borderline SMOTE m=" << m << ": the output differs from brute force neighbors." << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]){
+    int errors = 0;
+    Data<double> grid = make_grid(600, 3, 1), normal = make_normal(700, 7, 2);
+
+    errors += check_pairwise<metrics::dist::Euclidean<double>>("Euclidean on a grid", grid);
+    errors += check_pairwise<metrics::dist::Manhattan<double>>("Manhattan on a grid", grid);
+    errors += check_pairwise<test_data::PlainManhattan>("user metric on a grid", grid);
+    errors += check_pairwise<metrics::dist::Euclidean<double>>("Euclidean", normal);
+    errors += check_pairwise<metrics::dist::Cosine<double>>("Cosine", normal);
+
+    for(size_t k: {1, 3, 8}) errors += check_smote(k, 11);
+    for(size_t m: {3, 5, 10}) errors += check_borderline(m, 12);
+
+    if(errors > 0) return 1;
+    std::cout << "The pairwise distances match brute force." << std::endl;
+    return 0;
+}
@@ -0,0 +1,94 @@
+//
+// Checks the parameter mixing mode of PerceptronPrimal: the weights only depend on the number of threads, the
+// result of train agrees with the training errors of the returned solution, and separable data is separated with
+// and without batches.
+//
+
+#include <iostream>
+#include <random>
+#include "../Modules/Core/Core.hpp"
+#include "../Modules/Classifier/Classifier.hpp"
+#include "test_data.hpp"
+
+using namespace mltk;
+
+/// Uniform points labeled by the sign of x0 + x1, moved away from the separating line.
+Data<double> make_separable(size_t n, size_t dim, unsigned seed){
+    auto labeling = [](size_t, Point<double>& p, std::mt19937&){
+        double label = (p[0] + p[1] > 0) ? 1 : -1;
+
+        p[0] += 0.05 * label;
+        p[1] += 0.05 * label;
+        return label;
+    };
+
+    return test_data::make_samples(n, dim, seed, test_data::uniform(-1.0, 1.0), labeling);
+}
+
+/// Number of samples misclassified by the solution.
+size_t training_errors(const Data<double>& data, const Solution& solution){
+    size_t errors = 0;
+
+    for(size_t i = 0; i < data.getSize(); i++){
+        double func = solution.bias;
+        for(size_t d = 0; d < data.getDim(); d++) func += solution.w[d] * (*data[i])[d];
+        errors += data[i]->Y() * func <= 0;
+    }
+    return errors;
+}
+
+struct Trained {
+    bool converged;
+    Solution solution;
+};
+
+Trained train(const Data<double>& data, size_t threads, size_t batch_size, int max_epochs){
+    classifier::PerceptronPrimal<double> perceptron(make_data<double>(data));
+    Trained trained;
+
+    perceptron.setMode(classifier::PARAMETER_MIXING);
+    perceptron.setThreads(threads);
+    perceptron.setBatchSize(batch_size);
+    // stop by the number of epochs only, so the runs are comparable
+    perceptron.setMaxTime(1e9);
+    perceptron.setMaxIterations(max_epochs);
+    trained.converged = perceptron.train();
+    trained.solution = perceptron.getSolution();
+    return trained;
+}
+
+int main(int argc, char* argv[]){
+    int errors = 0;
+
+    for(unsigned seed = 1; seed <= 20; seed++){
+        Data<double> data = make_separable(400, 5, seed);
+
+        for(size_t batch_size: {size_t(0), size_t(16)}){
+            // few epochs leave some runs without convergence, the averaged solution is returned then
+            for(int max_epochs: {3, 5000}){
+                Trained first = train(data, 4, batch_size, max_epochs), second = train(data, 4, batch_size, max_epochs);
+                size_t wrong = training_errors(data, first.solution);
+
+                if(first.solution.w != second.solution.w || first.solution.bias != second.solution.bias){
+                    std::cerr << "seed " << seed << ", batch " << batch_size << ": two runs with 4 threads differ."
+                              << std::endl;
+                    errors++;
+                }
+                if(first.converged && wrong > 0){
+                    std::cerr << "seed " << seed << ", batch " << batch_size << ": train returned true but "
+                              << wrong << " samples are misclassified." << std::endl;
+                    errors++;
+                }
+                if(max_epochs > 3 && (!first.converged || wrong > 0)){
+                    std::cerr << "seed " << seed << ", batch " << batch_size << ": separable data wasn't separated."
+                              << std::endl;
+                    errors++;
+                }
+            }
+        }
+    }
+
+    if(errors > 0) return 1;
+    std::cout << "The parameter mixing perceptron is deterministic and separates the data." << std::endl;
+    return 0;
+}
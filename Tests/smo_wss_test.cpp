@@ -0,0 +1,126 @@
+//
+// Checks the second order working set selection of SMO, with and without shrinking, against the first order one:
+// feasible multipliers, a dual objective at least as high, the KKT conditions and the same predictions. The data
+// is large enough for the active set to shrink.
+//
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include "../Modules/Core/Core.hpp"
+#include "../Modules/Classifier/Classifier.hpp"
+#include "test_data.hpp"
+
+using namespace mltk;
+
+/// Two overlapping classes, labeled +1 and -1.
+std::shared_ptr<Data<double>> make_classes(size_t n, size_t dim, unsigned seed){
+    auto shift = [](int label, size_t d){ return 0.8 * label * (d < 2); };
+
+    return make_data<double>(test_data::make_samples(n, dim, seed, test_data::normal(),
+                                                     test_data::classes_by_index(2, shift)));
+}
+
+struct Trained {
+    std::string name;
+    std::vector<double> alpha;
+    std::vector<double> predictions;
+    double objective = 0, gap = 0;
+};
+
+/// Train a SMO on a copy of the data and measure its solution with the kernel computed here.
+Trained train(const std::string& name, const Data<double>& data, const Data<double>& test, double C, double gamma,
+              typename classifier::SMO<double>::WorkingSetSelection selection, bool shrinking){
+    auto samples = make_data<double>(data);
+    Kernel kernel(GAUSSIAN, gamma);
+    classifier::SMO<double> smo(samples, &kernel);
+    size_t n = data.getSize(), dim = data.getDim();
+    Trained trained;
+
+    smo.setC(C);
+    smo.setWorkingSetSelection(selection);
+    smo.setShrinking(shrinking);
+    smo.train();
+    trained.name = name;
+    trained.alpha = smo.getSolution().alpha;
+
+    // dual objective sum(alpha) - 1/2 sum(alpha_i alpha_j y_i y_j K_ij), gradient G_i = y_i (K y alpha)_i - 1
+    Kernel K(GAUSSIAN, gamma);
+    std::vector<double> G(n, -1.0);
+    for(size_t i = 0; i < n; i++){
+        double sum = 0;
+        for(size_t j = 0; j < n; j++)
+            if(trained.alpha[j] > 0) sum += trained.alpha[j] * data[j]->Y() * K.function(*data[i], *data[j], dim);
+        G[i] += data[i]->Y() * sum;
+        trained.objective += trained.alpha[i] - 0.5 * trained.alpha[i] * data[i]->Y() * sum;
+    }
+
+    // KKT gap: the largest -y_i G_i of the multipliers that can move up, minus the smallest of those that can
+    // move down, in y_i alpha_i
+    double up = -INFINITY, low = INFINITY;
+    for(size_t i = 0; i < n; i++){
+        double v = -data[i]->Y() * G[i];
+        bool at_upper = trained.alpha[i] >= C, at_lower = trained.alpha[i] <= 0;
+        if((data[i]->Y() > 0 && !at_upper) || (data[i]->Y() < 0 && !at_lower)) up = std::max(up, v);
+        if((data[i]->Y() > 0 && !at_lower) || (data[i]->Y() < 0 && !at_upper)) low = std::min(low, v);
+    }
+    trained.gap = up - low;
+
+    for(size_t i = 0; i < test.getSize(); i++) trained.predictions.push_back(smo.evaluate(*test[i]));
+    return trained;
+}
+
+int main(int argc, char* argv[]){
+    const double C = 10.0, gamma = 0.2;
+    auto data = make_classes(1000, 5, 1), test = make_classes(400, 5, 2);
+    int errors = 0;
+
+    Trained first = train("first order", *data, *test, C, gamma, classifier::SMO<double>::FIRST_ORDER, false);
+    std::vector<Trained> second = {
+        train("second order", *data, *test, C, gamma, classifier::SMO<double>::SECOND_ORDER, false),
+        train("second order with shrinking", *data, *test, C, gamma, classifier::SMO<double>::SECOND_ORDER, true)
+    };
+
+    for(auto const& t: second){
+        double balance = 0;
+        bool in_box = t.alpha.size() == data->getSize();
+        for(size_t i = 0; in_box && i < t.alpha.size(); i++){
+            in_box = t.alpha[i] >= 0 && t.alpha[i] <= C;
+            balance += t.alpha[i] * (*data)[i]->Y();
+        }
+        if(!in_box || std::fabs(balance) > 1e-6){
+            std::cerr << t.name << ": the multipliers are not feasible, sum(y alpha) = " << balance << "." << std::endl;
+            errors++;
+        }
+        // the solver stops at a KKT gap of 1e-3, measured on its own gradient
+        if(t.gap > 2e-3){
+            std::cerr << t.name << ": the KKT gap is " << t.gap << "." << std::endl;
+            errors++;
+        }
+        // the first order selection stops farther from the optimum, the dual is maximized
+        if(t.objective < first.objective - 1e-6 * std::fabs(first.objective) ||
+           t.objective > first.objective + 1e-2 * std::fabs(first.objective)){
+            std::cerr << t.name << ": the dual objective is " << t.objective << ", the first order one is "
+                      << first.objective << "." << std::endl;
+            errors++;
+        }
+        size_t differ = 0;
+        for(size_t i = 0; i < test->getSize(); i++) differ += t.predictions[i] != first.predictions[i];
+        if(differ > test->getSize() / 100){
+            std::cerr << t.name << ": " << differ << " predictions differ from the first order ones." << std::endl;
+            errors++;
+        }
+    }
+
+    // shrinking only skips the examples that can't change, the solution is the same
+    if(std::fabs(second[0].objective - second[1].objective) > 1e-6 * std::fabs(second[0].objective) ||
+       second[0].predictions != second[1].predictions){
+        std::cerr << "Shrinking changed the solution, dual objective " << second[1].objective << " instead of "
+                  << second[0].objective << "." << std::endl;
+        errors++;
+    }
+
+    if(errors > 0) return 1;
+    std::cout << "The second order working set selection reaches the first order solution." << std::endl;
+    return 0;
+}
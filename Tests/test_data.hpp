@@ -0,0 +1,83 @@
+//
+// Random data shared by the tests: points with features drawn from a distribution and a labeling that sets the
+// class of each point, from its index or from its features, and may move it.
+//
+
+#ifndef TESTS_TEST_DATA_HPP
+#define TESTS_TEST_DATA_HPP
+
+#include <cmath>
+#include <random>
+#include "../Modules/Core/Core.hpp"
+
+namespace test_data {
+    using mltk::Data;
+    using mltk::Point;
+    using mltk::PointPointer;
+
+    /**
+     * \brief Point with its features drawn from dist, labeled by labeling(i, point, gen), which may also move it.
+     * \param i Index of the point in its data.
+     */
+    template<typename Distribution, typename Labeling>
+    PointPointer<double> make_sample(std::mt19937 &gen, size_t i, size_t dim, Distribution &dist, Labeling &labeling){
+        auto p = mltk::make_point<double>(dim);
+
+        for(size_t d = 0; d < dim; d++) (*p)[d] = dist(gen);
+        p->Y() = labeling(i, *p, gen);
+        return p;
+    }
+
+    /**
+     * \brief n points with their features drawn from dist and labeled by labeling, see make_sample.
+     */
+    template<typename Distribution, typename Labeling>
+    Data<double> make_samples(size_t n, size_t dim, unsigned seed, Distribution dist, Labeling labeling){
+        std::mt19937 gen(seed);
+        Data<double> data;
+
+        for(size_t i = 0; i < n; i++) data.insertPoint(make_sample(gen, i, dim, dist, labeling));
+        return data;
+    }
+
+    /// Features drawn from the standard normal distribution.
+    inline std::normal_distribution<double> normal(){ return std::normal_distribution<double>(0.0, 1.0); }
+
+    /// Features drawn uniformly from [low, high).
+    inline std::uniform_real_distribution<double> uniform(double low, double high){
+        return std::uniform_real_distribution<double>(low, high);
+    }
+
+    /**
+     * \brief Labels 1 to n_classes taken in turn by the index, with the feature d of a point of class label moved by
+     * shift(label, d). Two classes are labeled -1 and 1 instead.
+     */
+    template<typename Shift>
+    auto classes_by_index(size_t n_classes, Shift shift){
+        return [n_classes, shift](size_t i, Point<double> &p, std::mt19937 &){
+            int label = (n_classes == 2) ? ((i % 2) ? 1 : -1) : int(i % n_classes) + 1;
+
+            for(size_t d = 0; d < p.size(); d++) p[d] += shift(label, d);
+            return double(label);
+        };
+    }
+
+    /// Labels taken in turn by the index, without moving the points.
+    inline auto classes_by_index(size_t n_classes){
+        return classes_by_index(n_classes, [](int, size_t){ return 0.0; });
+    }
+
+    /// Labels -1 or 1 by the sign of the first feature.
+    inline double sign_of_first(size_t, Point<double> &p, std::mt19937 &){ return (p[0] > 0) ? 1 : -1; }
+
+    /// Metric of the user, with neither a bounded operator nor a distances call.
+    struct PlainManhattan {
+        double operator()(const Point<double>& p1, const Point<double>& p2) const {
+            double sum = 0;
+            for(size_t d = 0; d < p1.size(); d++) sum += std::fabs(p1[d] - p2[d]);
+            return sum;
+        }
+    };
+}
+
+#endif